@@ -0,0 +1,317 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <CL/cl.h>
+
+#include "tclap/CmdLine.h"
+
+#include "rotate_engine.h"
+#include "rotate_transfer.h"
+
+/**
+ * ========== Host <-> Device 带宽扫描 ==========
+ * 对 4KB ~ 1GB（按 4 倍递增）的传输大小，分别测量 rotate_transfer.h 中四种传输方式
+ * 在两个方向上的带宽。每种方式都从调用方的 pageable 内存出发、到调用方内存结束，
+ * 与 RotateEngine::Rotate 实际做的事情一致（pinned 包含进出暂存区的 memcpy，
+ * hostptr 包含包装 buffer 的创建）。
+ * 旋转一帧需要上传和读回同样大小的数据，所以按“上传 + 读回”的总时间选出每个大小最快的方式，
+ * 写成 --profile 文件，opencl_rotate --transfer-profile 读取后按帧大小选择。
+ */
+
+#ifndef OPENCL_EXAMPLE_KERNEL_DIR
+#define OPENCL_EXAMPLE_KERNEL_DIR "/mnt/workspace/cgz_workspace/Exercise/opencl_example/src"
+#endif
+
+struct SweepBuffers {
+  SweepBuffers()
+      : device(NULL), stage(NULL), stagePtr(NULL), host(NULL), bytes(0) {}
+  cl_mem device;
+  cl_mem stage;     // CL_MEM_ALLOC_HOST_PTR，保持映射
+  void *stagePtr;
+  void *host;       // 页对齐的 pageable 内存，模拟调用方的图像
+  size_t bytes;
+};
+
+static cl_device_type ParseDeviceType(const std::string &name) {
+  if (name == "cpu") return CL_DEVICE_TYPE_CPU;
+  if (name == "all") return CL_DEVICE_TYPE_ALL;
+  return CL_DEVICE_TYPE_GPU;
+}
+
+static double Median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  return values.empty() ? 0.0 : values[values.size() / 2];
+}
+
+static void ReleaseSweepBuffers(cl_command_queue queue, SweepBuffers *b) {
+  if (b->stagePtr != NULL) {
+    clEnqueueUnmapMemObject(queue, b->stage, b->stagePtr, 0, NULL, NULL);
+    clFinish(queue);
+  }
+  if (b->stage != NULL) clReleaseMemObject(b->stage);
+  if (b->device != NULL) clReleaseMemObject(b->device);
+  free(b->host);
+  *b = SweepBuffers();
+}
+
+static cl_int CreateSweepBuffers(cl_context context, cl_command_queue queue,
+                                 size_t bytes, SweepBuffers *b) {
+  cl_int status = CL_SUCCESS;
+  b->bytes = bytes;
+  if (posix_memalign(&b->host, 4096, bytes) != 0) {
+    b->host = NULL;
+    std::cout << "posix_memalign failed." << std::endl;
+    return CL_OUT_OF_HOST_MEMORY;
+  }
+  memset(b->host, 1, bytes);
+  b->device = clCreateBuffer(context, CL_MEM_READ_WRITE, bytes, NULL, &status);
+  if (status == CL_SUCCESS) {
+    b->stage = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR,
+                              bytes, NULL, &status);
+  }
+  if (status == CL_SUCCESS) {
+    b->stagePtr = clEnqueueMapBuffer(queue, b->stage, CL_TRUE,
+                                     CL_MAP_READ | CL_MAP_WRITE, 0, bytes, 0,
+                                     NULL, NULL, &status);
+  }
+  if (status != CL_SUCCESS) {
+    std::cout << "Failed to allocate " << bytes << " byte buffers."
+              << std::endl;
+    ReleaseSweepBuffers(queue, b);
+  }
+  return status;
+}
+
+/**
+ * @brief 按指定方式完成一次上传（toDevice）或读回，返回阻塞完成的耗时
+ */
+static cl_int TimeTransfer(cl_context context, cl_command_queue queue,
+                           TransferStrategy strategy, bool toDevice,
+                           SweepBuffers *b, double *seconds) {
+  cl_int status = CL_SUCCESS;
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  switch (strategy) {
+    case kTransferPageable:
+      status = toDevice ? clEnqueueWriteBuffer(queue, b->device, CL_TRUE, 0,
+                                               b->bytes, b->host, 0, NULL, NULL)
+                        : clEnqueueReadBuffer(queue, b->device, CL_TRUE, 0,
+                                              b->bytes, b->host, 0, NULL, NULL);
+      break;
+    case kTransferPinned:
+      if (toDevice) {
+        memcpy(b->stagePtr, b->host, b->bytes);
+        status = clEnqueueWriteBuffer(queue, b->device, CL_TRUE, 0, b->bytes,
+                                      b->stagePtr, 0, NULL, NULL);
+      } else {
+        status = clEnqueueReadBuffer(queue, b->device, CL_TRUE, 0, b->bytes,
+                                     b->stagePtr, 0, NULL, NULL);
+        memcpy(b->host, b->stagePtr, b->bytes);
+      }
+      break;
+    case kTransferHostPtr: {
+      // 包装调用方内存后用 copy 强制数据真正移动；共享内存设备上这几乎是零拷贝
+      cl_mem wrapped = clCreateBuffer(context,
+                                      CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR,
+                                      b->bytes, b->host, &status);
+      if (status != CL_SUCCESS) {
+        break;
+      }
+      if (toDevice) {
+        status = clEnqueueCopyBuffer(queue, wrapped, b->device, 0, 0, b->bytes,
+                                     0, NULL, NULL);
+      } else {
+        status = clEnqueueCopyBuffer(queue, b->device, wrapped, 0, 0, b->bytes,
+                                     0, NULL, NULL);
+        void *mapped = NULL;
+        if (status == CL_SUCCESS) {
+          mapped = clEnqueueMapBuffer(queue, wrapped, CL_TRUE, CL_MAP_READ, 0,
+                                      b->bytes, 0, NULL, NULL, &status);
+        }
+        if (status == CL_SUCCESS) {
+          clEnqueueUnmapMemObject(queue, wrapped, mapped, 0, NULL, NULL);
+        }
+      }
+      if (status == CL_SUCCESS) {
+        status = clFinish(queue);
+      }
+      clReleaseMemObject(wrapped);
+      break;
+    }
+    case kTransferMap: {
+      void *mapped = clEnqueueMapBuffer(
+          queue, b->device, CL_TRUE, toDevice ? CL_MAP_WRITE : CL_MAP_READ, 0,
+          b->bytes, 0, NULL, NULL, &status);
+      if (status != CL_SUCCESS) {
+        break;
+      }
+      if (toDevice) {
+        memcpy(mapped, b->host, b->bytes);
+      } else {
+        memcpy(b->host, mapped, b->bytes);
+      }
+      clEnqueueUnmapMemObject(queue, b->device, mapped, 0, NULL, NULL);
+      status = clFinish(queue);
+      break;
+    }
+    default:
+      status = CL_INVALID_VALUE;
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  *seconds = elapsed.count();
+  return status;
+}
+
+static std::string FormatBytes(size_t bytes) {
+  const char *units[] = {"B", "KB", "MB", "GB"};
+  int unit = 0;
+  while (unit < 3 && bytes >= 1024 && bytes % 1024 == 0) {
+    bytes /= 1024;
+    unit++;
+  }
+  return std::to_string(bytes) + units[unit];
+}
+
+int main(int argc, char **argv) {
+  std::string kernelPath;
+  std::string deviceName;
+  std::string profilePath;
+  size_t minBytes = 4096;
+  size_t maxBytes = (size_t)1 << 30;
+  try {
+    TCLAP::CmdLine cmd("Host/device transfer bandwidth sweep", ' ', "0.1");
+    TCLAP::ValueArg<std::string> kernelArg(
+        "k", "kernel", "Path of rotate.cl", false,
+        OPENCL_EXAMPLE_KERNEL_DIR "/rotate.cl", "path", cmd);
+    TCLAP::ValueArg<std::string> deviceArg("d", "device",
+                                           "Device type: gpu, cpu or all",
+                                           false, "gpu", "string", cmd);
+    TCLAP::ValueArg<long long> minArg("", "min-size",
+                                      "Smallest transfer in bytes", false,
+                                      (long long)minBytes, "bytes", cmd);
+    TCLAP::ValueArg<long long> maxArg("", "max-size",
+                                      "Largest transfer in bytes", false,
+                                      (long long)maxBytes, "bytes", cmd);
+    TCLAP::ValueArg<std::string> profileArg(
+        "p", "profile",
+        "Write the fastest strategy per size for opencl_rotate "
+        "--transfer-profile",
+        false, "", "path", cmd);
+    cmd.parse(argc, argv);
+    kernelPath = kernelArg.getValue();
+    deviceName = deviceArg.getValue();
+    minBytes = (size_t)std::max(4LL, minArg.getValue());
+    maxBytes = (size_t)std::max((long long)minBytes, maxArg.getValue());
+    profilePath = profileArg.getValue();
+  } catch (TCLAP::ArgException &e) {
+    std::cerr << "error: " << e.error() << " for arg " << e.argId()
+              << std::endl;
+    return 1;
+  }
+
+  // 与 opencl_rotate 使用同样的设备选择逻辑，保证 profile 对应同一个设备
+  RotateEngine engine;
+  if (engine.Init(kernelPath, ParseDeviceType(deviceName)) != CL_SUCCESS) {
+    return 1;
+  }
+  char name[256] = {0};
+  clGetDeviceInfo(engine.device(), CL_DEVICE_NAME, sizeof(name) - 1, name,
+                  NULL);
+  cl_ulong maxAlloc = 0;
+  clGetDeviceInfo(engine.device(), CL_DEVICE_MAX_MEM_ALLOC_SIZE,
+                  sizeof(maxAlloc), &maxAlloc, NULL);
+  if (maxAlloc > 0 && maxAlloc < maxBytes) {
+    maxBytes = (size_t)maxAlloc;
+  }
+  std::cout << "device: " << name << std::endl;
+
+  std::cout << std::left << std::setw(8) << "size";
+  for (int d = 0; d < 2; d++) {
+    for (int s = 0; s < kTransferStrategyCount; s++) {
+      std::cout << std::right << std::setw(11)
+                << std::string(d == 0 ? "H2D " : "D2H ") +
+                       TransferStrategyName((TransferStrategy)s);
+    }
+  }
+  std::cout << "  best   (GB/s)" << std::endl;
+
+  TransferProfile profile;
+  profile.deviceName = name;
+  for (size_t bytes = minBytes; bytes <= maxBytes; bytes *= 4) {
+    SweepBuffers buffers;
+    if (CreateSweepBuffers(engine.context(), engine.queue(), bytes,
+                           &buffers) != CL_SUCCESS) {
+      break;
+    }
+    // 小传输多测几次，大传输少测几次
+    int repeats = (int)std::max((size_t)3,
+                                std::min((size_t)20, ((size_t)256 << 20) / bytes));
+    double median[2][kTransferStrategyCount];
+    cl_int status = CL_SUCCESS;
+    for (int d = 0; d < 2 && status == CL_SUCCESS; d++) {
+      for (int s = 0; s < kTransferStrategyCount && status == CL_SUCCESS;
+           s++) {
+        std::vector<double> samples;
+        for (int r = 0; r <= repeats && status == CL_SUCCESS; r++) {
+          double seconds = 0;
+          status = TimeTransfer(engine.context(), engine.queue(),
+                                (TransferStrategy)s, d == 0, &buffers,
+                                &seconds);
+          if (r > 0) {  // 第一次作为预热
+            samples.push_back(seconds);
+          }
+        }
+        median[d][s] = Median(samples);
+      }
+    }
+    ReleaseSweepBuffers(engine.queue(), &buffers);
+    if (status != CL_SUCCESS) {
+      std::cout << "Transfer of " << bytes << " bytes failed: " << status
+                << std::endl;
+      return 1;
+    }
+
+    int best = 0;
+    for (int s = 1; s < kTransferStrategyCount; s++) {
+      if (median[0][s] + median[1][s] < median[0][best] + median[1][best]) {
+        best = s;
+      }
+    }
+    std::cout << std::left << std::setw(8) << FormatBytes(bytes) << std::right
+              << std::fixed << std::setprecision(2);
+    for (int d = 0; d < 2; d++) {
+      for (int s = 0; s < kTransferStrategyCount; s++) {
+        std::cout << std::setw(11)
+                  << (median[d][s] > 0 ? bytes / median[d][s] / 1e9 : 0.0);
+      }
+    }
+    std::cout << "  " << TransferStrategyName((TransferStrategy)best)
+              << std::endl;
+
+    // 相邻大小最快的方式相同时合并成一个区间
+    TransferProfile::Entry entry;
+    entry.maxBytes = bytes;
+    entry.strategy = (TransferStrategy)best;
+    if (!profile.entries.empty() &&
+        profile.entries.back().strategy == entry.strategy) {
+      profile.entries.back().maxBytes = bytes;
+    } else {
+      profile.entries.push_back(entry);
+    }
+  }
+
+  if (!profilePath.empty()) {
+    if (!SaveTransferProfile(profilePath, profile)) {
+      return 1;
+    }
+    std::cout << "transfer profile written to " << profilePath << std::endl;
+  }
+  return 0;
+}
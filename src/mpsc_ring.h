@@ -0,0 +1,123 @@
+#ifndef OPENCL_EXAMPLE_MPSC_RING_H_
+#define OPENCL_EXAMPLE_MPSC_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * @brief 有界、无锁的多生产者单消费者环形队列
+ * @note 每个槽位带一个序号（Dmitry Vyukov 的 bounded queue）：
+ *       - 生产者：读 head_，槽位序号等于 head_ 说明空闲，CAS 抢占后写入数据，
+ *         再把序号加一发布；槽位序号落后说明队列已满，TryPush 立即返回 false，
+ *         由调用方决定重试还是把“忙”反馈给上游（背压）。无竞争时只有一次 CAS。
+ *       - 消费者：只有一个线程，tail_ 不需要原子操作，出队没有任何循环等待，
+ *         TryPopBatch 一次取走多个元素。
+ *       T 需要可以默认构造和拷贝，通常是指针或者小的描述符结构。
+ */
+template <typename T>
+class MpscRing {
+ public:
+  /**
+   * @param capacity 容量，向上取整到 2 的幂
+   */
+  explicit MpscRing(size_t capacity) : head_(0), tail_(0) {
+    size_t n = 2;
+    while (n < capacity) {
+      n <<= 1;
+    }
+    mask_ = n - 1;
+    cells_.reset(new Cell[n]);
+    for (size_t i = 0; i < n; i++) {
+      cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+    pushFull_.store(0, std::memory_order_relaxed);
+    pushRetries_.store(0, std::memory_order_relaxed);
+  }
+
+  MpscRing(const MpscRing &) = delete;
+  MpscRing &operator=(const MpscRing &) = delete;
+
+  /**
+   * @brief 多个生产者线程可以同时调用
+   * @return 队列已满时返回 false
+   */
+  bool TryPush(const T &value) {
+    size_t pos = head_.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell &cell = cells_[pos & mask_];
+      size_t seq = cell.seq.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          cell.value = value;
+          cell.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+        pushRetries_.fetch_add(1, std::memory_order_relaxed);
+      } else if (diff < 0) {
+        pushFull_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * @brief 只能由唯一的消费者线程调用
+   */
+  bool TryPop(T *value) { return TryPopBatch(value, 1) == 1; }
+
+  /**
+   * @brief 最多取出 maxCount 个元素，只能由唯一的消费者线程调用
+   * @return 实际取出的个数，队列为空时返回 0
+   */
+  size_t TryPopBatch(T *out, size_t maxCount) {
+    size_t count = 0;
+    while (count < maxCount) {
+      Cell &cell = cells_[tail_ & mask_];
+      size_t seq = cell.seq.load(std::memory_order_acquire);
+      if (seq != tail_ + 1) {
+        break;
+      }
+      out[count++] = cell.value;
+      cell.seq.store(tail_ + mask_ + 1, std::memory_order_release);
+      tail_++;
+    }
+    return count;
+  }
+
+  /**
+   * @brief 只能由消费者线程调用，判断是否还有已发布的元素
+   */
+  bool Empty() const {
+    const Cell &cell = cells_[tail_ & mask_];
+    return cell.seq.load(std::memory_order_acquire) != tail_ + 1;
+  }
+
+  size_t capacity() const { return mask_ + 1; }
+  // 因队列满而失败的 TryPush 次数
+  uint64_t pushFull() const { return pushFull_.load(std::memory_order_relaxed); }
+  // 生产者之间 CAS 冲突的次数
+  uint64_t pushRetries() const {
+    return pushRetries_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Cell {
+    std::atomic<size_t> seq;
+    T value;
+  };
+
+  alignas(64) std::atomic<size_t> head_;
+  alignas(64) size_t tail_;
+  alignas(64) std::atomic<uint64_t> pushFull_;
+  std::atomic<uint64_t> pushRetries_;
+  size_t mask_;
+  std::unique_ptr<Cell[]> cells_;
+};
+
+#endif  // OPENCL_EXAMPLE_MPSC_RING_H_
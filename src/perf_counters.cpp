@@ -0,0 +1,135 @@
+#include "perf_counters.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static uint64_t HardwareCacheConfig(uint64_t cache) {
+  return cache | ((uint64_t)PERF_COUNT_HW_CACHE_OP_READ << 8) |
+         ((uint64_t)PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+static int OpenEvent(uint32_t type, uint64_t config, int groupFd) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  // 只有 group leader 初始为关闭，其他成员跟随 leader 一起启停
+  attr.disabled = groupFd < 0 ? 1 : 0;
+  // 只统计用户态，perf_event_paranoid <= 2 时普通用户也能打开
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format =
+      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, groupFd,
+                      PERF_FLAG_FD_CLOEXEC);
+}
+
+PerfSample::PerfSample() {
+  for (int i = 0; i < kPerfEventCount; i++) {
+    valid[i] = false;
+    value[i] = 0;
+  }
+}
+
+PerfSample &PerfSample::operator+=(const PerfSample &other) {
+  for (int i = 0; i < kPerfEventCount; i++) {
+    valid[i] = valid[i] || other.valid[i];
+    value[i] += other.value[i];
+  }
+  return *this;
+}
+
+PerfCounters::PerfCounters() : leader_(-1) {
+  for (int i = 0; i < kPerfEventCount; i++) {
+    fds_[i] = -1;
+  }
+}
+
+PerfCounters::~PerfCounters() { Close(); }
+
+const char *PerfCounters::Name(int event) {
+  switch (event) {
+    case kPerfCycles:
+      return "cycles";
+    case kPerfInstructions:
+      return "instructions";
+    case kPerfLlcMisses:
+      return "LLC-misses";
+    case kPerfDtlbMisses:
+      return "dTLB-misses";
+    case kPerfBranchMisses:
+      return "branch-misses";
+    default:
+      return "unknown";
+  }
+}
+
+bool PerfCounters::Open() {
+  Close();
+  const uint32_t types[kPerfEventCount] = {
+      PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+      PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE};
+  const uint64_t configs[kPerfEventCount] = {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+      HardwareCacheConfig(PERF_COUNT_HW_CACHE_LL),
+      HardwareCacheConfig(PERF_COUNT_HW_CACHE_DTLB),
+      PERF_COUNT_HW_BRANCH_MISSES};
+  for (int i = 0; i < kPerfEventCount; i++) {
+    fds_[i] = OpenEvent(types[i], configs[i], leader_);
+    if (fds_[i] < 0) {
+      std::cout << "perf_event_open(" << Name(i)
+                << ") failed: " << strerror(errno) << std::endl;
+      continue;
+    }
+    if (leader_ < 0) {
+      leader_ = fds_[i];
+    }
+  }
+  return leader_ >= 0;
+}
+
+void PerfCounters::Close() {
+  for (int i = 0; i < kPerfEventCount; i++) {
+    if (fds_[i] >= 0) {
+      close(fds_[i]);
+    }
+    fds_[i] = -1;
+  }
+  leader_ = -1;
+}
+
+void PerfCounters::Start() {
+  if (leader_ < 0) {
+    return;
+  }
+  ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+PerfSample PerfCounters::Stop() {
+  PerfSample sample;
+  if (leader_ < 0) {
+    return sample;
+  }
+  ioctl(leader_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  for (int i = 0; i < kPerfEventCount; i++) {
+    // read_format: value, time_enabled, time_running
+    uint64_t data[3] = {0, 0, 0};
+    if (fds_[i] < 0 || read(fds_[i], data, sizeof(data)) != sizeof(data) ||
+        data[2] == 0) {
+      continue;
+    }
+    sample.valid[i] = true;
+    sample.value[i] = data[2] < data[1]
+                          ? (uint64_t)((double)data[0] * data[1] / data[2])
+                          : data[0];
+  }
+  return sample;
+}
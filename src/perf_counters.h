@@ -0,0 +1,64 @@
+#ifndef OPENCL_EXAMPLE_PERF_COUNTERS_H_
+#define OPENCL_EXAMPLE_PERF_COUNTERS_H_
+
+#include <cstdint>
+
+/**
+ * ========== Linux 硬件性能计数器 ==========
+ * 通过 perf_event_open 把几个硬件事件打开成一个 group（同时调度、同时启停），
+ * 统计调用线程在 Start~Stop 之间的用户态事件数：
+ *  - cycles / instructions：得到 IPC，判断是不是卡在访存上
+ *  - LLC misses / dTLB misses：旋转是按列跳着写输出，容易打爆缓存和 TLB
+ *  - branch misses：rotate() 中 if (xpos >= 0 && ...) 的边界判断
+ *
+ * 容器、虚拟机或者 /proc/sys/kernel/perf_event_paranoid 过高时部分事件会打不开，
+ * 这些事件标记为不可用，其余照常统计。
+ */
+
+enum PerfEvent {
+  kPerfCycles = 0,
+  kPerfInstructions,
+  kPerfLlcMisses,
+  kPerfDtlbMisses,
+  kPerfBranchMisses,
+  kPerfEventCount
+};
+
+/**
+ * @brief 一次 Start~Stop 的计数结果
+ * @note 计数器被内核分时复用时，按 time_enabled / time_running 比例放大
+ */
+struct PerfSample {
+  PerfSample();
+  PerfSample &operator+=(const PerfSample &other);
+
+  bool valid[kPerfEventCount];
+  uint64_t value[kPerfEventCount];
+};
+
+class PerfCounters {
+ public:
+  PerfCounters();
+  ~PerfCounters();
+
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  /**
+   * @brief 打开计数器，至少有一个事件可用时返回 true
+   */
+  bool Open();
+  void Close();
+
+  void Start();
+  PerfSample Stop();
+
+  bool available(int event) const { return fds_[event] >= 0; }
+  static const char *Name(int event);
+
+ private:
+  int leader_;
+  int fds_[kPerfEventCount];
+};
+
+#endif  // OPENCL_EXAMPLE_PERF_COUNTERS_H_
@@ -1,9 +1,17 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
 #include <iostream>
 #include <string>
 #include <vector>
 
 #include <CL/opencl.hpp>
 
+#include "tclap/CmdLine.h"
+
+#include "rotate_cpu.h"
+
 static cl_int PrintPlatformInfoSummary(cl::Platform platform) {
   std::cout << "\tName:           " << platform.getInfo<CL_PLATFORM_NAME>()
             << "\n";
@@ -54,7 +62,223 @@ static cl_int PrintDeviceInfoSummary(const std::vector<cl::Device> devices) {
   return CL_SUCCESS;
 }
 
-int main(int, char **) {
+/**
+ * ========== Kernel 启动开销 ==========
+ * 静态的设备信息看不出一次 dispatch 要花多少时间。--launch-overhead 对每个设备测量：
+ *  - enqueue -> start：profiling event 的 QUEUED~START，命令在驱动里排队、下发的时间
+ *  - 空 kernel 吞吐：连续入队 N 个空 kernel 再 clFinish，每秒能发射多少次
+ *  - clFinish 往返：入队一个空 kernel 并 clFinish 的 host 端耗时，即单帧同步调用的固定开销
+ *  - clSetKernelArg：单次调用的耗时
+ *  - 小 buffer 的 read/write 与 map/unmap 延迟
+ * 最后和 CPU rotate() 每像素的耗时对比，给出“低于多少像素时一次 launch 的固定开销
+ * 就超过 CPU 直接旋转”的估计：低于这个尺寸必须批量提交，或者干脆走 CPU。
+ */
+static const char *kEmptyKernelSource =
+    "kernel void empty_kernel(global int *data) {}\n";
+
+static double Median(std::vector<double> values) {
+  if (values.empty()) {
+    return 0.0;
+  }
+  std::sort(values.begin(), values.end());
+  return values[values.size() / 2];
+}
+
+static double NowMicros() {
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+ * @brief CPU rotate() 每像素耗时（纳秒），取 512x512 上几次运行的最小值
+ */
+static double CpuRotateNanosPerPixel() {
+  const int size = 512;
+  std::vector<int> in(size * size, 1);
+  std::vector<int> out(size * size, 0);
+  double best = 0;
+  for (int i = 0; i < 5; i++) {
+    double start = NowMicros();
+    RotateCpu<int>(in.data(), out.data(), size, size, 0.5f, 0.8660254f);
+    double elapsed = NowMicros() - start;
+    if (best == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  return best * 1e3 / (size * size);
+}
+
+static cl_int MeasureLaunchOverhead(const cl::Device &device, int iterations) {
+  cl_int err = CL_SUCCESS;
+  cl::Context context(device, NULL, NULL, NULL, &err);
+  if (err != CL_SUCCESS) {
+    std::cout << "\tcl::Context failed: " << err << "\n";
+    return err;
+  }
+  cl::CommandQueue queue(context, device, CL_QUEUE_PROFILING_ENABLE, &err);
+  if (err != CL_SUCCESS) {
+    std::cout << "\tcl::CommandQueue failed: " << err << "\n";
+    return err;
+  }
+  cl::Program program(context, kEmptyKernelSource, false, &err);
+  if (err == CL_SUCCESS) {
+    err = program.build(std::vector<cl::Device>(1, device));
+  }
+  if (err != CL_SUCCESS) {
+    std::cout << "\tBuild failed: " << err << "\n"
+              << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device) << "\n";
+    return err;
+  }
+  cl::Kernel kernel(program, "empty_kernel", &err);
+  cl::Buffer dummy(context, CL_MEM_READ_WRITE, sizeof(cl_int), NULL, &err);
+  if (err != CL_SUCCESS) {
+    std::cout << "\tKernel setup failed: " << err << "\n";
+    return err;
+  }
+  kernel.setArg(0, dummy);
+  // 预热：第一次 launch 往往包含 JIT、驻留内存等一次性开销
+  queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(1),
+                             cl::NullRange);
+  queue.finish();
+
+  // 1. enqueue -> start 和 clFinish 往返
+  std::vector<double> queuedToStart;
+  std::vector<double> submitToStart;
+  std::vector<double> roundTrip;
+  for (int i = 0; i < iterations; i++) {
+    cl::Event event;
+    double start = NowMicros();
+    err = queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(1),
+                                     cl::NullRange, NULL, &event);
+    if (err == CL_SUCCESS) {
+      err = queue.finish();
+    }
+    if (err != CL_SUCCESS) {
+      std::cout << "\tenqueueNDRangeKernel failed: " << err << "\n";
+      return err;
+    }
+    roundTrip.push_back(NowMicros() - start);
+    cl_ulong queued = event.getProfilingInfo<CL_PROFILING_COMMAND_QUEUED>();
+    cl_ulong submit = event.getProfilingInfo<CL_PROFILING_COMMAND_SUBMIT>();
+    cl_ulong started = event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+    queuedToStart.push_back((started - queued) * 1e-3);
+    submitToStart.push_back((started - submit) * 1e-3);
+  }
+
+  // 2. 空 kernel 吞吐：只在最后同步一次
+  double start = NowMicros();
+  for (int i = 0; i < iterations; i++) {
+    queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(1),
+                               cl::NullRange);
+  }
+  queue.finish();
+  double throughput = iterations / ((NowMicros() - start) * 1e-6);
+
+  // 3. clSetKernelArg
+  const int setArgCalls = iterations * 100;
+  start = NowMicros();
+  for (int i = 0; i < setArgCalls; i++) {
+    kernel.setArg(0, dummy);
+  }
+  double setArgNanos = (NowMicros() - start) * 1e3 / setArgCalls;
+
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "\tLaunch overhead (median of " << iterations << "):\n";
+  std::cout << "\t  enqueue -> start:        " << Median(queuedToStart)
+            << " us\n";
+  std::cout << "\t  submit -> start:         " << Median(submitToStart)
+            << " us\n";
+  std::cout << "\t  clFinish round-trip:     " << Median(roundTrip) << " us\n";
+  std::cout << "\t  empty kernel throughput: " << throughput
+            << " launches/s\n";
+  std::cout << "\t  clSetKernelArg:          " << setArgNanos << " ns\n";
+
+  // 4. 小 buffer 的 read/write 与 map/unmap
+  const size_t sizes[] = {64, 4096, 65536, 1 << 20};
+  std::cout << "\t  " << std::setw(9) << "bytes" << std::setw(10) << "read"
+            << std::setw(10) << "write" << std::setw(14) << "map(R)+unmap"
+            << std::setw(14) << "map(W)+unmap" << "  (us)\n";
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    size_t bytes = sizes[s];
+    cl::Buffer buffer(context, CL_MEM_READ_WRITE, bytes, NULL, &err);
+    if (err != CL_SUCCESS) {
+      std::cout << "\tcl::Buffer failed: " << err << "\n";
+      return err;
+    }
+    std::vector<char> host(bytes, 0);
+    std::vector<double> readUs, writeUs, mapReadUs, mapWriteUs;
+    for (int i = 0; i < iterations; i++) {
+      double t0 = NowMicros();
+      queue.enqueueReadBuffer(buffer, CL_TRUE, 0, bytes, host.data());
+      double t1 = NowMicros();
+      queue.enqueueWriteBuffer(buffer, CL_TRUE, 0, bytes, host.data());
+      double t2 = NowMicros();
+      void *mapped = queue.enqueueMapBuffer(buffer, CL_TRUE, CL_MAP_READ, 0,
+                                            bytes, NULL, NULL, &err);
+      if (err == CL_SUCCESS) {
+        queue.enqueueUnmapMemObject(buffer, mapped);
+        queue.finish();
+      }
+      double t3 = NowMicros();
+      mapped = queue.enqueueMapBuffer(buffer, CL_TRUE, CL_MAP_WRITE, 0, bytes,
+                                      NULL, NULL, &err);
+      if (err == CL_SUCCESS) {
+        queue.enqueueUnmapMemObject(buffer, mapped);
+        queue.finish();
+      }
+      double t4 = NowMicros();
+      if (err != CL_SUCCESS) {
+        std::cout << "\tenqueueMapBuffer failed: " << err << "\n";
+        return err;
+      }
+      readUs.push_back(t1 - t0);
+      writeUs.push_back(t2 - t1);
+      mapReadUs.push_back(t3 - t2);
+      mapWriteUs.push_back(t4 - t3);
+    }
+    std::cout << "\t  " << std::setw(9) << bytes << std::setw(10)
+              << Median(readUs) << std::setw(10) << Median(writeUs)
+              << std::setw(14) << Median(mapReadUs) << std::setw(14)
+              << Median(mapWriteUs) << "\n";
+  }
+
+  // 5. 与 CPU rotate() 的盈亏平衡点
+  double cpuNanos = CpuRotateNanosPerPixel();
+  double breakEven = cpuNanos > 0 ? Median(roundTrip) * 1e3 / cpuNanos : 0;
+  std::cout << "\t  CPU rotate():            " << std::setprecision(2)
+            << cpuNanos << " ns/pixel\n";
+  std::cout << "\t  One synchronous launch costs as much as rotating "
+            << std::setprecision(0) << breakEven << " pixels (~"
+            << std::sqrt(breakEven) << "^2) on the CPU; batch frames or use "
+               "the CPU path below that size.\n";
+  std::cout.unsetf(std::ios::fixed);
+  return CL_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+  bool launchOverhead = false;
+  int iterations = 200;
+  try {
+    TCLAP::CmdLine cmd("OpenCL platform and device information", ' ', "0.1");
+    TCLAP::SwitchArg launchSwitch(
+        "l", "launch-overhead",
+        "Measure kernel launch, clFinish, clSetKernelArg and small transfer "
+        "latencies on every device",
+        cmd, false);
+    TCLAP::ValueArg<int> iterationsArg(
+        "n", "iterations", "Samples per launch-overhead measurement", false,
+        iterations, "int", cmd);
+    cmd.parse(argc, argv);
+    launchOverhead = launchSwitch.getValue();
+    iterations = std::max(1, iterationsArg.getValue());
+  } catch (TCLAP::ArgException &e) {
+    std::cerr << "error: " << e.error() << " for arg " << e.argId()
+              << std::endl;
+    return 1;
+  }
+
+
   std::vector<cl::Platform> platforms;
   cl::Platform::get(&platforms);
   std::cout << "Enumerated " << platforms.size() << " platforms.\n\n";
@@ -67,6 +291,13 @@ int main(int, char **) {
     platforms[i].getDevices(CL_DEVICE_TYPE_ALL, &devices);
 
     PrintDeviceInfoSummary(devices);
+    if (launchOverhead) {
+      for (size_t j = 0; j < devices.size(); j++) {
+        std::cout << "Device[" << j << "] "
+                  << devices[j].getInfo<CL_DEVICE_NAME>() << ":\n";
+        MeasureLaunchOverhead(devices[j], iterations);
+      }
+    }
     std::cout << "\n";
   }
 
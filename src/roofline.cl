@@ -0,0 +1,33 @@
+/**
+ * @brief 带宽 micro-kernel：每个 work-item 拷贝一个 float4，
+ *        读 16B + 写 16B，没有计算，测得的是设备能达到的全局内存带宽
+ */
+kernel void roofline_copy(global const float4 * src, global float4 * dst)
+{
+   const size_t i = get_global_id(0);
+   dst[i] = src[i];
+}
+
+#define ROOFLINE_FMA_ITERATIONS 256
+
+/**
+ * @brief 算力 micro-kernel：4 条互不依赖的 float4 mad 链，隐藏指令延迟，
+ *        每个 work-item 做 ROOFLINE_FMA_ITERATIONS * 4 * 4 次 mad（按 2 FLOP 计），
+ *        最后写回一个值防止编译器把计算优化掉
+ */
+kernel void roofline_fma(global float * dst, float a, float b)
+{
+   const size_t i = get_global_id(0);
+   float4 x0 = (float4)(i, i + 1, i + 2, i + 3);
+   float4 x1 = x0 + 4.0f;
+   float4 x2 = x0 + 8.0f;
+   float4 x3 = x0 + 12.0f;
+   for (int k = 0; k < ROOFLINE_FMA_ITERATIONS; k++) {
+      x0 = mad(x0, a, b);
+      x1 = mad(x1, a, b);
+      x2 = mad(x2, a, b);
+      x3 = mad(x3, a, b);
+   }
+   float4 s = x0 + x1 + x2 + x3;
+   dst[i] = s.x + s.y + s.z + s.w;
+}
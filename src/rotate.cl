@@ -1,7 +1,26 @@
 // pragma OPENCL EXTENSION cl_amd_printf : enable
+// 按变体拆分编译时 host 传入 -DROTATE_VARIANT=n（与 rotate_engine.h 的 RotateVariant 一致），
+// 只编译该变体的 kernel；不定义时整个文件作为一个 program 编译
+#define ROTATE_VARIANT_CORE 0
+#define ROTATE_VARIANT_BATCH 1
+#define ROTATE_VARIANT_LAYOUT 2
+#define ROTATE_VARIANT_YUV 3
+#define ROTATE_VARIANT_RESAMPLE 4
+#ifdef ROTATE_VARIANT
+#define ROTATE_HAS_VARIANT(v) (ROTATE_VARIANT == (v))
+#else
+#define ROTATE_HAS_VARIANT(v) 1
+#endif
+
+#if ROTATE_HAS_VARIANT(ROTATE_VARIANT_CORE)
+/**
+ * @brief 单帧旋转
+ * @note srcPitch / dstPitch 为输入、输出的行跨度（以像素计），紧密排列时等于 W
+ */
 kernel void image_rotate(
       global int * src_data,
-      global int * dest_data, int W, int H, float sinTheta, float cosTheta )
+      global int * dest_data, int W, int H, float sinTheta, float cosTheta,
+      int srcPitch, int dstPitch )
 {
    // get_global_id 用于获取当前线程的全局坐标，决定每个线程处理的数据块。
    const int ix = get_global_id(0);
@@ -11,5 +30,272 @@ kernel void image_rotate(
    int xpos =  ( ix-xc)*cosTheta - (iy-yc)*sinTheta+xc;
    int ypos =  (ix-xc)*sinTheta + ( iy-yc)*cosTheta+yc;
    if ((xpos>=0) && (xpos< W)   && (ypos>=0) && (ypos< H))
-      dest_data[ypos*W+xpos]= src_data[iy*W+ix];
-}
\ No newline at end of file
+      dest_data[ypos*dstPitch+xpos]= src_data[iy*srcPitch+ix];
+}
+
+/**
+ * @brief 与 image_rotate 相同，标量参数打包成一个按值传递的结构体
+ * @note 字段与 host 端 rotate_kernel_args.h 的 RotateKernelParams 一一对应，
+ *       任何一个标量变化时 host 只需要一次 clSetKernelArg
+ */
+typedef struct {
+   int W;
+   int H;
+   float sinTheta;
+   float cosTheta;
+   int srcPitch;
+   int dstPitch;
+} RotateParams;
+
+kernel void image_rotate_packed(
+      global int * src_data,
+      global int * dest_data, RotateParams p )
+{
+   const int ix = get_global_id(0);
+   const int iy = get_global_id(1);
+   int xc = p.W/2;
+   int yc = p.H/2;
+   int xpos =  ( ix-xc)*p.cosTheta - (iy-yc)*p.sinTheta+xc;
+   int ypos =  (ix-xc)*p.sinTheta + ( iy-yc)*p.cosTheta+yc;
+   if ((xpos>=0) && (xpos< p.W)   && (ypos>=0) && (ypos< p.H))
+      dest_data[ypos*p.dstPitch+xpos]= src_data[iy*p.srcPitch+ix];
+}
+#endif
+
+#if ROTATE_HAS_VARIANT(ROTATE_VARIANT_BATCH)
+
+/**
+ * @brief 批量旋转：一次 launch 处理 N 帧相同尺寸的图像
+ * @note 第三维 get_global_id(2) 是帧序号，每帧的 sin/cos 放在 sincos 数组中，
+ *       帧在 src_data/dest_data 中依次排列，每帧占 pitch*H 个像素
+ */
+kernel void image_rotate_batch(
+      global int * src_data,
+      global int * dest_data, int W, int H, global float2 * sincos,
+      int srcPitch, int dstPitch )
+{
+   const int ix = get_global_id(0);
+   const int iy = get_global_id(1);
+   const int iz = get_global_id(2);
+   const float sinTheta = sincos[iz].x;
+   const float cosTheta = sincos[iz].y;
+   global int * src = src_data + iz*srcPitch*H;
+   global int * dest = dest_data + iz*dstPitch*H;
+   int xc = W/2;
+   int yc = H/2;
+   int xpos =  ( ix-xc)*cosTheta - (iy-yc)*sinTheta+xc;
+   int ypos =  (ix-xc)*sinTheta + ( iy-yc)*cosTheta+yc;
+   if ((xpos>=0) && (xpos< W)   && (ypos>=0) && (ypos< H))
+      dest[ypos*dstPitch+xpos]= src[iy*srcPitch+ix];
+}
+#endif
+
+#if ROTATE_HAS_VARIANT(ROTATE_VARIANT_LAYOUT)
+
+/**
+ * @brief 源图为 tile 排列的单帧旋转（排列方式见 rotate_image.h 的 TileImage）
+ * @note 一维全局尺寸为 TiledElements，第 e 个 work-item 读 src_data[e]，读依然连续；
+ *       tile*tile 个相邻 work-item 覆盖源图中的一个小方块，写出的位置集中在旋转后的
+ *       小方块里，而不是整幅图上的一条斜线。tile = 1 << tileShift，补齐的像素直接跳过
+ */
+kernel void image_rotate_tiled(
+      global int * src_data,
+      global int * dest_data, int W, int H, float sinTheta, float cosTheta,
+      int tileShift, int dstPitch )
+{
+   const int e = get_global_id(0);
+   const int tile = 1 << tileShift;
+   const int t = e >> (2*tileShift);
+   const int o = e & ((tile*tile)-1);
+   const int tilesX = (W + tile - 1) >> tileShift;
+   const int ix = ((t % tilesX) << tileShift) + (o & (tile-1));
+   const int iy = ((t / tilesX) << tileShift) + (o >> tileShift);
+   if (ix >= W || iy >= H)
+      return;
+   int xc = W/2;
+   int yc = H/2;
+   int xpos =  ( ix-xc)*cosTheta - (iy-yc)*sinTheta+xc;
+   int ypos =  (ix-xc)*sinTheta + ( iy-yc)*cosTheta+yc;
+   if ((xpos>=0) && (xpos< W)   && (ypos>=0) && (ypos< H))
+      dest_data[ypos*dstPitch+xpos]= src_data[e];
+}
+
+/**
+ * @brief 条带旋转：只处理落在输出第 [dstRow0, dstRow0+dstRows) 行的像素
+ * @note src、dest 都是父 buffer 的 sub-buffer。src 覆盖源图第 srcRow0 行起、
+ *       可能映射进本条带的所有行（halo），第 srcRow0 行从 src[srcBase] 开始；
+ *       dest 的第 dstRow0 行从 dest[dstBase] 开始。sub-buffer 的起点按设备的
+ *       CL_DEVICE_MEM_BASE_ADDR_ALIGN 对齐，base 就是对齐后剩下的偏移（元素）
+ */
+kernel void image_rotate_band(
+      global int * src,
+      global int * dest, int W, int H, float sinTheta, float cosTheta,
+      int srcPitch, int dstPitch, int srcRow0, int srcBase,
+      int dstRow0, int dstRows, int dstBase )
+{
+   const int ix = get_global_id(0);
+   const int iy = srcRow0 + get_global_id(1);
+   int xc = W/2;
+   int yc = H/2;
+   int xpos =  ( ix-xc)*cosTheta - (iy-yc)*sinTheta+xc;
+   int ypos =  (ix-xc)*sinTheta + ( iy-yc)*cosTheta+yc;
+   if ((xpos>=0) && (xpos< W) && (ypos>=dstRow0) && (ypos< dstRow0+dstRows))
+      dest[dstBase + (ypos-dstRow0)*dstPitch + xpos] =
+            src[srcBase + (iy-srcRow0)*srcPitch + ix];
+}
+#endif
+
+#if ROTATE_HAS_VARIANT(ROTATE_VARIANT_YUV)
+
+/**
+ * @brief YUV420 旋转：一次 launch 同时处理亮度平面和半分辨率的色度平面
+ * @note 全局尺寸为亮度平面 W*H，每个 work-item 搬运一个亮度样本；
+ *       ix < W/2 且 iy < H/2 的 work-item 再搬运一个色度样本，色度平面以它自己的中心
+ *       ((W/2)/2, (H/2)/2) 旋转，与亮度中心缩放一半后对齐。
+ *       semiPlanar 为 0 时是 I420（U、V 两个平面），为 1 时是 NV12/NV21（UV 交错，
+ *       按 uchar2 整体搬运）。
+ *       srcPitch / dstPitch 是亮度平面的行跨度（字节，偶数），色度平面从 pitch*H 开始；
+ *       I420 的 U、V 平面行跨度为 pitch/2，NV12/NV21 的 UV 平面行跨度为 pitch 字节
+ */
+kernel void image_rotate_yuv(
+      global uchar * src_data,
+      global uchar * dest_data, int W, int H, float sinTheta, float cosTheta,
+      int semiPlanar, int srcPitch, int dstPitch )
+{
+   const int ix = get_global_id(0);
+   const int iy = get_global_id(1);
+   int xc = W/2;
+   int yc = H/2;
+   int xpos =  ( ix-xc)*cosTheta - (iy-yc)*sinTheta+xc;
+   int ypos =  (ix-xc)*sinTheta + ( iy-yc)*cosTheta+yc;
+   if ((xpos>=0) && (xpos< W)   && (ypos>=0) && (ypos< H))
+      dest_data[ypos*dstPitch+xpos]= src_data[iy*srcPitch+ix];
+
+   const int CW = W/2;
+   const int CH = H/2;
+   if (ix >= CW || iy >= CH)
+      return;
+   xc = CW/2;
+   yc = CH/2;
+   xpos =  ( ix-xc)*cosTheta - (iy-yc)*sinTheta+xc;
+   ypos =  (ix-xc)*sinTheta + ( iy-yc)*cosTheta+yc;
+   if ((xpos<0) || (xpos>= CW) || (ypos<0) || (ypos>= CH))
+      return;
+   global uchar * src_chroma = src_data + srcPitch*H;
+   global uchar * dest_chroma = dest_data + dstPitch*H;
+   // 色度行跨度：I420 每个平面 pitch/2 字节，NV12/NV21 是 pitch/2 个 uchar2
+   const int srcCP = srcPitch/2;
+   const int dstCP = dstPitch/2;
+   if (semiPlanar) {
+      vstore2(vload2(iy*srcCP+ix, src_chroma), ypos*dstCP+xpos, dest_chroma);
+   } else {
+      dest_chroma[ypos*dstCP+xpos] = src_chroma[iy*srcCP+ix];
+      dest_chroma[dstCP*CH + ypos*dstCP+xpos] = src_chroma[srcCP*CH + iy*srcCP+ix];
+   }
+}
+#endif
+
+#if ROTATE_HAS_VARIANT(ROTATE_VARIANT_RESAMPLE)
+// 取值与 host 端 rotate_resample.h 的 RotateSampling / kLanczosPhases / kAreaPhases 一致
+#define ROTATE_SAMPLE_BILINEAR 0
+#define ROTATE_SAMPLE_LANCZOS3 1
+#define ROTATE_SAMPLE_AREA 2
+#define ROTATE_LANCZOS_PHASES 64
+#define ROTATE_LANCZOS_TAPS 6
+#define ROTATE_AREA_PHASES 8
+#define ROTATE_AREA_TAPS 4
+
+/**
+ * @brief 取一个源像素的 4 个通道，图外返回背景
+ */
+inline float4 load_pixel(global const uchar4 * src, int x, int y, int W, int H,
+                         int pitch, float4 background)
+{
+   if (x < 0 || x >= W || y < 0 || y >= H)
+      return background;
+   return convert_float4(src[y*pitch+x]);
+}
+
+/**
+ * @brief inside 为真时整个滤波窗口都在图内（绝大多数像素），省掉逐个抽头的边界判断
+ */
+inline float4 load_tap(global const uchar4 * src, int x, int y, int W, int H,
+                       int pitch, float4 background, bool inside)
+{
+   return inside ? convert_float4(src[y*pitch+x])
+                 : load_pixel(src, x, y, W, H, pitch, background);
+}
+
+/**
+ * @brief 重采样旋转（gather）：每个输出像素逆旋转回源图坐标，再按 mode 滤波
+ * @note 与正向映射的 kernel 不同，每个输出像素都会被写到，不需要预先填充背景。
+ *       int 像素按 uchar4 的 4 个通道分别滤波（见 rotate_resample.h）。
+ *       weights 是 host 预先算好的权重表（constant 内存）：lanczos3 按小数部分的相位
+ *       查一维权重、两个方向分开累加；area 按二维相位查 4x4 的覆盖面积。
+ *       逆映射超出源图半个像素以上时直接输出背景
+ */
+kernel void image_rotate_resample(
+      global const uchar4 * src_data,
+      global uchar4 * dest_data, int W, int H, float sinTheta, float cosTheta,
+      int srcPitch, int dstPitch, int mode, constant float * weights,
+      int background )
+{
+   const int ox = get_global_id(0);
+   const int oy = get_global_id(1);
+   const float xc = W/2;
+   const float yc = H/2;
+   const float dx = ox - xc;
+   const float dy = oy - yc;
+   const float sx = dx*cosTheta + dy*sinTheta + xc;
+   const float sy = -dx*sinTheta + dy*cosTheta + yc;
+   const uchar4 bg = as_uchar4(background);
+   if (sx < -0.5f || sx > W - 0.5f || sy < -0.5f || sy > H - 0.5f) {
+      dest_data[oy*dstPitch+ox] = bg;
+      return;
+   }
+   const float4 bgf = convert_float4(bg);
+   const float fx = floor(sx);
+   const float fy = floor(sy);
+   const int x0 = (int)fx;
+   const int y0 = (int)fy;
+   const float ax = sx - fx;
+   const float ay = sy - fy;
+   float4 acc = (float4)(0.0f);
+   if (mode == ROTATE_SAMPLE_LANCZOS3) {
+      // 可分离：每行先按 x 方向的 6 个权重求和，再乘 y 方向的权重累加
+      constant float * wx = weights +
+            (int)(ax*ROTATE_LANCZOS_PHASES + 0.5f)*ROTATE_LANCZOS_TAPS;
+      constant float * wy = weights +
+            (int)(ay*ROTATE_LANCZOS_PHASES + 0.5f)*ROTATE_LANCZOS_TAPS;
+      const bool inside = x0 >= 2 && x0 + 3 < W && y0 >= 2 && y0 + 3 < H;
+      for (int j = 0; j < ROTATE_LANCZOS_TAPS; j++) {
+         float4 row = (float4)(0.0f);
+         for (int i = 0; i < ROTATE_LANCZOS_TAPS; i++)
+            row += wx[i] * load_tap(src_data, x0-2+i, y0-2+j, W, H,
+                                    srcPitch, bgf, inside);
+         acc += wy[j] * row;
+      }
+   } else if (mode == ROTATE_SAMPLE_AREA) {
+      // 旋转后的像素方块不可分离，按二维相位直接查 4x4 个覆盖面积
+      const int px = (int)(ax*ROTATE_AREA_PHASES + 0.5f);
+      const int py = (int)(ay*ROTATE_AREA_PHASES + 0.5f);
+      constant float * wt = weights +
+            (py*(ROTATE_AREA_PHASES+1) + px)*ROTATE_AREA_TAPS*ROTATE_AREA_TAPS;
+      const bool inside = x0 >= 1 && x0 + 2 < W && y0 >= 1 && y0 + 2 < H;
+      for (int j = 0; j < ROTATE_AREA_TAPS; j++)
+         for (int i = 0; i < ROTATE_AREA_TAPS; i++)
+            acc += wt[j*ROTATE_AREA_TAPS+i] *
+                   load_tap(src_data, x0-1+i, y0-1+j, W, H, srcPitch, bgf,
+                            inside);
+   } else {
+      const float wx[2] = {1.0f - ax, ax};
+      const float wy[2] = {1.0f - ay, ay};
+      const bool inside = x0 >= 0 && x0 + 1 < W && y0 >= 0 && y0 + 1 < H;
+      for (int j = 0; j < 2; j++)
+         for (int i = 0; i < 2; i++)
+            acc += wy[j] * wx[i] *
+                   load_tap(src_data, x0+i, y0+j, W, H, srcPitch, bgf, inside);
+   }
+   dest_data[oy*dstPitch+ox] = convert_uchar4_sat_rte(acc);
+}
+#endif
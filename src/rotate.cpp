@@ -1,13 +1,25 @@
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <cmath>
 #include <cstring>
+#include <csignal>
 
 #include <CL/cl.h>
 
+#include "tclap/CmdLine.h"
+
+#include "rotate_angle.h"
+#include "rotate_cpu.h"
+#include "rotate_daemon.h"
+#include "rotate_engine.h"
+#include "rotate_failover.h"
+#include "rotate_metrics.h"
+#include "rotate_trace.h"
+
 /**
  * ========== 图像旋转原理 ==========
  * 图像旋转定义为：将图像绕某个点旋转一定的角度。通常是指绕图像的中心点以逆时针方向旋转。
@@ -15,29 +27,12 @@
  * 对于图像中的每个像素点(x, y)，其旋转后的新坐标(x',
  * y')可以通过以下公式计算得到： x' = (x - cx) * cos(angle) - (y - cy) *
  * sin(angle) + cx y' = (x - cx) * sin(angle) + (y - cy) * cos(angle) + cy
+ *
+ * CPU 实现见 rotate_cpu.h，OpenCL C Kernel 代码见 rotate.cl。
  */
 
 /**
- * @brief 图像旋转函数
- * @note OpenCL C Kernel 代码见 rotate.cl
- */
-void rotate(unsigned char *inbuf, unsigned char *outbuf, int w, int h,
-            float sinTheta, float cosTheta) {
-  int i, j;
-  int xc = w / 2;
-  int yc = h / 2;
-  for (i = 0; i < h; i++) {
-    for (j = 0; j < w; j++) {
-      int xpos = (j - xc) * cosTheta - (i - yc) * sinTheta + xc;
-      int ypos = (j - xc) * sinTheta + (i - yc) * cosTheta + yc;
-      if (xpos >= 0 && ypos >= 0 && xpos < w && ypos < h)
-        outbuf[ypos * w + xpos] = inbuf[i * w + j];
-    }
-  }
-}
-
-/**
- * 使用OpenCL进行编程的一般流程：
+ * 使用OpenCL进行编程的一般流程（具体实现见 rotate_engine.cpp）：
  *  - Platform
  *    - 1. 查询并选择一个Platform
  *    - 2. 在Platform上创建一个Context
@@ -53,226 +48,392 @@ void rotate(unsigned char *inbuf, unsigned char *outbuf, int w, int h,
  *    - 11. 读取kernel执行结果，返回给host
  *    - Cleanup
  *
+ * 1~6 和 9 只需要执行一次，所以引擎初始化后可以常驻（--daemon），
+ * 之后每帧只需要 7、8、10、11。
  */
 
+#ifndef OPENCL_EXAMPLE_KERNEL_DIR
+#define OPENCL_EXAMPLE_KERNEL_DIR "/mnt/workspace/cgz_workspace/Exercise/opencl_example/src"
+#endif
+
 static const int WIDTH = 6;
 static const int HEIGHT = 6;
-static const int IMAGE_SIZE = WIDTH * HEIGHT;
-static const float SIN = 1.0;
-static const float COS = 0.0;
+static const float ANGLE = 90.0f;
 
-int main(int argc, char **argv) {
-  /*********************************** 查询并选择一个Platform ************************************/
-  // 1.1 获取系统中所有的Platform
-  cl_int status = 0;
-  cl_uint numPlatforms;
-  cl_platform_id platform = NULL;
-  status = clGetPlatformIDs(0, NULL, &numPlatforms);
-  if (status != CL_SUCCESS) {
-    std::cout << "clGetPlatformIDs failed (1)" << std::endl;
-    return 1;
+static RotateDaemon *g_daemon = NULL;
+
+static void HandleStopSignal(int) {
+  if (g_daemon != NULL) {
+    g_daemon->Stop();
   }
+}
 
-  // 1.2 根据查询到的Platform数量，申请相应大小的内存，并获取所有Platform ID
-  if (numPlatforms > 0) {
-    cl_platform_id *platforms =
-        (cl_platform_id *)malloc(numPlatforms * sizeof(cl_platform_id));
-    status = clGetPlatformIDs(numPlatforms, platforms, NULL);
-    if (status != CL_SUCCESS) {
-      printf("Error: Getting Platform Ids.(clGetPlatformIDs)\n");
-      return -1;
-    }
-    std::cout << "Number of platforms: " << numPlatforms << std::endl;
+static cl_device_type ParseDeviceType(const std::string &name) {
+  if (name == "cpu") return CL_DEVICE_TYPE_CPU;
+  if (name == "all") return CL_DEVICE_TYPE_ALL;
+  return CL_DEVICE_TYPE_GPU;
+}
 
-    for (unsigned int i = 0; i < numPlatforms; ++i) {
-      char pbuff[100];
-      status = clGetPlatformInfo(platforms[i], CL_PLATFORM_VENDOR,
-                                 sizeof(pbuff), pbuff, NULL);
-      std::cout << "Platform " << i << " : Vendor" << pbuff << std::endl;
-      platform = platforms[i];
+static void PrintPlane(const char *name, const unsigned char *plane, int w,
+                       int h, int step) {
+  std::cout << name << ":" << std::endl;
+  for (int i = 0; i < h; i++) {
+    for (int j = 0; j < w * step; j++) {
+      std::cout << (int)plane[i * w * step + j] << " ";
     }
-
-    delete platforms;
+    std::cout << std::endl;
   }
+}
 
-  /*********************************** 在Platform上创建一个Context ************************************/
-  // 2.1. 通过platform得到相应的context properties
-  cl_context_properties cps[3] = {CL_CONTEXT_PLATFORM,
-                                  (cl_context_properties)platform, 0};
-  cl_context_properties *cprops = (NULL == platform) ? NULL : cps;
-  
-  // 2.2. 创建context
-  cl_context context = clCreateContextFromType(cprops, CL_DEVICE_TYPE_GPU, NULL,
-                                               NULL, &status);
+/**
+ * @brief 单次旋转一帧 int 图像；没有可用设备或设备出错时由 FailoverRotator 改在 CPU 上完成
+ */
+static int RotateIntFrame(const std::string &kernelPath,
+                          cl_device_type deviceType,
+                          const std::string &transferProfilePath,
+                          const FailoverOptions &options, int width, int height,
+                          float sinTheta, float cosTheta,
+                          const std::string &metricsPath,
+                          const std::string &traceFile) {
+  FailoverRotator rotator(options);
+  rotator.Init(kernelPath, deviceType, transferProfilePath);
+  const int imageSize = width * height;
+  std::vector<int> inbuffer(imageSize);
+  // 输出不需要在 host 上清零：背景由引擎在设备端用 clEnqueueFillBuffer 填充
+  std::unique_ptr<int[]> outbuffer(new int[imageSize]);
+  for (int i = 0; i < imageSize; i++) {
+    inbuffer[i] = i;
+  }
+  cl_int status = rotator.Rotate(inbuffer.data(), width, outbuffer.get(),
+                                 width, width, height, sinTheta, cosTheta);
+  Metrics().errors.Add(status);
+  ROTATE_TRACE_DUMP(traceFile);
+  if (!metricsPath.empty()) {
+    WriteMetricsFile(metricsPath);
+  }
   if (status != CL_SUCCESS) {
-    std::cout << "clCreateContextFromType failed." << std::endl;
     return 1;
   }
+  for (int i = 0; i < height; i++) {
+    for (int j = 0; j < width; j++) {
+      std::cout << outbuffer[i * width + j] << " ";
+    }
+    std::cout << std::endl;
+  }
+  if (!rotator.onDevice()) {
+    rotator.PrintStats(std::cout);
+  }
+  return 0;
+}
 
-  /*********************************** 在Context上查询并创建一个或多个device ************************************/
-  // 3.1. 查询可用的device
-  size_t deviceListSize;
-  status = clGetContextInfo(context, CL_CONTEXT_DEVICES, 0, NULL,
-                            &deviceListSize);
-  if (status != CL_SUCCESS) {
-    std::cout << "clGetContextInfo failed (1)." << std::endl;
-    return 1;
+/**
+ * @brief 单次旋转一帧 YUV420，并与 CPU 参考实现比对
+ */
+static int RotateYuvFrame(RotateEngine *engine, int width, int height,
+                          YuvFormat format, float sinTheta, float cosTheta,
+                          const std::string &metricsPath,
+                          const std::string &traceFile) {
+  size_t bytes = YuvFrameBytes(width, height);
+  std::vector<unsigned char> inbuffer(bytes);
+  std::vector<unsigned char> outbuffer(bytes, 0);
+  std::vector<unsigned char> expected(bytes, 0);
+  for (size_t i = 0; i < bytes; i++) {
+    inbuffer[i] = (unsigned char)i;
   }
-  std::cout << "deviceListSize = " << deviceListSize << std::endl;
-  cl_device_id *devices =
-      (cl_device_id *)malloc(deviceListSize * sizeof(cl_device_id));
-  if(devices == NULL) {
-    std::cout << "Failed to allocate memory for devices." << std::endl;
-    return 1;
+  cl_int status = engine->RotateYuv(inbuffer.data(), outbuffer.data(), width,
+                                    height, format, sinTheta, cosTheta);
+  Metrics().errors.Add(status);
+  ROTATE_TRACE_DUMP(traceFile);
+  if (!metricsPath.empty()) {
+    WriteMetricsFile(metricsPath);
   }
-  status = clGetContextInfo(context, CL_CONTEXT_DEVICES, deviceListSize,
-                            devices, NULL);
   if (status != CL_SUCCESS) {
-    std::cout << "clGetContextInfo failed (2)." << std::endl;
     return 1;
   }
+  RotateYuvCpu(inbuffer.data(), expected.data(), width, height, format,
+               sinTheta, cosTheta);
 
-  /************************************* Running Time **********************************/
-  // 4.1. 加载OpenCL内核程序并创建一个Program对象
-  std::ifstream kernelFile("/mnt/workspace/cgz_workspace/Exercise/opencl_example/src/rotate.cl", std::ios::in);
-  if(!kernelFile.is_open()) {
-    std::cout << "Failed to open kernel file." << std::endl;
-    return 1;
+  const unsigned char *chroma = outbuffer.data() + (size_t)width * height;
+  int cw = width / 2;
+  int ch = height / 2;
+  PrintPlane("Y", outbuffer.data(), width, height, 1);
+  if (IsSemiPlanar(format)) {
+    PrintPlane(format == kYuvNV12 ? "UV" : "VU", chroma, cw, ch, 2);
+  } else {
+    PrintPlane("U", chroma, cw, ch, 1);
+    PrintPlane("V", chroma + (size_t)cw * ch, cw, ch, 1);
   }
-  std::stringstream ss;
-  ss << kernelFile.rdbuf();
-  std::string kernelSource = ss.str();
-  const char *kernelSourceCStr = kernelSource.c_str();
-  size_t kernelSourceSize = kernelSource.size();
-  kernelFile.close();
-  cl_program program = clCreateProgramWithSource(context, 1,
-                                                 (const char **)&kernelSourceCStr,
-                                                 NULL, NULL);
-  if (status != CL_SUCCESS) {
-    std::cout << "clCreateProgramWithSource failed." << std::endl;
+  if (outbuffer != expected) {
+    std::cout << "Mismatch against the CPU reference." << std::endl;
     return 1;
   }
-  // 4.2. 为指定的device编译Program中的kernel
-  status = clBuildProgram(program, 1, &devices[0], NULL, NULL, NULL);
-  if (status != CL_SUCCESS) {
-    std::cout << "clBuildProgram failed." << std::endl;
-    return 1;
+  return 0;
+}
+
+/**
+ * @brief 单次旋转一帧，输入输出都由 AllocFrame 分配（SVM），kernel 直接访问应用的内存
+ */
+static int RotateSvmFrame(RotateEngine *engine, int width, int height,
+                          float sinTheta, float cosTheta,
+                          const std::string &metricsPath,
+                          const std::string &traceFile) {
+  std::cout << "SVM: "
+            << (!engine->svmSupported()
+                    ? "not supported, falling back to buffers"
+                    : engine->svmFineGrained() ? "fine-grained buffer"
+                                               : "coarse-grained buffer")
+            << std::endl;
+  size_t bytes = (size_t)width * height * sizeof(int);
+  int *inbuffer = (int *)engine->AllocFrame(bytes);
+  int *outbuffer = (int *)engine->AllocFrame(bytes);
+  cl_int status = CL_OUT_OF_HOST_MEMORY;
+  if (inbuffer != NULL && outbuffer != NULL) {
+    for (int i = 0; i < width * height; i++) {
+      inbuffer[i] = i;
+      outbuffer[i] = 0;
+    }
+    status = engine->RotateSvm(inbuffer, width, outbuffer, width, width,
+                               height, sinTheta, cosTheta);
   }
-  // 4.3. 创建指定名字的kernel对象
-  cl_kernel kernel = clCreateKernel(program, "image_rotate", &status);
-  if (status != CL_SUCCESS) {
-    std::cout << "clCreateKernel failed." << std::endl;
-    return 1;
+  Metrics().errors.Add(status);
+  ROTATE_TRACE_DUMP(traceFile);
+  if (!metricsPath.empty()) {
+    WriteMetricsFile(metricsPath);
   }
-  // 4.4. 为kernel创建内存对象
-  int * outbuffer = (int *)malloc(WIDTH * HEIGHT * sizeof(int));
-  memset(outbuffer, 0, WIDTH * WIDTH * sizeof(int));
-  int * inbuffer = new int[IMAGE_SIZE];
-  for (int i = 0; i < IMAGE_SIZE; i++) {
-    inbuffer[i] = i;
+  if (status == CL_SUCCESS) {
+    for (int i = 0; i < height; i++) {
+      for (int j = 0; j < width; j++) {
+        std::cout << outbuffer[i * width + j] << " ";
+      }
+      std::cout << std::endl;
+    }
   }
-  cl_mem inputBuffer = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
-                                      IMAGE_SIZE * sizeof(int), inbuffer, &status);
-  if (status != CL_SUCCESS) {
-    std::cout << "clCreateBuffer failed." << std::endl;
-    return 1;
-  }                              
-  cl_mem outputBuffer = clCreateBuffer(context, CL_MEM_READ_WRITE,
-                                       IMAGE_SIZE * sizeof(int),
-                                       NULL, &status);
-  if (status != CL_SUCCESS) {
-    std::cout << "clCreateBuffer failed." << std::endl;
-    return 1;
-  }                                       
-  cl_int widthParam = WIDTH;
-  cl_int heightParam = HEIGHT;
-  cl_float sinParam = SIN;
-  cl_float cosParam = COS;
-  // 4.5. 设置kernel参数
-  status = clSetKernelArg(kernel, 0, sizeof(cl_mem), &inputBuffer);
-  if (status != CL_SUCCESS) {
-    std::cout << "clSetKernelArg failed." << __LINE__ << std::endl;  
-    return 1;
-  }  
-  status = clSetKernelArg(kernel, 1, sizeof(cl_mem), &outputBuffer);
-  if (status != CL_SUCCESS) {
-    std::cout << "clSetKernelArg failed." << __LINE__ << std::endl;  
-    return 1;
-  }  
-  status = clSetKernelArg(kernel, 2, sizeof(cl_int), (void*)&widthParam);
-  if (status != CL_SUCCESS) {
-    std::cout << "clSetKernelArg failed." << __LINE__ << std::endl;  
-    return 1;
-  }  
-  status = clSetKernelArg(kernel, 3, sizeof(cl_int), &heightParam);
-  if (status != CL_SUCCESS) {
-    std::cout << "clSetKernelArg failed." << __LINE__ << std::endl;  
-    return 1;
-  }    
-  status = clSetKernelArg(kernel, 4, sizeof(cl_float), &sinParam);
-  if (status != CL_SUCCESS) {
-    std::cout << "clSetKernelArg failed." << __LINE__ << std::endl;  
-    return 1;
-  }    
-  status = clSetKernelArg(kernel, 5, sizeof(cl_float), &cosParam);
-  if (status != CL_SUCCESS) {
-    std::cout << "clSetKernelArg failed." << __LINE__ << std::endl;  
-    return 1;
-  }  
-  // 4.6. 在指定的device上创建一个Command Queue
-  cl_command_queue commandQueue = clCreateCommandQueue(context, devices[0], 0, &status);
-  if (status != CL_SUCCESS) {
-    std::cout << "clCreateCommandQueue failed." << std::endl;
+  engine->FreeFrame(outbuffer);
+  engine->FreeFrame(inbuffer);
+  return status == CL_SUCCESS ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+  std::string kernelPath;
+  std::string socketPath;
+  std::string deviceName;
+  bool daemonMode = false;
+  int width = WIDTH;
+  int height = HEIGHT;
+  float angle = ANGLE;
+  BatchOptions batchOptions;
+  std::string metricsPath;
+  int metricsPort = 0;
+  int metricsInterval = 10;
+  std::string traceFile;
+  std::string transferProfilePath;
+  std::string formatName;
+  bool useSvm = false;
+  FailoverOptions failoverOptions;
+  try {
+    TCLAP::CmdLine cmd("OpenCL image rotation", ' ', "0.1");
+    TCLAP::ValueArg<std::string> kernelArg(
+        "k", "kernel", "Path of rotate.cl", false,
+        OPENCL_EXAMPLE_KERNEL_DIR "/rotate.cl", "path", cmd);
+    TCLAP::ValueArg<std::string> deviceArg("d", "device",
+                                           "Device type: gpu, cpu or all",
+                                           false, "gpu", "string", cmd);
+    TCLAP::ValueArg<int> widthArg("W", "width", "Image width", false, WIDTH,
+                                  "int", cmd);
+    TCLAP::ValueArg<int> heightArg("H", "height", "Image height", false,
+                                   HEIGHT, "int", cmd);
+    TCLAP::ValueArg<float> angleArg("a", "angle", "Rotation angle in degrees",
+                                    false, ANGLE, "float", cmd);
+    TCLAP::ValueArg<std::string> formatArg(
+        "f", "format",
+        "Pixel format of the single-shot frame: int, i420, nv12 or nv21", false,
+        "int", "string", cmd);
+    TCLAP::SwitchArg daemonSwitch(
+        "D", "daemon", "Keep the engine warm and serve requests on a socket",
+        cmd, false);
+    TCLAP::ValueArg<std::string> socketArg("s", "socket",
+                                           "Unix socket path in daemon mode",
+                                           false, kDefaultSocketPath, "path",
+                                           cmd);
+    TCLAP::ValueArg<int> batchWindowArg(
+        "", "batch-window-us",
+        "Coalesce same-size requests arriving within this window into one "
+        "launch (daemon mode, 0 disables batching)",
+        false, 0, "int", cmd);
+    TCLAP::ValueArg<int> batchLatencyArg(
+        "", "batch-max-latency-us",
+        "Upper bound on the time a request waits for its batch", false,
+        batchOptions.maxLatencyMicros, "int", cmd);
+    TCLAP::ValueArg<int> batchMaxArg("", "batch-max",
+                                     "Maximum frames per batched launch",
+                                     false, batchOptions.maxBatch, "int", cmd);
+    TCLAP::ValueArg<int> queueArg(
+        "", "queue-capacity",
+        "Submission queue capacity; requests beyond it are answered busy",
+        false, batchOptions.queueCapacity, "int", cmd);
+    TCLAP::ValueArg<int> bulkChunkArg(
+        "", "bulk-chunk",
+        "Maximum frames per launch for bulk requests; interactive batches "
+        "are submitted alongside the chunk in flight",
+        false, batchOptions.bulkChunk, "int", cmd);
+    TCLAP::ValueArg<std::string> metricsFileArg(
+        "", "metrics-file", "Write OpenMetrics text to this file", false, "",
+        "path", cmd);
+    TCLAP::ValueArg<int> metricsIntervalArg(
+        "", "metrics-interval", "Seconds between metrics file updates",
+        false, metricsInterval, "int", cmd);
+    TCLAP::ValueArg<int> metricsPortArg(
+        "", "metrics-port",
+        "Serve OpenMetrics on http://127.0.0.1:<port>/metrics (daemon mode)",
+        false, 0, "int", cmd);
+    TCLAP::ValueArg<std::string> traceArg(
+        "", "trace-file",
+        "Chrome/Perfetto JSON trace written at exit (and on SIGUSR1 in daemon "
+        "mode); needs a build with OPENCL_EXAMPLE_ENABLE_TRACE=ON",
+        false, "/tmp/opencl_rotate_trace.json", "path", cmd);
+    TCLAP::SwitchArg svmSwitch(
+        "", "svm",
+        "Allocate the single-shot frame with clSVMAlloc and pass SVM pointers "
+        "to the kernel (falls back to buffers without SVM support)",
+        cmd, false);
+    TCLAP::ValueArg<std::string> transferProfileArg(
+        "", "transfer-profile",
+        "Transfer strategy per frame size, written by opencl_bandwidth", false,
+        "", "path", cmd);
+    TCLAP::ValueArg<int> cpuThreadsArg(
+        "", "cpu-threads",
+        "Threads for the CPU fallback of the int frame and the daemon (0 "
+        "uses every hardware thread)",
+        false, failoverOptions.cpuThreads, "int", cmd);
+    TCLAP::ValueArg<int> buildThreadsArg(
+        "", "build-threads",
+        "Compile the rotate.cl variants as separate programs on this many "
+        "threads; only the single-frame kernels are waited for at startup "
+        "(0 builds one program)",
+        false, failoverOptions.buildThreads, "int", cmd);
+    TCLAP::SwitchArg asyncBuildSwitch(
+        "", "async-build",
+        "Do not wait for clBuildProgram: rotate on the CPU until the kernel "
+        "is compiled (int frame and daemon; the daemon starts listening "
+        "right away)",
+        cmd, false);
+    cmd.parse(argc, argv);
+    kernelPath = kernelArg.getValue();
+    deviceName = deviceArg.getValue();
+    width = widthArg.getValue();
+    height = heightArg.getValue();
+    angle = angleArg.getValue();
+    daemonMode = daemonSwitch.getValue();
+    socketPath = socketArg.getValue();
+    batchOptions.windowMicros = batchWindowArg.getValue();
+    batchOptions.maxLatencyMicros = batchLatencyArg.getValue();
+    batchOptions.maxBatch = batchMaxArg.getValue();
+    batchOptions.queueCapacity = queueArg.getValue();
+    batchOptions.bulkChunk = bulkChunkArg.getValue();
+    metricsPath = metricsFileArg.getValue();
+    metricsInterval = metricsIntervalArg.getValue();
+    metricsPort = metricsPortArg.getValue();
+    traceFile = traceArg.getValue();
+    transferProfilePath = transferProfileArg.getValue();
+    formatName = formatArg.getValue();
+    useSvm = svmSwitch.getValue();
+    failoverOptions.cpuThreads = cpuThreadsArg.getValue();
+    failoverOptions.asyncBuild = asyncBuildSwitch.getValue();
+    failoverOptions.buildThreads = buildThreadsArg.getValue();
+  } catch (TCLAP::ArgException &e) {
+    std::cerr << "error: " << e.error() << " for arg " << e.argId()
+              << std::endl;
     return 1;
   }
-  // 4.7. 将要执行的kernel加入Command Queue
-  size_t globalThreads[2] = {WIDTH, HEIGHT};
-  size_t localThreads = {1};
-  /**
-   * @param command_queue 命令队列
-   * @param kernel 要执行的 kernel
-   * @param work_dim 工作维度（如 1、2、3）
-   * @param global_work_offset 全局偏移（通常为 NULL）
-   * @param global_work_size 全局工作项数量（每个维度的线程总数）
-   * @param local_work_size 局部工作项数量（每个工作组的线程数）
-   * @param num_events_in_wait_list 等待的事件数量
-   * @param event_wait_list 等待的事件列表
-   * @param event 返回的事件句柄
-   */
-  status = clEnqueueNDRangeKernel(commandQueue, kernel, 2, NULL,
-                                  globalThreads, &localThreads, 0, NULL, NULL);
-  if (status != CL_SUCCESS) {
-    std::cout << "clEnqueueNDRangeKernel failed." << std::endl;
-    return 1;
+
+  float sinTheta = 0.0f;
+  float cosTheta = 0.0f;
+  AngleToSinCos(angle, &sinTheta, &cosTheta);
+
+  // 单帧 int 旋转和 daemon 不强制要求设备：没有 OpenCL 设备、编译失败或运行出错时
+  // 在 CPU 上完成。SVM 和 YUV 路径仍然需要设备
+  if (!daemonMode && !useSvm && formatName == "int") {
+    if (width <= 0 || height <= 0) {
+      std::cout << "Invalid image size." << std::endl;
+      return 1;
+    }
+    return RotateIntFrame(kernelPath, ParseDeviceType(deviceName),
+                          transferProfilePath, failoverOptions, width, height,
+                          sinTheta, cosTheta, metricsPath, traceFile);
   }
-  // 4.7.1. 确认command queue中的命令已经执行完毕
-  status = clFinish(commandQueue);
+
+  if (daemonMode) {
+    MetricsFileWriter metricsWriter;
+    MetricsHttpServer metricsServer;
+    if (!metricsPath.empty()) {
+      metricsWriter.Start(metricsPath, metricsInterval);
+    }
+    if (metricsPort > 0 && !metricsServer.Start(metricsPort)) {
+      return 1;
+    }
+    ROTATE_TRACE_DUMP_ON_SIGNAL(traceFile);
+    // 与单帧 int 路径一样由 FailoverRotator 持有引擎：没有设备或设备出错时
+    // 请求在 CPU 上完成，设备恢复后切回，daemon 不会因此退出
+    FailoverRotator rotator(failoverOptions);
+    rotator.Init(kernelPath, ParseDeviceType(deviceName), transferProfilePath);
+    if (rotator.building()) {
+      std::cout << "Kernel build in progress, serving requests on the CPU "
+                   "until it completes."
+                << std::endl;
+    }
+    BatchScheduler batcher(&rotator, batchOptions);
+    bool batching = batchOptions.windowMicros > 0;
+    if (batching) {
+      std::cout << "Bulk requests: chunks of " << batchOptions.bulkChunk
+                << " frames on the bulk command queue" << std::endl;
+      batcher.Start();
+    }
+    RotateDaemon daemon(&rotator, batching ? &batcher : NULL);
+    g_daemon = &daemon;
+    signal(SIGINT, HandleStopSignal);
+    signal(SIGTERM, HandleStopSignal);
+    int ret = daemon.Run(socketPath);
+    g_daemon = NULL;
+    if (batching) {
+      batcher.Stop();
+      batcher.PrintStats(std::cout);
+    }
+    rotator.PrintStats(std::cout);
+    rotator.PrintBuildStats(std::cout);
+    ROTATE_TRACE_DUMP(traceFile);
+    return ret;
+  }
+
+  RotateEngine engine;
+  engine.SetBuildThreads(failoverOptions.buildThreads);
+  cl_int status = engine.Init(kernelPath, ParseDeviceType(deviceName));
   if (status != CL_SUCCESS) {
-    std::cout << "clFinish failed." << std::endl;
+    Metrics().errors.Add(status);
+    if (!metricsPath.empty()) {
+      WriteMetricsFile(metricsPath);
+    }
     return 1;
   }
-  // 4.8. 读取kernel执行结果，返回给host
-  status = clEnqueueReadBuffer(commandQueue, outputBuffer, CL_TRUE, 0,
-                               WIDTH * HEIGHT * sizeof(int), outbuffer, 0, NULL, NULL);
-  if (status != CL_SUCCESS) {
-    std::cout << "clEnqueueReadBuffer failed." << std::endl;
+  if (!transferProfilePath.empty()) {
+    engine.UseTransferProfile(transferProfilePath);
+  }
+
+  if (width <= 0 || height <= 0) {
+    std::cout << "Invalid image size." << std::endl;
     return 1;
   }
-  for(int i = 0; i < HEIGHT; i++) {
-    for(int j = 0; j < WIDTH; j++) {
-      std::cout << outbuffer[i * WIDTH + j] << " ";
+
+  YuvFormat yuvFormat = kYuvI420;
+  if (formatName != "int") {
+    if (!ParseYuvFormat(formatName, &yuvFormat)) {
+      std::cout << "Unknown format: " << formatName << std::endl;
+      return 1;
     }
-    std::cout << std::endl;
+    return RotateYuvFrame(&engine, width, height, yuvFormat, sinTheta,
+                          cosTheta, metricsPath, traceFile);
   }
-  // 4.9. Cleanup
-  clReleaseCommandQueue(commandQueue);
-  clReleaseMemObject(outputBuffer);
-  clReleaseKernel(kernel);
-  clReleaseProgram(program);
-  clReleaseContext(context);
-  free(devices);
-  delete outbuffer;
-  delete inbuffer;
 
-  return 0;
-}
\ No newline at end of file
+  return RotateSvmFrame(&engine, width, height, sinTheta, cosTheta,
+                        metricsPath, traceFile);
+}
+
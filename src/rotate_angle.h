@@ -0,0 +1,41 @@
+#ifndef OPENCL_EXAMPLE_ROTATE_ANGLE_H_
+#define OPENCL_EXAMPLE_ROTATE_ANGLE_H_
+
+#include <cmath>
+
+/**
+ * @brief 角度转换为 sin/cos，并把接近 0/±1 的值取整，
+ *        避免 90° 这类角度因为浮点误差导致取整后的坐标偏移一个像素
+ */
+inline void AngleToSinCos(float degrees, float *sinTheta, float *cosTheta) {
+  double rad = degrees * M_PI / 180.0;
+  double v[2] = {std::sin(rad), std::cos(rad)};
+  for (int i = 0; i < 2; i++) {
+    double r = std::round(v[i]);
+    if (std::fabs(v[i] - r) < 1e-6) {
+      v[i] = r;
+    }
+  }
+  *sinTheta = (float)v[0];
+  *cosTheta = (float)v[1];
+}
+
+/**
+ * @brief 正向映射是否写满 w*h 输出的每一个像素（没有空洞，也就不需要背景填充）
+ * @note 只有坐标轴对齐的角度才可能：0° 总是；180° 需要 w、h 都是奇数；
+ *       90°/270° 需要 w == h 且为奇数。其余角度旋转后总会留下空洞
+ */
+inline bool RotationCoversOutput(int w, int h, float sinTheta, float cosTheta) {
+  if (sinTheta == 0.0f && cosTheta == 1.0f) {
+    return true;
+  }
+  if (sinTheta == 0.0f && cosTheta == -1.0f) {
+    return w % 2 == 1 && h % 2 == 1;
+  }
+  if (cosTheta == 0.0f && (sinTheta == 1.0f || sinTheta == -1.0f)) {
+    return w == h && w % 2 == 1;
+  }
+  return false;
+}
+
+#endif  // OPENCL_EXAMPLE_ROTATE_ANGLE_H_
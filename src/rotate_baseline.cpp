@@ -0,0 +1,333 @@
+#include "rotate_baseline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+static std::string PlatformString(cl_platform_id platform,
+                                  cl_platform_info param) {
+  char buf[256] = {0};
+  if (platform == NULL ||
+      clGetPlatformInfo(platform, param, sizeof(buf) - 1, buf, NULL) !=
+          CL_SUCCESS) {
+    return "";
+  }
+  return buf;
+}
+
+static std::string DeviceString(cl_device_id device, cl_device_info param) {
+  char buf[256] = {0};
+  if (device == NULL ||
+      clGetDeviceInfo(device, param, sizeof(buf) - 1, buf, NULL) !=
+          CL_SUCCESS) {
+    return "";
+  }
+  return buf;
+}
+
+static std::string CpuModel() {
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line)) {
+    if (line.compare(0, 10, "model name") == 0) {
+      size_t colon = line.find(':');
+      if (colon != std::string::npos) {
+        size_t begin = line.find_first_not_of(" \t", colon + 1);
+        return begin == std::string::npos ? "" : line.substr(begin);
+      }
+    }
+  }
+  return "unknown";
+}
+
+static void AppendJsonString(std::ostream &os, const std::string &s) {
+  os << '"';
+  for (size_t i = 0; i < s.size(); i++) {
+    unsigned char c = (unsigned char)s[i];
+    if (c == '"' || c == '\\') {
+      os << '\\' << s[i];
+    } else if (c < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      os << buf;
+    } else {
+      os << s[i];
+    }
+  }
+  os << '"';
+}
+
+static double Median(std::vector<double> values) {
+  if (values.empty()) {
+    return 0.0;
+  }
+  std::sort(values.begin(), values.end());
+  size_t n = values.size();
+  return n % 2 == 1 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+std::string MachineFingerprint::Id() const {
+  // 只包含硬件：驱动升级后仍然找到同一个 baseline 文件
+  std::string all = cpuModel + '\n' + deviceName;
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < all.size(); i++) {
+    hash ^= (unsigned char)all[i];
+    hash *= 1099511628211ULL;
+  }
+  char buf[17];
+  snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)hash);
+  return buf;
+}
+
+MachineFingerprint QueryFingerprint(cl_platform_id platform,
+                                    cl_device_id device) {
+  MachineFingerprint fingerprint;
+  fingerprint.cpuModel = CpuModel();
+  fingerprint.platformName = PlatformString(platform, CL_PLATFORM_NAME);
+  fingerprint.platformVersion = PlatformString(platform, CL_PLATFORM_VERSION);
+  fingerprint.deviceName = DeviceString(device, CL_DEVICE_NAME);
+  fingerprint.driverVersion = DeviceString(device, CL_DRIVER_VERSION);
+  return fingerprint;
+}
+
+bool SaveBaseline(const std::string &path,
+                  const MachineFingerprint &fingerprint,
+                  const std::vector<BaselineSample> &samples) {
+  std::ofstream file(path.c_str(), std::ios::out | std::ios::trunc);
+  if (!file.is_open()) {
+    std::cout << "Failed to open baseline file: " << path << std::endl;
+    return false;
+  }
+  file << "{\n  \"fingerprint\": {\n    \"id\": ";
+  AppendJsonString(file, fingerprint.Id());
+  file << ",\n    \"cpu_model\": ";
+  AppendJsonString(file, fingerprint.cpuModel);
+  file << ",\n    \"platform_name\": ";
+  AppendJsonString(file, fingerprint.platformName);
+  file << ",\n    \"platform_version\": ";
+  AppendJsonString(file, fingerprint.platformVersion);
+  file << ",\n    \"device_name\": ";
+  AppendJsonString(file, fingerprint.deviceName);
+  file << ",\n    \"driver_version\": ";
+  AppendJsonString(file, fingerprint.driverVersion);
+  file << "\n  },\n  \"samples\": [";
+  file << std::setprecision(9);
+  for (size_t i = 0; i < samples.size(); i++) {
+    file << (i == 0 ? "\n" : ",\n") << "    {\"name\": ";
+    AppendJsonString(file, samples[i].name);
+    file << ", \"seconds\": [";
+    for (size_t j = 0; j < samples[i].seconds.size(); j++) {
+      file << (j == 0 ? "" : ", ") << samples[i].seconds[j];
+    }
+    file << "]}";
+  }
+  file << "\n  ]\n}\n";
+  return file.good();
+}
+
+/**
+ * @brief 读取 "key": "..." 形式的字符串值，只处理 \" 和 \\ 转义
+ * @return 值的结束位置（右引号之后），找不到时返回 npos
+ */
+static size_t ReadJsonString(const std::string &json, size_t pos,
+                             std::string *value) {
+  pos = json.find('"', json.find(':', pos) + 1);
+  if (pos == std::string::npos) {
+    return pos;
+  }
+  value->clear();
+  for (pos++; pos < json.size() && json[pos] != '"'; pos++) {
+    if (json[pos] == '\\' && pos + 1 < json.size()) {
+      pos++;
+    }
+    *value += json[pos];
+  }
+  return pos < json.size() ? pos + 1 : std::string::npos;
+}
+
+static void ReadFingerprintField(const std::string &json, const char *key,
+                                 std::string *value) {
+  size_t pos = json.find(key);
+  size_t end = json.find("\"samples\"");
+  if (pos != std::string::npos && pos < end) {
+    ReadJsonString(json, pos, value);
+  }
+}
+
+bool LoadBaseline(const std::string &path,
+                  std::vector<BaselineSample> *samples,
+                  MachineFingerprint *fingerprint) {
+  std::ifstream file(path.c_str(), std::ios::in);
+  if (!file.is_open()) {
+    std::cout << "Failed to open baseline file: " << path << std::endl;
+    return false;
+  }
+  std::stringstream ss;
+  ss << file.rdbuf();
+  std::string json = ss.str();
+
+  size_t pos = json.find("\"samples\"");
+  if (pos == std::string::npos) {
+    std::cout << "Malformed baseline file: " << path << std::endl;
+    return false;
+  }
+  if (fingerprint != NULL) {
+    *fingerprint = MachineFingerprint();
+    ReadFingerprintField(json, "\"cpu_model\"", &fingerprint->cpuModel);
+    ReadFingerprintField(json, "\"platform_name\"", &fingerprint->platformName);
+    ReadFingerprintField(json, "\"platform_version\"",
+                         &fingerprint->platformVersion);
+    ReadFingerprintField(json, "\"device_name\"", &fingerprint->deviceName);
+    ReadFingerprintField(json, "\"driver_version\"",
+                         &fingerprint->driverVersion);
+  }
+  samples->clear();
+  for (;;) {
+    // 1. "name": "..."（名字由我们自己生成，只处理 \" 和 \\ 转义）
+    pos = json.find("\"name\"", pos);
+    if (pos == std::string::npos) {
+      break;
+    }
+    BaselineSample sample;
+    pos = ReadJsonString(json, pos, &sample.name);
+    if (pos == std::string::npos) {
+      return false;
+    }
+    // 2. "seconds": [x, y, ...]
+    pos = json.find('[', json.find("\"seconds\"", pos));
+    if (pos == std::string::npos) {
+      return false;
+    }
+    pos++;
+    for (;;) {
+      const char *begin = json.c_str() + pos;
+      char *end = NULL;
+      double value = strtod(begin, &end);
+      if (end == begin) {
+        break;
+      }
+      sample.seconds.push_back(value);
+      pos += end - begin;
+      pos = json.find_first_not_of(" \n\t,", pos);
+      if (pos == std::string::npos || json[pos] == ']') {
+        break;
+      }
+    }
+    samples->push_back(sample);
+  }
+  return true;
+}
+
+static bool ReportChange(std::ostream &os, const char *what,
+                         const std::string &baseline,
+                         const std::string &current) {
+  if (baseline == current) {
+    return false;
+  }
+  os << what << " changed since the baseline: \"" << baseline << "\" -> \""
+     << current << "\"" << std::endl;
+  return true;
+}
+
+bool ReportFingerprintChanges(std::ostream &os,
+                              const MachineFingerprint &baseline,
+                              const MachineFingerprint &current) {
+  bool changed = ReportChange(os, "platform", baseline.platformName,
+                              current.platformName);
+  changed |= ReportChange(os, "platform version", baseline.platformVersion,
+                          current.platformVersion);
+  changed |= ReportChange(os, "driver version", baseline.driverVersion,
+                          current.driverVersion);
+  return changed;
+}
+
+double MannWhitneySlowerP(const std::vector<double> &current,
+                          const std::vector<double> &baseline) {
+  size_t n1 = current.size();
+  size_t n2 = baseline.size();
+  if (n1 == 0 || n2 == 0) {
+    return 1.0;
+  }
+  // 1. 合并后排序，并列值取平均秩
+  std::vector<std::pair<double, int> > all;
+  for (size_t i = 0; i < n1; i++) all.push_back(std::make_pair(current[i], 0));
+  for (size_t i = 0; i < n2; i++) all.push_back(std::make_pair(baseline[i], 1));
+  std::sort(all.begin(), all.end());
+  size_t n = all.size();
+  double rankSum = 0;
+  double tieTerm = 0;
+  for (size_t i = 0; i < n;) {
+    size_t j = i;
+    while (j < n && all[j].first == all[i].first) {
+      j++;
+    }
+    double rank = (i + 1 + j) / 2.0;
+    for (size_t k = i; k < j; k++) {
+      if (all[k].second == 0) {
+        rankSum += rank;
+      }
+    }
+    double t = (double)(j - i);
+    tieTerm += t * t * t - t;
+    i = j;
+  }
+
+  // 2. U 统计量的正态近似：耗时越长秩越大，U 偏大说明 current 更慢
+  double u = rankSum - n1 * (n1 + 1) / 2.0;
+  double mean = n1 * n2 / 2.0;
+  double variance =
+      n1 * n2 / 12.0 * ((n + 1) - tieTerm / ((double)n * (n - 1)));
+  if (variance <= 0) {
+    return 1.0;
+  }
+  double z = (u - mean - 0.5) / std::sqrt(variance);
+  return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+bool CompareWithBaseline(std::ostream &os,
+                         const std::vector<BaselineSample> &baseline,
+                         const std::vector<BaselineSample> &current,
+                         double threshold, double alpha) {
+  bool regressed = false;
+  std::ios::fmtflags flags = os.flags();
+  os << std::fixed;
+  os << std::left << std::setw(10) << "backend" << std::right << std::setw(14)
+     << "baseline ms" << std::setw(12) << "current ms" << std::setw(10)
+     << "change" << std::setw(12) << "p-value" << "  verdict" << std::endl;
+  for (size_t i = 0; i < current.size(); i++) {
+    const BaselineSample *base = NULL;
+    for (size_t j = 0; j < baseline.size(); j++) {
+      if (baseline[j].name == current[i].name) {
+        base = &baseline[j];
+      }
+    }
+    os << std::left << std::setw(10) << current[i].name << std::right;
+    if (base == NULL || base->seconds.empty()) {
+      os << "  (no baseline)" << std::endl;
+      continue;
+    }
+    double baseMedian = Median(base->seconds);
+    double currentMedian = Median(current[i].seconds);
+    double change = baseMedian > 0 ? currentMedian / baseMedian - 1.0 : 0.0;
+    double p = MannWhitneySlowerP(current[i].seconds, base->seconds);
+    const char *verdict = "ok";
+    if (p < alpha && change > threshold) {
+      verdict = "REGRESSION";
+      regressed = true;
+    } else if (p < alpha && change > 0) {
+      verdict = "slower (below threshold)";
+    }
+    os << std::setprecision(3) << std::setw(14) << baseMedian * 1e3
+       << std::setw(12) << currentMedian * 1e3 << std::setprecision(1)
+       << std::setw(9) << change * 100 << "%" << std::setprecision(4)
+       << std::setw(12) << p << "  " << verdict << std::endl;
+  }
+  os.flags(flags);
+  return regressed;
+}
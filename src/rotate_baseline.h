@@ -0,0 +1,89 @@
+#ifndef OPENCL_EXAMPLE_ROTATE_BASELINE_H_
+#define OPENCL_EXAMPLE_ROTATE_BASELINE_H_
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <CL/cl.h>
+
+/**
+ * ========== 性能回归门禁 ==========
+ * 驱动或编译器升级后吞吐悄悄减半，单看一次运行的耗时很难发现。
+ * benchmark 把每个后端重复运行得到的耗时样本按机器指纹保存成 baseline JSON，
+ * 之后的运行与 baseline 做 Mann-Whitney U 检验（单侧：当前是否更慢），
+ * 只有统计上显著、并且中位数变慢超过阈值时才判定为回归。
+ */
+
+/**
+ * @brief 机器指纹：CPU 型号 + OpenCL platform/device/驱动版本
+ * @note 查询方式与 platform.cpp 一致。baseline 文件只按硬件（CPU 型号、设备名）区分，
+ *       platform/驱动版本保存在文件中：升级驱动后仍然与升级前的 baseline 比较，
+ *       这正是门禁要抓的回归
+ */
+struct MachineFingerprint {
+  std::string cpuModel;
+  std::string platformName;
+  std::string platformVersion;
+  std::string deviceName;
+  std::string driverVersion;
+
+  /**
+   * @brief CPU 型号 + 设备名的短哈希（FNV-1a，16 位十六进制），用于 baseline 文件名
+   */
+  std::string Id() const;
+};
+
+/**
+ * @brief 查询本机指纹，platform/device 为 NULL 时只填 CPU 型号
+ */
+MachineFingerprint QueryFingerprint(cl_platform_id platform,
+                                    cl_device_id device);
+
+/**
+ * @brief 一个后端的耗时样本（秒）
+ */
+struct BaselineSample {
+  std::string name;
+  std::vector<double> seconds;
+};
+
+bool SaveBaseline(const std::string &path,
+                  const MachineFingerprint &fingerprint,
+                  const std::vector<BaselineSample> &samples);
+
+/**
+ * @brief 读取 SaveBaseline 写出的文件（只解析本模块自己的格式）
+ * @param fingerprint 不为 NULL 时写入文件中保存的指纹
+ */
+bool LoadBaseline(const std::string &path,
+                  std::vector<BaselineSample> *samples,
+                  MachineFingerprint *fingerprint = NULL);
+
+/**
+ * @brief 打印 baseline 与当前运行之间 platform/驱动版本的变化
+ * @return 是否有变化
+ */
+bool ReportFingerprintChanges(std::ostream &os,
+                              const MachineFingerprint &baseline,
+                              const MachineFingerprint &current);
+
+/**
+ * @brief Mann-Whitney U 检验（正态近似，带并列秩和连续性修正）
+ * @return 单侧 p 值：原假设“current 不比 baseline 慢”成立的概率，越小越说明变慢
+ */
+double MannWhitneySlowerP(const std::vector<double> &current,
+                          const std::vector<double> &baseline);
+
+/**
+ * @brief 逐个后端与 baseline 比较并打印结果
+ * @param threshold 中位数变慢超过这个比例（例如 0.05）才算回归
+ * @param alpha 显著性水平
+ * @return 是否存在回归
+ */
+bool CompareWithBaseline(std::ostream &os,
+                         const std::vector<BaselineSample> &baseline,
+                         const std::vector<BaselineSample> &current,
+                         double threshold, double alpha);
+
+#endif  // OPENCL_EXAMPLE_ROTATE_BASELINE_H_
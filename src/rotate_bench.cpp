@@ -0,0 +1,701 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include <CL/cl.h>
+
+#include "tclap/CmdLine.h"
+
+#include "perf_counters.h"
+#include "rotate_angle.h"
+#include "rotate_baseline.h"
+#include "rotate_cpu.h"
+#include "rotate_deadline.h"
+#include "rotate_engine.h"
+#include "rotate_image.h"
+#include "rotate_pipeline.h"
+#include "rotate_resample.h"
+#include "rotate_roofline.h"
+
+/**
+ * ========== 旋转 benchmark ==========
+ * 对每个后端先预热 warmup 次，再计时 runs 次，输出中位数耗时和吞吐（Mpix/s）。
+ * 打开 --perf 后，计时的每一次运行都同时读取硬件计数器，并按像素折算：
+ *   cycles/px、instructions/px、IPC、LLC-misses/px、dTLB-misses/px、branch-misses/px
+ * 计数器只统计调用线程：CPU 后端就是旋转本身，OpenCL 后端是 host 侧的驱动开销。
+ *
+ * --roofline 在 OpenCL 设备上先用 roofline.cl 测峰值带宽和算力，再用 profiling
+ * event 的 kernel 时间给 image_rotate、image_rotate_batch 定位，判断各自受什么限制。
+ * 每种设备（包括 CPU ICD）用 --device 分别跑一次，--roofline-csv 追加到同一个文件即可画图。
+ *
+ * --save-baseline / --check-baseline 按机器指纹保存或比较耗时样本（见 rotate_baseline.h），
+ * 检测到显著回归时进程以 2 退出，可以直接接到发布验证流程里。
+ *
+ * --tile N 额外测 tile 排列的源图（见 rotate_image.h）：cpu-tiled 按块遍历，
+ * opencl-tiled 的源图只上传一次，适合对比大图、大角度下同一源图反复旋转的收益。
+ * --cpu-mode 选择 CPU 循环的访存方式（预取下一行、非临时存储），all 时逐个对比。
+ * --svm 额外测 SVM 路径：帧由 clSVMAlloc 分配，与拷贝路径对比暂存拷贝的开销。
+ * --bands N 额外测条带分解：一帧切成 N 个 sub-buffer 条带，相邻条带交替在两个 queue 上执行、读回。
+ * --pipeline 额外测录制的流水线（见 rotate_pipeline.h），并打印每帧的提交开销。
+ * --packed-args 额外测 opencl-packed：标量参数打包成一个结构体参数（见 rotate_kernel_args.h）。
+ * --deadline-ms D 额外测 opencl-deadline：每帧的截止时间为开始后 D 毫秒，来不及的帧降级或丢弃
+ * （见 rotate_deadline.h），结束后打印各结果的帧数。
+ * --sampling M 额外测反向映射的重采样旋转 opencl-<M>（见 rotate_resample.h），
+ * all 时 bilinear、lanczos3、area 逐个测，用来对比高质量滤波相对双线性的吞吐。
+ */
+
+#ifndef OPENCL_EXAMPLE_KERNEL_DIR
+#define OPENCL_EXAMPLE_KERNEL_DIR "/mnt/workspace/cgz_workspace/Exercise/opencl_example/src"
+#endif
+
+struct BenchCase {
+  std::string name;
+  std::function<cl_int()> run;  // 旋转一帧
+};
+
+struct BenchResult {
+  std::string name;
+  std::vector<double> seconds;
+  PerfSample perf;
+};
+
+static cl_device_type ParseDeviceType(const std::string &name) {
+  if (name == "cpu") return CL_DEVICE_TYPE_CPU;
+  if (name == "all") return CL_DEVICE_TYPE_ALL;
+  return CL_DEVICE_TYPE_GPU;
+}
+
+static double Median(std::vector<double> values) {
+  if (values.empty()) {
+    return 0.0;
+  }
+  std::sort(values.begin(), values.end());
+  size_t n = values.size();
+  return n % 2 == 1 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+static cl_int RunCase(const BenchCase &bench, int warmup, int runs,
+                      PerfCounters *perf, BenchResult *result) {
+  result->name = bench.name;
+  for (int i = 0; i < warmup; i++) {
+    cl_int status = bench.run();
+    if (status != CL_SUCCESS) {
+      return status;
+    }
+  }
+  for (int i = 0; i < runs; i++) {
+    if (perf != NULL) {
+      perf->Start();
+    }
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    cl_int status = bench.run();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (perf != NULL) {
+      result->perf += perf->Stop();
+    }
+    if (status != CL_SUCCESS) {
+      return status;
+    }
+    result->seconds.push_back(elapsed.count());
+  }
+  return CL_SUCCESS;
+}
+
+static void PrintPerPixel(const PerfSample &perf, int event, double pixels) {
+  std::cout << std::setw(14);
+  if (perf.valid[event]) {
+    std::cout << perf.value[event] / pixels;
+  } else {
+    std::cout << "n/a";
+  }
+}
+
+static void PrintResults(const std::vector<BenchResult> &results, int w, int h,
+                         bool showPerf) {
+  std::cout << std::left << std::setw(10) << "backend" << std::right
+            << std::setw(12) << "median ms" << std::setw(12) << "Mpix/s";
+  if (showPerf) {
+    for (int e = 0; e < kPerfEventCount; e++) {
+      std::cout << std::setw(14) << (std::string(PerfCounters::Name(e)) + "/px");
+    }
+    std::cout << std::setw(8) << "IPC";
+  }
+  std::cout << std::endl;
+
+  std::cout << std::fixed;
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchResult &r = results[i];
+    double median = Median(r.seconds);
+    double pixels = (double)w * h;
+    std::cout << std::left << std::setw(10) << r.name << std::right
+              << std::setprecision(3) << std::setw(12) << median * 1e3
+              << std::setw(12) << (median > 0 ? pixels / median / 1e6 : 0.0);
+    if (showPerf) {
+      double total = pixels * r.seconds.size();
+      std::cout << std::setprecision(4);
+      for (int e = 0; e < kPerfEventCount; e++) {
+        PrintPerPixel(r.perf, e, total);
+      }
+      std::cout << std::setw(8) << std::setprecision(2);
+      if (r.perf.valid[kPerfCycles] && r.perf.valid[kPerfInstructions] &&
+          r.perf.value[kPerfCycles] > 0) {
+        std::cout << (double)r.perf.value[kPerfInstructions] /
+                         r.perf.value[kPerfCycles];
+      } else {
+        std::cout << "n/a";
+      }
+    }
+    std::cout << std::endl;
+  }
+}
+
+/**
+ * @brief 重复执行 run，取 engine 记录的 kernel 时间的中位数
+ */
+static cl_int MedianKernelSeconds(RotateEngine *engine,
+                                  const std::function<cl_int()> &run, int runs,
+                                  double *seconds) {
+  std::vector<double> samples;
+  for (int i = 0; i < runs; i++) {
+    cl_int status = run();
+    if (status != CL_SUCCESS) {
+      return status;
+    }
+    if (engine->lastKernelNanos() > 0) {
+      samples.push_back(engine->lastKernelNanos() * 1e-9);
+    }
+  }
+  if (samples.empty()) {
+    std::cout << "No kernel profiling data." << std::endl;
+    return CL_PROFILING_INFO_NOT_AVAILABLE;
+  }
+  *seconds = Median(samples);
+  return CL_SUCCESS;
+}
+
+static cl_int RunRoofline(RotateEngine *engine, const std::string &kernelPath,
+                          const std::string &csvPath, int w, int h, int frames,
+                          float sinTheta, float cosTheta, int runs) {
+  char deviceName[256] = {0};
+  clGetDeviceInfo(engine->device(), CL_DEVICE_NAME, sizeof(deviceName) - 1,
+                  deviceName, NULL);
+  DevicePeaks peaks;
+  cl_int status = MeasureDevicePeaks(engine->context(), engine->device(),
+                                     engine->queue(), kernelPath, &peaks);
+  if (status != CL_SUCCESS) {
+    return status;
+  }
+
+  const size_t imageSize = (size_t)w * h;
+  std::vector<int> in(imageSize * frames);
+  std::vector<int> out(imageSize * frames, 0);
+  for (size_t i = 0; i < in.size(); i++) {
+    in[i] = (int)i;
+  }
+  std::vector<RotateJob> jobs(frames);
+  for (int i = 0; i < frames; i++) {
+    jobs[i].in = in.data() + i * imageSize;
+    jobs[i].out = out.data() + i * imageSize;
+    jobs[i].sinTheta = sinTheta;
+    jobs[i].cosTheta = cosTheta;
+  }
+
+  KernelTraffic traffic = RotateKernelTraffic(w, h, sinTheta, cosTheta);
+  std::vector<RooflinePoint> points(2);
+  points[0].name = "image_rotate";
+  points[0].traffic = traffic;
+  points[0].pixels = (double)imageSize;
+  status = MedianKernelSeconds(
+      engine,
+      [&]() {
+        return engine->Rotate(in.data(), out.data(), w, h, sinTheta, cosTheta);
+      },
+      runs, &points[0].seconds);
+  if (status != CL_SUCCESS) {
+    return status;
+  }
+  // 批量版本每帧还要读一次 8B 的 sin/cos，摊到每个像素上可以忽略
+  points[1].name = "image_rotate_batch";
+  points[1].traffic = traffic;
+  points[1].pixels = (double)imageSize * frames;
+  status = MedianKernelSeconds(
+      engine, [&]() { return engine->RotateBatch(jobs.data(), frames, w, h); },
+      runs, &points[1].seconds);
+  if (status != CL_SUCCESS) {
+    return status;
+  }
+
+  PrintRoofline(std::cout, deviceName, peaks, points);
+  if (!csvPath.empty() &&
+      !AppendRooflineCsv(csvPath, deviceName, peaks, points)) {
+    return CL_INVALID_VALUE;
+  }
+  return CL_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+  std::string kernelPath;
+  std::string deviceName;
+  std::string backend;
+  int width = 1920;
+  int height = 1080;
+  float angle = 30.0f;
+  int warmup = 3;
+  int runs = 20;
+  bool usePerf = false;
+  bool roofline = false;
+  std::string rooflineKernelPath;
+  std::string rooflineCsv;
+  int batchFrames = 8;
+  std::string baselineDir;
+  bool saveBaseline = false;
+  bool checkBaseline = false;
+  double threshold = 0.05;
+  double alpha = 0.01;
+  std::string transferProfilePath;
+  int tile = 0;
+  std::string cpuMode = "plain";
+  bool useSvm = false;
+  int bands = 0;
+  bool usePipeline = false;
+  bool usePackedArgs = false;
+  double deadlineMs = 0;
+  int buildThreads = 0;
+  std::string sampling;
+  try {
+    TCLAP::CmdLine cmd("Rotation benchmark", ' ', "0.1");
+    TCLAP::ValueArg<std::string> kernelArg(
+        "k", "kernel", "Path of rotate.cl", false,
+        OPENCL_EXAMPLE_KERNEL_DIR "/rotate.cl", "path", cmd);
+    TCLAP::ValueArg<std::string> deviceArg("d", "device",
+                                           "Device type: gpu, cpu or all",
+                                           false, "gpu", "string", cmd);
+    TCLAP::ValueArg<std::string> backendArg(
+        "b", "backend", "Backends to run: cpu, opencl or all", false, "all",
+        "string", cmd);
+    TCLAP::ValueArg<int> widthArg("W", "width", "Image width", false, width,
+                                  "int", cmd);
+    TCLAP::ValueArg<int> heightArg("H", "height", "Image height", false,
+                                   height, "int", cmd);
+    TCLAP::ValueArg<float> angleArg("a", "angle", "Rotation angle in degrees",
+                                    false, angle, "float", cmd);
+    TCLAP::ValueArg<int> warmupArg("", "warmup", "Untimed runs per backend",
+                                   false, warmup, "int", cmd);
+    TCLAP::ValueArg<int> runsArg("r", "runs", "Timed runs per backend", false,
+                                 runs, "int", cmd);
+    TCLAP::SwitchArg perfSwitch(
+        "", "perf",
+        "Read perf_event hardware counters (cycles, instructions, LLC, dTLB "
+        "and branch misses) for every timed run",
+        cmd, false);
+    TCLAP::SwitchArg rooflineSwitch(
+        "", "roofline",
+        "Measure device peaks and place the OpenCL kernels on a roofline",
+        cmd, false);
+    TCLAP::ValueArg<std::string> rooflineKernelArg(
+        "", "roofline-kernel", "Path of roofline.cl", false,
+        OPENCL_EXAMPLE_KERNEL_DIR "/roofline.cl", "path", cmd);
+    TCLAP::ValueArg<std::string> rooflineCsvArg(
+        "", "roofline-csv", "Append roofline plot data to this CSV file",
+        false, "", "path", cmd);
+    TCLAP::ValueArg<int> batchArg("", "batch",
+                                  "Frames per launch for image_rotate_batch",
+                                  false, batchFrames, "int", cmd);
+    TCLAP::ValueArg<std::string> baselineDirArg(
+        "", "baseline-dir", "Directory holding per-machine baseline JSON files",
+        false, "rotate_baselines", "path", cmd);
+    TCLAP::SwitchArg saveBaselineSwitch(
+        "", "save-baseline", "Save this run as the baseline for this machine",
+        cmd, false);
+    TCLAP::SwitchArg checkBaselineSwitch(
+        "", "check-baseline",
+        "Compare with the saved baseline and exit 2 on a significant slowdown",
+        cmd, false);
+    TCLAP::ValueArg<double> thresholdArg(
+        "", "threshold",
+        "Median slowdown (fraction) that counts as a regression", false,
+        threshold, "double", cmd);
+    TCLAP::ValueArg<double> alphaArg(
+        "", "alpha", "Significance level of the Mann-Whitney U test", false,
+        alpha, "double", cmd);
+    TCLAP::ValueArg<std::string> transferProfileArg(
+        "", "transfer-profile",
+        "Transfer strategy per frame size, written by opencl_bandwidth", false,
+        "", "path", cmd);
+    TCLAP::ValueArg<int> tileArg(
+        "", "tile",
+        "Also run cpu-tiled/opencl-tiled with the source re-laid into "
+        "tile x tile blocks once up front (8 or 16; 0 disables)",
+        false, tile, "int", cmd);
+    TCLAP::ValueArg<std::string> cpuModeArg(
+        "", "cpu-mode",
+        "CPU loop variant: plain, prefetch (next source row), stream "
+        "(prefetch + non-temporal stores) or all to compare them",
+        false, cpuMode, "string", cmd);
+    TCLAP::SwitchArg svmSwitch(
+        "", "svm",
+        "Also run opencl-svm: frames from clSVMAlloc passed straight to the "
+        "kernel (buffers when the device has no SVM)",
+        cmd, false);
+    TCLAP::ValueArg<int> bandsArg(
+        "", "bands",
+        "Also run opencl-bands: the frame split into this many sub-buffer "
+        "bands (0 disables)",
+        false, bands, "int", cmd);
+    TCLAP::SwitchArg pipelineSwitch(
+        "", "pipeline",
+        "Also run opencl-pipeline: fill + kernel recorded once "
+        "(cl_khr_command_buffer when available) and replayed per frame",
+        cmd, false);
+    TCLAP::ValueArg<double> deadlineArg(
+        "", "deadline-ms",
+        "Also run opencl-deadline: frames due this many ms after they start "
+        "are degraded or dropped when predicted late (0 disables)",
+        false, deadlineMs, "double", cmd);
+    TCLAP::SwitchArg packedArgsSwitch(
+        "", "packed-args",
+        "Also run opencl-packed: the scalar kernel arguments packed into one "
+        "by-value struct",
+        cmd, false);
+    TCLAP::ValueArg<int> buildThreadsArg(
+        "", "build-threads",
+        "Compile the rotate.cl variants as separate programs on this many "
+        "threads and report per-variant compile times (0 builds one program)",
+        false, buildThreads, "int", cmd);
+    TCLAP::ValueArg<std::string> samplingArg(
+        "", "sampling",
+        "Also run opencl-<mode>: gather rotation filtered with bilinear, "
+        "lanczos3 or area, or all of them",
+        false, sampling, "mode", cmd);
+    cmd.parse(argc, argv);
+    kernelPath = kernelArg.getValue();
+    deviceName = deviceArg.getValue();
+    backend = backendArg.getValue();
+    width = widthArg.getValue();
+    height = heightArg.getValue();
+    angle = angleArg.getValue();
+    warmup = warmupArg.getValue();
+    runs = runsArg.getValue();
+    usePerf = perfSwitch.getValue();
+    roofline = rooflineSwitch.getValue();
+    rooflineKernelPath = rooflineKernelArg.getValue();
+    rooflineCsv = rooflineCsvArg.getValue();
+    batchFrames = batchArg.getValue();
+    baselineDir = baselineDirArg.getValue();
+    saveBaseline = saveBaselineSwitch.getValue();
+    checkBaseline = checkBaselineSwitch.getValue();
+    threshold = thresholdArg.getValue();
+    alpha = alphaArg.getValue();
+    transferProfilePath = transferProfileArg.getValue();
+    tile = tileArg.getValue();
+    cpuMode = cpuModeArg.getValue();
+    useSvm = svmSwitch.getValue();
+    bands = bandsArg.getValue();
+    usePipeline = pipelineSwitch.getValue();
+    usePackedArgs = packedArgsSwitch.getValue();
+    deadlineMs = deadlineArg.getValue();
+    buildThreads = buildThreadsArg.getValue();
+    sampling = samplingArg.getValue();
+  } catch (TCLAP::ArgException &e) {
+    std::cerr << "error: " << e.error() << " for arg " << e.argId()
+              << std::endl;
+    return 1;
+  }
+  if (width <= 0 || height <= 0 || runs <= 0 || batchFrames <= 0) {
+    std::cout << "Invalid image size or run count." << std::endl;
+    return 1;
+  }
+  std::vector<CpuRotateMode> cpuModes;
+  if (cpuMode == "all") {
+    for (int i = 0; i < kCpuRotateModeCount; i++) {
+      cpuModes.push_back((CpuRotateMode)i);
+    }
+  } else {
+    CpuRotateMode mode = kCpuPlain;
+    if (!ParseCpuRotateMode(cpuMode, &mode)) {
+      std::cout << "Unknown CPU mode: " << cpuMode << std::endl;
+      return 1;
+    }
+    cpuModes.push_back(mode);
+  }
+  std::vector<RotateSampling> samplings;
+  if (sampling == "all") {
+    for (int i = 0; i < kRotateSamplingCount; i++) {
+      samplings.push_back((RotateSampling)i);
+    }
+  } else if (!sampling.empty()) {
+    RotateSampling mode = kSampleBilinear;
+    if (!ParseRotateSampling(sampling, &mode)) {
+      std::cout << "Unknown sampling mode: " << sampling << std::endl;
+      return 1;
+    }
+    samplings.push_back(mode);
+  }
+  if (tile != 0 && !IsValidTile(tile)) {
+    std::cout << "Tile size must be a power of two between 2 and 32."
+              << std::endl;
+    return 1;
+  }
+
+  float sinTheta = 0.0f;
+  float cosTheta = 0.0f;
+  AngleToSinCos(angle, &sinTheta, &cosTheta);
+  const size_t imageSize = (size_t)width * height;
+  std::vector<int> inbuffer(imageSize);
+  std::vector<int> outbuffer(imageSize, 0);
+  for (size_t i = 0; i < imageSize; i++) {
+    inbuffer[i] = (int)i;
+  }
+
+  if (roofline) {
+    RotateEngine engine;
+    if (engine.Init(kernelPath, ParseDeviceType(deviceName)) != CL_SUCCESS) {
+      return 1;
+    }
+    return RunRoofline(&engine, rooflineKernelPath, rooflineCsv, width, height,
+                       batchFrames, sinTheta, cosTheta, runs) == CL_SUCCESS
+               ? 0
+               : 1;
+  }
+
+  std::vector<BenchCase> cases;
+  for (size_t i = 0;
+       i < cpuModes.size() && (backend == "cpu" || backend == "all"); i++) {
+    // plain 沿用原来的名字 "cpu"，已保存的 baseline 不受影响
+    CpuRotateMode mode = cpuModes[i];
+    BenchCase bench;
+    bench.name = mode == kCpuPlain
+                     ? std::string("cpu")
+                     : std::string("cpu-") + CpuRotateModeName(mode);
+    bench.run = [&, mode]() {
+      RotateCpuInt(inbuffer.data(), width, outbuffer.data(), width, width,
+                   height, sinTheta, cosTheta, mode);
+      return (cl_int)CL_SUCCESS;
+    };
+    cases.push_back(bench);
+  }
+  // tile 排列只在开始时重排一次，计时的是同一源图反复旋转的开销
+  std::vector<int> tiledbuffer;
+  if (tile != 0 && (backend == "cpu" || backend == "all")) {
+    tiledbuffer.resize(TiledElements(width, height, tile));
+    TileImage<int>(inbuffer.data(), width, width, height, tile,
+                   tiledbuffer.data());
+    BenchCase bench;
+    bench.name = "cpu-tiled";
+    bench.run = [&]() {
+      RotateCpuTiled<int>(tiledbuffer.data(), tile, outbuffer.data(), width,
+                          width, height, sinTheta, cosTheta);
+      return (cl_int)CL_SUCCESS;
+    };
+    cases.push_back(bench);
+  }
+  RotateEngine engine;
+  TiledImage tiledImage;
+  int *svmIn = NULL;
+  int *svmOut = NULL;
+  RotatePipeline pipeline(&engine);
+  DeadlineScheduler deadline(&engine, DeadlineOptions());
+  if (backend == "opencl" || backend == "all") {
+    engine.SetBuildThreads(buildThreads);
+    auto initStart = std::chrono::steady_clock::now();
+    cl_int initStatus = engine.Init(kernelPath, ParseDeviceType(deviceName));
+    // 拆分编译时 Init 只等 core 变体，这就是第一帧之前的启动时间
+    std::cout << "opencl init: "
+              << std::chrono::duration<double, std::milli>(
+                     std::chrono::steady_clock::now() - initStart)
+                     .count()
+              << " ms" << std::endl;
+    if (initStatus == CL_SUCCESS) {
+      if (!transferProfilePath.empty()) {
+        engine.UseTransferProfile(transferProfilePath);
+      }
+      BenchCase bench;
+      bench.name = "opencl";
+      bench.run = [&]() {
+        return engine.Rotate(inbuffer.data(), outbuffer.data(), width, height,
+                             sinTheta, cosTheta);
+      };
+      cases.push_back(bench);
+      if (tile != 0) {
+        if (engine.UploadTiled(inbuffer.data(), width, width, height, tile,
+                               &tiledImage) != CL_SUCCESS) {
+          return 1;
+        }
+        bench.name = "opencl-tiled";
+        bench.run = [&]() {
+          return engine.RotateTiled(tiledImage, outbuffer.data(), width,
+                                    sinTheta, cosTheta);
+        };
+        cases.push_back(bench);
+      }
+      if (bands > 0) {
+        bench.name = "opencl-bands";
+        bench.run = [&]() {
+          return engine.RotateBanded(inbuffer.data(), width, outbuffer.data(),
+                                     width, width, height, sinTheta, cosTheta,
+                                     bands);
+        };
+        cases.push_back(bench);
+      }
+      if (usePackedArgs) {
+        bench.name = "opencl-packed";
+        bench.run = [&]() {
+          engine.SetPackedArgs(true);
+          cl_int status = engine.Rotate(inbuffer.data(), outbuffer.data(),
+                                        width, height, sinTheta, cosTheta);
+          engine.SetPackedArgs(false);
+          return status;
+        };
+        cases.push_back(bench);
+      }
+      for (size_t i = 0; i < samplings.size(); i++) {
+        RotateSampling mode = samplings[i];
+        bench.name = std::string("opencl-") + RotateSamplingName(mode);
+        bench.run = [&, mode]() {
+          return engine.RotateResampled(inbuffer.data(), width,
+                                        outbuffer.data(), width, width, height,
+                                        sinTheta, cosTheta, mode);
+        };
+        cases.push_back(bench);
+      }
+      if (deadlineMs > 0) {
+        bench.name = "opencl-deadline";
+        bench.run = [&]() {
+          DeadlineScheduler::Clock::time_point due =
+              DeadlineScheduler::Clock::now() +
+              std::chrono::microseconds((int64_t)(deadlineMs * 1000));
+          return deadline.Process(inbuffer.data(), width, outbuffer.data(),
+                                  width, width, height, sinTheta, cosTheta,
+                                  due, NULL);
+        };
+        cases.push_back(bench);
+      }
+      if (usePipeline) {
+        if (pipeline.Record(width, height, sinTheta, cosTheta, true) !=
+            CL_SUCCESS) {
+          return 1;
+        }
+        bench.name = "opencl-pipeline";
+        bench.run = [&]() {
+          return pipeline.Run(inbuffer.data(), outbuffer.data());
+        };
+        cases.push_back(bench);
+      }
+      if (useSvm) {
+        std::cout << "SVM: "
+                  << (engine.svmSupported()
+                          ? (engine.svmFineGrained() ? "fine-grained"
+                                                     : "coarse-grained")
+                          : "not supported, opencl-svm uses buffers")
+                  << std::endl;
+        svmIn = (int *)engine.AllocFrame(imageSize * sizeof(int));
+        svmOut = (int *)engine.AllocFrame(imageSize * sizeof(int));
+        if (svmIn == NULL || svmOut == NULL) {
+          return 1;
+        }
+        std::copy(inbuffer.begin(), inbuffer.end(), svmIn);
+        bench.name = "opencl-svm";
+        bench.run = [&]() {
+          return engine.RotateSvm(svmIn, width, svmOut, width, width, height,
+                                  sinTheta, cosTheta);
+        };
+        cases.push_back(bench);
+      }
+    } else if (backend == "opencl") {
+      return 1;
+    } else {
+      std::cout << "Skipping the OpenCL backend." << std::endl;
+    }
+  }
+  if (cases.empty()) {
+    std::cout << "Unknown backend: " << backend << std::endl;
+    return 1;
+  }
+
+  PerfCounters perf;
+  if (usePerf && !perf.Open()) {
+    std::cout << "No perf_event counters available, reporting time only."
+              << std::endl;
+    usePerf = false;
+  }
+
+  std::cout << width << "x" << height << ", angle " << angle << ", " << runs
+            << " runs" << std::endl;
+  std::vector<BenchResult> results;
+  for (size_t i = 0; i < cases.size(); i++) {
+    BenchResult result;
+    cl_int status =
+        RunCase(cases[i], warmup, runs, usePerf ? &perf : NULL, &result);
+    if (status != CL_SUCCESS) {
+      std::cout << cases[i].name << " failed: " << status << std::endl;
+      return 1;
+    }
+    results.push_back(result);
+  }
+  if (deadlineMs > 0) {
+    deadline.PrintStats(std::cout);
+  }
+  if (pipeline.recorded()) {
+    pipeline.PrintStats(std::cout);
+    pipeline.Release();
+  }
+  engine.PrintBuildStats(std::cout);
+  engine.ReleaseTiled(&tiledImage);
+  engine.FreeFrame(svmOut);
+  engine.FreeFrame(svmIn);
+  PrintResults(results, width, height, usePerf);
+  if (!saveBaseline && !checkBaseline) {
+    return 0;
+  }
+
+  // 文件名只包含硬件：只跑 CPU 后端时设备名为空，不会与带设备的 baseline 混用；
+  // 驱动升级后仍与原来的 baseline 比较，版本变化在比较前打印出来
+  MachineFingerprint fingerprint =
+      QueryFingerprint(engine.platform(), engine.device());
+  std::ostringstream name;
+  name << baselineDir << "/rotate-" << fingerprint.Id() << "-" << width << "x"
+       << height << "-a" << angle << ".json";
+  std::string baselinePath = name.str();
+  std::vector<BaselineSample> current(results.size());
+  for (size_t i = 0; i < results.size(); i++) {
+    current[i].name = results[i].name;
+    current[i].seconds = results[i].seconds;
+  }
+  std::cout << "machine: " << fingerprint.cpuModel;
+  if (!fingerprint.deviceName.empty()) {
+    std::cout << " / " << fingerprint.deviceName << " ("
+              << fingerprint.platformVersion << ", driver "
+              << fingerprint.driverVersion << ")";
+  }
+  std::cout << std::endl;
+
+  if (checkBaseline) {
+    std::vector<BaselineSample> baseline;
+    MachineFingerprint baselineFingerprint;
+    if (!LoadBaseline(baselinePath, &baseline, &baselineFingerprint)) {
+      return 1;
+    }
+    std::cout << "baseline: " << baselinePath << std::endl;
+    ReportFingerprintChanges(std::cout, baselineFingerprint, fingerprint);
+    if (CompareWithBaseline(std::cout, baseline, current, threshold, alpha)) {
+      return 2;
+    }
+  }
+  if (saveBaseline) {
+    mkdir(baselineDir.c_str(), 0755);
+    if (!SaveBaseline(baselinePath, fingerprint, current)) {
+      return 1;
+    }
+    std::cout << "baseline saved to " << baselinePath << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,201 @@
+#include "rotate_build.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#include "rotate_metrics.h"
+#include "rotate_trace.h"
+
+ProgramBuilder::ProgramBuilder(int threads) : nextSeq_(0), stopping_(false) {
+  threads = std::max(1, threads);
+  for (int i = 0; i < threads; i++) {
+    workers_.push_back(std::thread(&ProgramBuilder::WorkerLoop, this));
+  }
+}
+
+ProgramBuilder::~ProgramBuilder() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_.notify_all();
+  for (size_t i = 0; i < workers_.size(); i++) {
+    workers_[i].join();
+  }
+  for (size_t i = 0; i < entries_.size(); i++) {
+    if (entries_[i]->program != NULL) clReleaseProgram(entries_[i]->program);
+  }
+}
+
+int ProgramBuilder::Submit(const BuildJob &job) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unique_ptr<Entry> entry(new Entry());
+  entry->job = job;
+  entry->seq = nextSeq_++;
+  entry->submitted = Clock::now();
+  entries_.push_back(std::move(entry));
+  work_.notify_one();
+  return (int)entries_.size() - 1;
+}
+
+int ProgramBuilder::NextQueued() const {
+  int best = -1;
+  for (size_t i = 0; i < entries_.size(); i++) {
+    const Entry &entry = *entries_[i];
+    if (entry.state != kQueued) {
+      continue;
+    }
+    if (best < 0 || entry.job.priority < entries_[best]->job.priority ||
+        (entry.job.priority == entries_[best]->job.priority &&
+         entry.seq < entries_[best]->seq)) {
+      best = (int)i;
+    }
+  }
+  return best;
+}
+
+void ProgramBuilder::WorkerLoop() {
+  for (;;) {
+    Entry *entry = NULL;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      int next = -1;
+      work_.wait(lock, [&] {
+        next = NextQueued();
+        return stopping_ || next >= 0;
+      });
+      if (stopping_) {
+        break;
+      }
+      entry = entries_[next].get();
+      entry->state = kBuilding;
+      entry->queuedSeconds =
+          std::chrono::duration<double>(Clock::now() - entry->submitted)
+              .count();
+    }
+    Build(entry);
+    done_.notify_all();
+  }
+}
+
+void ProgramBuilder::Build(Entry *entry) {
+  ROTATE_TRACE_SCOPE("ProgramBuilder::Build");
+  // 编译期间 job 不会再被修改（Wait 只调整排队中的任务），结果先放在局部变量里，
+  // 最后和 state 一起在 mutex_ 下写回，getter 不会读到写了一半的结果
+  const BuildJob &job = entry->job;
+  const char *sourceCStr = job.source.c_str();
+  cl_int status = CL_SUCCESS;
+  cl_program program = clCreateProgramWithSource(job.context, 1, &sourceCStr,
+                                                 NULL, &status);
+  if (status != CL_SUCCESS) {
+    if (!job.quiet) {
+      std::cout << "clCreateProgramWithSource(" << job.name << ") failed."
+                << std::endl;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    entry->status = status;
+    entry->state = kDone;
+    return;
+  }
+  Metrics().buildCacheMisses.Add();
+  Clock::time_point start = Clock::now();
+  status = clBuildProgram(program, 1, &job.device, job.options.c_str(), NULL,
+                          NULL);
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  Metrics().buildSeconds.Observe(seconds);
+
+  std::string capturedLog;
+  size_t size = 0;
+  if (clGetProgramBuildInfo(program, job.device, CL_PROGRAM_BUILD_LOG, 0, NULL,
+                            &size) == CL_SUCCESS &&
+      size > 1) {
+    std::string log(size, '\0');
+    if (clGetProgramBuildInfo(program, job.device, CL_PROGRAM_BUILD_LOG, size,
+                              &log[0], NULL) == CL_SUCCESS) {
+      log.resize(strlen(log.c_str()));
+      if (log.find_first_not_of(" \t\r\n") != std::string::npos) {
+        capturedLog = log;
+      }
+    }
+  }
+  if (status != CL_SUCCESS) {
+    Metrics().buildFailures.Add();
+    clReleaseProgram(program);
+    program = NULL;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  entry->program = program;
+  entry->status = status;
+  entry->buildSeconds = seconds;
+  entry->log = capturedLog;
+  entry->state = kDone;
+}
+
+cl_program ProgramBuilder::Wait(int id, cl_int *status) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (id < 0 || id >= (int)entries_.size()) {
+    *status = CL_INVALID_VALUE;
+    return NULL;
+  }
+  Entry *entry = entries_[id].get();
+  if (entry->state == kQueued) {
+    // 马上要用：排到所有任务前面，下一个空闲线程就编译它
+    entry->job.priority = std::numeric_limits<int>::min();
+  }
+  done_.wait(lock, [entry] { return entry->state == kDone; });
+  *status = entry->status;
+  if (entry->status != CL_SUCCESS && !entry->job.quiet) {
+    std::cout << "clBuildProgram(" << entry->job.name << ") failed."
+              << std::endl;
+    if (!entry->log.empty()) {
+      std::cout << "Build log:" << std::endl << entry->log << std::endl;
+    }
+  }
+  return entry->program;
+}
+
+bool ProgramBuilder::Done(int id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return id >= 0 && id < (int)entries_.size() &&
+         entries_[id]->state == kDone;
+}
+
+double ProgramBuilder::buildSeconds(int id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return id >= 0 && id < (int)entries_.size() ? entries_[id]->buildSeconds : 0;
+}
+
+std::string ProgramBuilder::buildLog(int id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return id >= 0 && id < (int)entries_.size() ? entries_[id]->log
+                                              : std::string();
+}
+
+void ProgramBuilder::PrintStats(std::ostream &os) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  os << "builds: " << entries_.size() << " programs on " << workers_.size()
+     << " threads" << std::endl;
+  for (size_t i = 0; i < entries_.size(); i++) {
+    const Entry &entry = *entries_[i];
+    char device[128] = "";
+    clGetDeviceInfo(entry.job.device, CL_DEVICE_NAME, sizeof(device), device,
+                    NULL);
+    os << "  " << entry.job.name << " on " << device << ": ";
+    if (entry.state == kQueued) {
+      os << "not built" << std::endl;
+      continue;
+    }
+    if (entry.state == kBuilding) {
+      os << "building" << std::endl;
+      continue;
+    }
+    os << "queued " << entry.queuedSeconds * 1e3 << " ms, compiled in "
+       << entry.buildSeconds * 1e3 << " ms";
+    if (entry.status != CL_SUCCESS) {
+      os << ", failed (" << entry.status << ")";
+    }
+    os << std::endl;
+  }
+}
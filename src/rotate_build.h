@@ -0,0 +1,106 @@
+#ifndef OPENCL_EXAMPLE_ROTATE_BUILD_H_
+#define OPENCL_EXAMPLE_ROTATE_BUILD_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <CL/cl.h>
+
+/**
+ * @brief 一个编译任务：在 context 的 device 上用 options 编译 source
+ * @param name 变体名，只用于日志和统计
+ * @param priority 越小越先编译；第一批请求就要用的变体给 0，其余给更大的值
+ */
+struct BuildJob {
+  BuildJob() : context(NULL), device(NULL), priority(0), quiet(false) {}
+  cl_context context;
+  cl_device_id device;
+  std::string name;
+  std::string source;
+  std::string options;
+  int priority;
+  // 失败时不打印（编译日志仍可通过 buildLog 取得）
+  bool quiet;
+};
+
+/**
+ * ========== 并行编译 ==========
+ * 多个设备、多个 kernel 变体（不同的 -D 选项）逐个 clBuildProgram 时，启动时间是所有
+ * 编译时间之和。ProgramBuilder 用固定数量的线程并行编译，每个任务是一个独立的
+ * cl_program，不同 program 上的 clBuildProgram 可以在多个线程中同时调用。
+ *  - 空闲线程总是取优先级最高（priority 最小、提交最早）的任务
+ *  - Wait 一个还在排队的任务时把它提到最前面，所以低优先级的变体可以放在后台慢慢编译，
+ *    第一次用到时才真正等待
+ *  - 析构时丢弃还没开始的任务，等待正在编译的任务结束，并释放全部 program
+ * 每个任务的排队时间和编译时间记入统计（PrintStats）和指标（rotate_build_seconds）。
+ */
+class ProgramBuilder {
+ public:
+  explicit ProgramBuilder(int threads);
+  ~ProgramBuilder();
+
+  ProgramBuilder(const ProgramBuilder &) = delete;
+  ProgramBuilder &operator=(const ProgramBuilder &) = delete;
+
+  /**
+   * @brief 提交一个编译任务，立即返回任务编号
+   */
+  int Submit(const BuildJob &job);
+
+  /**
+   * @brief 等待任务编译完成
+   * @return 编译好的 program，由 ProgramBuilder 持有（需要更长生命周期时自行 retain）；
+   *         失败时返回 NULL，status 为错误码，编译日志已经打印
+   */
+  cl_program Wait(int id, cl_int *status);
+
+  // 任务是否已经结束（成功或失败），不阻塞
+  bool Done(int id);
+  double buildSeconds(int id);
+  std::string buildLog(int id);
+
+  /**
+   * @brief 打印每个任务的变体名、设备、排队时间、编译时间和结果
+   */
+  void PrintStats(std::ostream &os);
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+  enum State { kQueued, kBuilding, kDone };
+
+  struct Entry {
+    Entry() : program(NULL), status(CL_SUCCESS), state(kQueued), seq(0),
+              queuedSeconds(0), buildSeconds(0) {}
+    BuildJob job;
+    cl_program program;
+    cl_int status;
+    State state;
+    long seq;  // 提交顺序，优先级相同时先提交的先编译
+    Clock::time_point submitted;
+    double queuedSeconds;
+    double buildSeconds;
+    std::string log;
+  };
+
+  void WorkerLoop();
+  // 调用时持有 mutex_，没有排队任务时返回 -1
+  int NextQueued() const;
+  // 在 worker 线程上编译，不持有 mutex_；结束时在 mutex_ 下写回结果并置为 kDone
+  void Build(Entry *entry);
+
+  std::mutex mutex_;
+  std::condition_variable work_;
+  std::condition_variable done_;
+  std::vector<std::unique_ptr<Entry>> entries_;
+  std::vector<std::thread> workers_;
+  long nextSeq_;
+  bool stopping_;
+};
+
+#endif  // OPENCL_EXAMPLE_ROTATE_BUILD_H_
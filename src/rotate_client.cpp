@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "tclap/CmdLine.h"
+
+#include "rotate_angle.h"
+#include "rotate_image.h"
+#include "rotate_protocol.h"
+
+/**
+ * opencl_rotate_client：向 `opencl_rotate --daemon` 提交旋转请求的示例客户端
+ *  - 1. 创建 memfd 并加上 F_SEAL_SHRINK 封印后映射，输入放在偏移 0，输出放在下一个页对齐的位置
+ *  - 2. 连接守护进程，第一次请求通过 SCM_RIGHTS 附带 memfd
+ *  - 3. 之后的请求只发送 RotateRequest，图像数据始终留在共享内存中
+ */
+
+static size_t AlignToPage(size_t bytes) {
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  return (bytes + page - 1) / page * page;
+}
+
+int main(int argc, char **argv) {
+  std::string socketPath;
+  int width = 6;
+  int height = 6;
+  float angle = 90.0f;
+  int count = 1;
+  bool pitched = false;
+  bool bulk = false;
+  try {
+    TCLAP::CmdLine cmd("Client of opencl_rotate --daemon", ' ', "0.1");
+    TCLAP::ValueArg<std::string> socketArg("s", "socket", "Unix socket path",
+                                           false, kDefaultSocketPath, "path",
+                                           cmd);
+    TCLAP::ValueArg<int> widthArg("W", "width", "Image width", false, width,
+                                  "int", cmd);
+    TCLAP::ValueArg<int> heightArg("H", "height", "Image height", false,
+                                   height, "int", cmd);
+    TCLAP::ValueArg<float> angleArg("a", "angle", "Rotation angle in degrees",
+                                    false, angle, "float", cmd);
+    TCLAP::ValueArg<int> countArg("n", "count", "Number of requests to send",
+                                  false, count, "int", cmd);
+    TCLAP::SwitchArg pitchedArg(
+        "p", "pitched",
+        "Pad rows to a 64-byte boundary and send the row pitch", cmd, false);
+    TCLAP::SwitchArg bulkArg(
+        "", "bulk",
+        "Send the requests as low-priority background work", cmd, false);
+    cmd.parse(argc, argv);
+    socketPath = socketArg.getValue();
+    width = widthArg.getValue();
+    height = heightArg.getValue();
+    angle = angleArg.getValue();
+    count = std::max(1, countArg.getValue());
+    pitched = pitchedArg.getValue();
+    bulk = bulkArg.getValue();
+  } catch (TCLAP::ArgException &e) {
+    std::cerr << "error: " << e.error() << " for arg " << e.argId()
+              << std::endl;
+    return 1;
+  }
+  if (width <= 0 || height <= 0) {
+    std::cout << "Invalid image size." << std::endl;
+    return 1;
+  }
+
+  // 1. 创建共享内存，--pitched 时每行按 cache line 对齐，行尾留出填充
+  const int pitch = pitched ? (int)AlignedPitch(width, sizeof(int)) : width;
+  const size_t frameBytes = (size_t)pitch * height * sizeof(int);
+  const size_t outOffset = AlignToPage(frameBytes);
+  const size_t shmSize = outOffset + AlignToPage(frameBytes);
+  int memfd =
+      memfd_create("opencl_rotate_frame", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (memfd < 0 || ftruncate(memfd, shmSize) != 0) {
+    std::cout << "memfd_create failed: " << strerror(errno) << std::endl;
+    return 1;
+  }
+  // 守护进程只接受不能再缩小的 memfd，否则截断文件会让它访问映射时收到 SIGBUS
+  if (fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK) != 0) {
+    std::cout << "F_ADD_SEALS failed: " << strerror(errno) << std::endl;
+    return 1;
+  }
+  char *base = (char *)mmap(NULL, shmSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                            memfd, 0);
+  if (base == MAP_FAILED) {
+    std::cout << "mmap failed: " << strerror(errno) << std::endl;
+    return 1;
+  }
+  int *inbuffer = (int *)base;
+  int *outbuffer = (int *)(base + outOffset);
+  for (int i = 0; i < height; i++) {
+    for (int j = 0; j < width; j++) {
+      inbuffer[i * pitch + j] = i * width + j;
+    }
+  }
+
+  // 2. 连接守护进程
+  int sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+  if (sock < 0 ||
+      connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    std::cout << "connect " << socketPath << " failed: " << strerror(errno)
+              << std::endl;
+    return 1;
+  }
+
+  // 3. 发送请求
+  RotateRequest req;
+  memset(&req, 0, sizeof(req));
+  req.magic = kRotateMagic;
+  req.width = width;
+  req.height = height;
+  AngleToSinCos(angle, &req.sinTheta, &req.cosTheta);
+  req.shmSize = shmSize;
+  req.inOffset = 0;
+  req.outOffset = outOffset;
+  req.inPitch = pitch;
+  req.outPitch = pitch;
+  req.priority = bulk ? kRotatePriorityBulk : kRotatePriorityInteractive;
+
+  std::vector<double> latencies;
+  int busy = 0;
+  bool fdSent = false;
+  for (int i = 0; i < count; i++) {
+    memset(outbuffer, 0, frameBytes);
+    req.id = (uint32_t)i;
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    if (!SendMessage(sock, &req, sizeof(req), fdSent ? -1 : memfd)) {
+      std::cout << "send failed: " << strerror(errno) << std::endl;
+      return 1;
+    }
+    fdSent = true;
+    RotateResponse resp;
+    int fd = -1;
+    if (RecvMessage(sock, &resp, sizeof(resp), &fd) != (long)sizeof(resp) ||
+        resp.magic != kRotateMagic || resp.id != req.id) {
+      std::cout << "Bad response from daemon." << std::endl;
+      return 1;
+    }
+    if (resp.status == kRotateBusy) {
+      // 守护进程队列已满，退避后重发同一个请求
+      busy++;
+      usleep(100);
+      i--;
+      continue;
+    }
+    if (resp.status != 0) {
+      std::cout << "Rotation failed, status = " << resp.status << std::endl;
+      return 1;
+    }
+    latencies.push_back(std::chrono::duration<double, std::micro>(
+                            std::chrono::steady_clock::now() - start)
+                            .count());
+  }
+
+  if (width * height <= 256) {
+    for (int i = 0; i < height; i++) {
+      for (int j = 0; j < width; j++) {
+        std::cout << outbuffer[i * pitch + j] << " ";
+      }
+      std::cout << std::endl;
+    }
+  }
+  std::sort(latencies.begin(), latencies.end());
+  std::cout << "requests: " << count << ", min: " << latencies.front()
+            << " us, median: " << latencies[latencies.size() / 2]
+            << " us, max: " << latencies.back() << " us, busy retries: "
+            << busy << std::endl;
+
+  close(sock);
+  munmap(base, shmSize);
+  close(memfd);
+  return 0;
+}
@@ -0,0 +1,190 @@
+#include "rotate_cpu.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "rotate_engine.h"
+
+// 每隔一个 cache line（16 个 int）预取一次下一行
+static const int kPrefetchStride = 16;
+
+void rotate(unsigned char *inbuf, unsigned char *outbuf, int w, int h,
+            float sinTheta, float cosTheta) {
+  RotateCpu<unsigned char>(inbuf, outbuf, w, h, sinTheta, cosTheta);
+}
+
+void RotateYuvCpu(const unsigned char *inbuf, unsigned char *outbuf, int w,
+                  int h, YuvFormat format, float sinTheta, float cosTheta) {
+  RotateYuvCpuPitched(inbuf, w, outbuf, w, w, h, format, sinTheta, cosTheta);
+}
+
+void RotateYuvCpuPitched(const unsigned char *inbuf, int inPitch,
+                         unsigned char *outbuf, int outPitch, int w, int h,
+                         YuvFormat format, float sinTheta, float cosTheta) {
+  RotateCpuPitched<unsigned char>(inbuf, inPitch, outbuf, outPitch, w, h,
+                                  sinTheta, cosTheta);
+  int cw = w / 2;
+  int ch = h / 2;
+  int inChromaPitch = inPitch / 2;
+  int outChromaPitch = outPitch / 2;
+  const unsigned char *inChroma = inbuf + (size_t)inPitch * h;
+  unsigned char *outChroma = outbuf + (size_t)outPitch * h;
+  if (IsSemiPlanar(format)) {
+    // pitch 是偶数，平面起始和每行起始都是偶数偏移，按 uint16_t 访问 UV 对是对齐的
+    RotateCpuPitched<uint16_t>((const uint16_t *)inChroma, inChromaPitch,
+                               (uint16_t *)outChroma, outChromaPitch, cw, ch,
+                               sinTheta, cosTheta);
+  } else {
+    RotateCpuPitched<unsigned char>(inChroma, inChromaPitch, outChroma,
+                                    outChromaPitch, cw, ch, sinTheta, cosTheta);
+    RotateCpuPitched<unsigned char>(
+        inChroma + (size_t)inChromaPitch * ch, inChromaPitch,
+        outChroma + (size_t)outChromaPitch * ch, outChromaPitch, cw, ch,
+        sinTheta, cosTheta);
+  }
+}
+
+const char *CpuRotateModeName(CpuRotateMode mode) {
+  switch (mode) {
+    case kCpuPrefetch:
+      return "prefetch";
+    case kCpuStream:
+      return "stream";
+    default:
+      return "plain";
+  }
+}
+
+bool ParseCpuRotateMode(const std::string &name, CpuRotateMode *mode) {
+  for (int i = 0; i < kCpuRotateModeCount; i++) {
+    if (name == CpuRotateModeName((CpuRotateMode)i)) {
+      *mode = (CpuRotateMode)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief 预取 + 可选非临时存储的行循环，Stream 为编译期常量，内层循环没有额外分支
+ */
+template <bool Stream>
+static void RotateRowsPrefetch(const int *inbuf, int inPitch, int *outbuf,
+                               int outPitch, int w, int h, float sinTheta,
+                               float cosTheta) {
+  int xc = w / 2;
+  int yc = h / 2;
+  for (int i = 0; i < h; i++) {
+    const int *src = inbuf + (size_t)i * inPitch;
+    const int *next = i + 1 < h ? src + inPitch : src;
+    for (int j = 0; j < w; j++) {
+      if (j % kPrefetchStride == 0) {
+        __builtin_prefetch(next + j, 0, 3);
+      }
+      int xpos = (j - xc) * cosTheta - (i - yc) * sinTheta + xc;
+      int ypos = (j - xc) * sinTheta + (i - yc) * cosTheta + yc;
+      if (xpos >= 0 && ypos >= 0 && xpos < w && ypos < h) {
+        int *dst = outbuf + (size_t)ypos * outPitch + xpos;
+#if defined(__SSE2__)
+        if (Stream) {
+          _mm_stream_si32(dst, src[j]);
+          continue;
+        }
+#endif
+        *dst = src[j];
+      }
+    }
+  }
+#if defined(__SSE2__)
+  if (Stream) {
+    // 非临时存储是弱序的，返回前保证对其他线程（以及之后的 DMA）可见
+    _mm_sfence();
+  }
+#endif
+}
+
+void RotateCpuInt(const int *inbuf, int inPitch, int *outbuf, int outPitch,
+                  int w, int h, float sinTheta, float cosTheta,
+                  CpuRotateMode mode) {
+  switch (mode) {
+    case kCpuPrefetch:
+      RotateRowsPrefetch<false>(inbuf, inPitch, outbuf, outPitch, w, h,
+                                sinTheta, cosTheta);
+      break;
+    case kCpuStream:
+      RotateRowsPrefetch<true>(inbuf, inPitch, outbuf, outPitch, w, h,
+                               sinTheta, cosTheta);
+      break;
+    default:
+      RotateCpuPitched<int>(inbuf, inPitch, outbuf, outPitch, w, h, sinTheta,
+                            cosTheta);
+      break;
+  }
+}
+
+/**
+ * @brief RotateCpuParallel 的一个条带：源图第 srcRow0 行起的 srcRows 行，
+ *        只写落在输出第 [dstRow0, dstRow0 + dstRows) 行的像素
+ */
+static void RotateBandRows(const int *inbuf, int inPitch, int *outbuf,
+                           int outPitch, int w, int h, float sinTheta,
+                           float cosTheta, const RotateBand &band) {
+  int xc = w / 2;
+  int yc = h / 2;
+  int dstEnd = band.dstRow0 + band.dstRows;
+  for (int i = band.srcRow0; i < band.srcRow0 + band.srcRows; i++) {
+    // 一行源像素的目标行随 j 单调变化，只扫描可能落进本条带的列（两端多留两列抵消取整），
+    // 各线程加起来的工作量约等于一幅图，而不是每个条带都扫完整的 halo 行
+    int j0 = 0;
+    int j1 = w;
+    if (std::fabs(sinTheta) > 1e-6f) {
+      float base = (i - yc) * cosTheta + yc;
+      float ja = xc + (band.dstRow0 - 1 - base) / sinTheta;
+      float jb = xc + (dstEnd + 1 - base) / sinTheta;
+      j0 = std::max(0, (int)std::floor(std::min(ja, jb)) - 2);
+      j1 = std::min(w, (int)std::ceil(std::max(ja, jb)) + 2);
+    }
+    for (int j = j0; j < j1; j++) {
+      int xpos = (j - xc) * cosTheta - (i - yc) * sinTheta + xc;
+      int ypos = (j - xc) * sinTheta + (i - yc) * cosTheta + yc;
+      if (xpos >= 0 && xpos < w && ypos >= band.dstRow0 && ypos < dstEnd)
+        outbuf[(size_t)ypos * outPitch + xpos] = inbuf[(size_t)i * inPitch + j];
+    }
+  }
+}
+
+void RotateCpuParallel(const int *inbuf, int inPitch, int *outbuf,
+                       int outPitch, int w, int h, float sinTheta,
+                       float cosTheta, int threads) {
+  if (threads <= 0) {
+    threads = (int)std::max(1u, std::thread::hardware_concurrency());
+  }
+  threads = std::min(threads, h);
+  if (threads <= 1) {
+    RotateCpuPitched<int>(inbuf, inPitch, outbuf, outPitch, w, h, sinTheta,
+                          cosTheta);
+    return;
+  }
+  // host 内存没有 sub-buffer 的对齐要求，条带可以从任意行开始
+  std::vector<RotateBand> plan;
+  PlanRotateBands(w, h, sinTheta, cosTheta, inPitch, outPitch, threads,
+                  sizeof(int), &plan);
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < plan.size(); i++) {
+    workers.push_back(std::thread(RotateBandRows, inbuf, inPitch, outbuf,
+                                  outPitch, w, h, sinTheta, cosTheta,
+                                  plan[i]));
+  }
+  RotateBandRows(inbuf, inPitch, outbuf, outPitch, w, h, sinTheta, cosTheta,
+                 plan[0]);
+  for (size_t i = 0; i < workers.size(); i++) {
+    workers[i].join();
+  }
+}
@@ -0,0 +1,129 @@
+#ifndef OPENCL_EXAMPLE_ROTATE_CPU_H_
+#define OPENCL_EXAMPLE_ROTATE_CPU_H_
+
+#include <string>
+
+#include "rotate_format.h"
+
+/**
+ * ========== CPU 旋转实现 ==========
+ * 与 rotate.cl 中的 image_rotate 使用相同的正向映射：遍历输入像素，
+ * 计算旋转后的位置并写入输出，落在图像外的像素被丢弃，未被写到的输出像素保持原值。
+ * 既作为 OpenCL 结果的参考实现，也是 benchmark 中的 CPU 后端。
+ */
+
+/**
+ * @brief 带行跨度的模板版本，T 为像素类型（unsigned char 灰度图、int 打包像素等）
+ * @note inPitch / outPitch 以元素计，第 y 行从 y * pitch 开始
+ */
+template <typename T>
+void RotateCpuPitched(const T *inbuf, int inPitch, T *outbuf, int outPitch,
+                      int w, int h, float sinTheta, float cosTheta) {
+  int xc = w / 2;
+  int yc = h / 2;
+  for (int i = 0; i < h; i++) {
+    for (int j = 0; j < w; j++) {
+      int xpos = (j - xc) * cosTheta - (i - yc) * sinTheta + xc;
+      int ypos = (j - xc) * sinTheta + (i - yc) * cosTheta + yc;
+      if (xpos >= 0 && ypos >= 0 && xpos < w && ypos < h)
+        outbuf[(size_t)ypos * outPitch + xpos] = inbuf[(size_t)i * inPitch + j];
+    }
+  }
+}
+
+/**
+ * @brief 紧密排列的版本，pitch == w
+ */
+template <typename T>
+void RotateCpu(const T *inbuf, T *outbuf, int w, int h, float sinTheta,
+               float cosTheta) {
+  RotateCpuPitched<T>(inbuf, w, outbuf, w, w, h, sinTheta, cosTheta);
+}
+
+/**
+ * @brief 源图为 tile 排列（见 rotate_image.h 的 TileImage）的版本，输出仍按行排列
+ * @note 按块遍历源图，命中的输出像素与 RotateCpu 相同；多个源像素落到同一输出位置时
+ *       保留哪一个取决于遍历顺序（GPU 上本来也不确定）
+ */
+template <typename T>
+void RotateCpuTiled(const T *tiled, int tile, T *outbuf, int outPitch, int w,
+                    int h, float sinTheta, float cosTheta) {
+  int xc = w / 2;
+  int yc = h / 2;
+  int tilesX = (w + tile - 1) / tile;
+  int tilesY = (h + tile - 1) / tile;
+  for (int ty = 0; ty < tilesY; ty++) {
+    for (int tx = 0; tx < tilesX; tx++) {
+      const T *block = tiled + ((size_t)ty * tilesX + tx) * tile * tile;
+      int yEnd = ty * tile + tile < h ? tile : h - ty * tile;
+      int xEnd = tx * tile + tile < w ? tile : w - tx * tile;
+      for (int y = 0; y < yEnd; y++) {
+        int i = ty * tile + y;
+        for (int x = 0; x < xEnd; x++) {
+          int j = tx * tile + x;
+          int xpos = (j - xc) * cosTheta - (i - yc) * sinTheta + xc;
+          int ypos = (j - xc) * sinTheta + (i - yc) * cosTheta + yc;
+          if (xpos >= 0 && ypos >= 0 && xpos < w && ypos < h)
+            outbuf[(size_t)ypos * outPitch + xpos] = block[y * tile + x];
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief int 像素 CPU 旋转的访存方式
+ * @note kCpuPrefetch：遍历第 i 行时按 cache line 预取第 i+1 行的源像素；
+ *       kCpuStream：在预取之外用非临时存储（_mm_stream_si32）写输出，绕过 cache，
+ *       避免超过 LLC 的大图把从不再读的输出塞满 cache。
+ *       正向映射的输出是斜线上的离散写，每次非临时写都是一次不满 cache line 的
+ *       部分写，多数机器上反而更慢，用 opencl_rotate_bench --cpu-mode 实测后再选择
+ */
+enum CpuRotateMode { kCpuPlain, kCpuPrefetch, kCpuStream, kCpuRotateModeCount };
+
+const char *CpuRotateModeName(CpuRotateMode mode);
+bool ParseCpuRotateMode(const std::string &name, CpuRotateMode *mode);
+
+/**
+ * @brief int 像素的 CPU 旋转，结果与 RotateCpuPitched<int> 完全相同
+ * @note 不支持 SSE2 的平台上 kCpuStream 退化为普通写入
+ */
+void RotateCpuInt(const int *inbuf, int inPitch, int *outbuf, int outPitch,
+                  int w, int h, float sinTheta, float cosTheta,
+                  CpuRotateMode mode);
+
+/**
+ * @brief 多线程的 int 像素 CPU 旋转，结果与 RotateCpuPitched<int> 完全相同
+ * @note 按输出行切成 threads 个条带（PlanRotateBands），每个线程只扫描可能落进自己条带的
+ *       源图行、只写自己的输出行，线程之间没有写冲突；同一条带内仍按行优先顺序遍历，
+ *       多个源像素落到同一位置时保留的像素与单线程版本一致。
+ *       threads <= 0 时使用 std::thread::hardware_concurrency()
+ */
+void RotateCpuParallel(const int *inbuf, int inPitch, int *outbuf,
+                       int outPitch, int w, int h, float sinTheta,
+                       float cosTheta, int threads);
+
+/**
+ * @brief YUV420 帧旋转，与 rotate.cl 中的 image_rotate_yuv 结果一致
+ * @note 亮度按 unsigned char 旋转；色度平面尺寸减半，以自己的中心旋转，
+ *       NV12/NV21 的 UV 对按 2 字节整体移动。w、h 必须是偶数
+ */
+void RotateYuvCpu(const unsigned char *inbuf, unsigned char *outbuf, int w,
+                  int h, YuvFormat format, float sinTheta, float cosTheta);
+
+/**
+ * @brief 带行跨度的 YUV420 旋转，pitch 为亮度行跨度（字节，偶数），
+ *        色度排列见 YuvPitchedFrameBytes(h, pitch)
+ */
+void RotateYuvCpuPitched(const unsigned char *inbuf, int inPitch,
+                         unsigned char *outbuf, int outPitch, int w, int h,
+                         YuvFormat format, float sinTheta, float cosTheta);
+
+/**
+ * @brief 图像旋转函数
+ * @note OpenCL C Kernel 代码见 rotate.cl
+ */
+void rotate(unsigned char *inbuf, unsigned char *outbuf, int w, int h,
+            float sinTheta, float cosTheta);
+
+#endif  // OPENCL_EXAMPLE_ROTATE_CPU_H_
@@ -0,0 +1,286 @@
+#include "rotate_daemon.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "rotate_image.h"
+#include "rotate_metrics.h"
+
+static const int kPollIntervalMs = 200;
+static const int kMaxDimension = 1 << 15;
+
+RotateDaemon::SharedFrame::SharedFrame()
+    : base(NULL),
+      size(0),
+      in(NULL),
+      out(NULL),
+      inOffset(0),
+      outOffset(0),
+      inBytes(0),
+      outBytes(0) {}
+
+RotateDaemon::SharedFrame::~SharedFrame() { Reset(); }
+
+void RotateDaemon::SharedFrame::ReleaseBuffers() {
+  if (in != NULL) clReleaseMemObject(in);
+  if (out != NULL) clReleaseMemObject(out);
+  in = NULL;
+  out = NULL;
+  inBytes = 0;
+  outBytes = 0;
+  engine.reset();
+}
+
+void RotateDaemon::SharedFrame::Reset() {
+  ReleaseBuffers();
+  if (base != NULL) munmap(base, size);
+  base = NULL;
+  size = 0;
+}
+
+RotateDaemon::RotateDaemon(FailoverRotator *rotator, BatchScheduler *batcher)
+    : rotator_(rotator), batcher_(batcher), running_(false) {}
+
+int RotateDaemon::Run(const std::string &socketPath) {
+  int listenFd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (listenFd < 0) {
+    std::cout << "socket failed: " << strerror(errno) << std::endl;
+    return 1;
+  }
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(addr.sun_path)) {
+    std::cout << "Socket path too long: " << socketPath << std::endl;
+    close(listenFd);
+    return 1;
+  }
+  strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+  unlink(socketPath.c_str());
+  if (bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(listenFd, 16) != 0) {
+    std::cout << "bind/listen failed: " << strerror(errno) << std::endl;
+    close(listenFd);
+    return 1;
+  }
+  std::cout << "opencl_rotate daemon listening on " << socketPath << std::endl;
+
+  running_.store(true);
+  // 连接结束的线程在 accept 循环里回收，常驻进程不会累积线程句柄和栈；
+  // std::list 保证 done 的地址在其他元素删除后仍然有效
+  std::list<ClientThread> clients;
+  while (running_.load()) {
+    for (std::list<ClientThread>::iterator it = clients.begin();
+         it != clients.end();) {
+      if (it->done.load()) {
+        it->thread.join();
+        it = clients.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    struct pollfd pfd = {listenFd, POLLIN, 0};
+    if (poll(&pfd, 1, kPollIntervalMs) <= 0) {
+      continue;
+    }
+    int clientFd = accept4(listenFd, NULL, NULL, SOCK_CLOEXEC);
+    if (clientFd < 0) {
+      continue;
+    }
+    clients.emplace_back();
+    ClientThread &client = clients.back();
+    client.thread =
+        std::thread(&RotateDaemon::ServeClient, this, clientFd, &client.done);
+  }
+
+  for (std::list<ClientThread>::iterator it = clients.begin();
+       it != clients.end(); ++it) {
+    it->thread.join();
+  }
+  close(listenFd);
+  unlink(socketPath.c_str());
+  std::cout << "opencl_rotate daemon stopped." << std::endl;
+  return 0;
+}
+
+void RotateDaemon::ServeClient(int clientFd, std::atomic<bool> *done) {
+  SharedFrame frame;
+  while (running_.load()) {
+    struct pollfd pfd = {clientFd, POLLIN, 0};
+    if (poll(&pfd, 1, kPollIntervalMs) <= 0) {
+      continue;
+    }
+    RotateRequest req;
+    int fd = -1;
+    long n = RecvMessage(clientFd, &req, sizeof(req), &fd);
+    if (n <= 0) {
+      break;
+    }
+
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    RotateResponse resp;
+    resp.magic = kRotateMagic;
+    resp.id = req.id;
+    if (n != (long)sizeof(req) || req.magic != kRotateMagic) {
+      resp.status = CL_INVALID_VALUE;
+    } else {
+      resp.status = Handle(req, fd, &frame);
+    }
+    if (resp.status < 0) {
+      Metrics().errors.Add(resp.status);
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+    resp.micros = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+    if (!SendMessage(clientFd, &resp, sizeof(resp), -1)) {
+      break;
+    }
+  }
+  close(clientFd);
+  done->store(true);
+}
+
+int32_t RotateDaemon::Handle(const RotateRequest &req, int fd,
+                             SharedFrame *frame) {
+  if (req.width <= 0 || req.height <= 0 || req.width > kMaxDimension ||
+      req.height > kMaxDimension) {
+    return CL_INVALID_VALUE;
+  }
+  // 1. 附带了新的 memfd：替换掉旧的映射（cl_mem 也随之失效）
+  if (fd >= 0) {
+    frame->Reset();
+    // 映射超出文件末尾、或客户端之后截断文件，访问映射都会收到 SIGBUS，整个进程退出：
+    // 只接受不能缩小的 memfd，并且 shmSize 不超过当前的文件大小
+    int seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || (seals & F_SEAL_SHRINK) == 0) {
+      std::cout << "Rejected shared memory without F_SEAL_SHRINK." << std::endl;
+      return CL_INVALID_VALUE;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      std::cout << "fstat failed: " << strerror(errno) << std::endl;
+      return CL_INVALID_VALUE;
+    }
+    if (req.shmSize == 0 || req.shmSize > (uint64_t)st.st_size) {
+      std::cout << "Rejected shared memory size " << req.shmSize
+                << " larger than the file (" << st.st_size << " bytes)."
+                << std::endl;
+      return CL_INVALID_VALUE;
+    }
+    void *base = mmap(NULL, req.shmSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      fd, 0);
+    if (base == MAP_FAILED) {
+      std::cout << "mmap failed: " << strerror(errno) << std::endl;
+      return CL_INVALID_VALUE;
+    }
+    frame->base = base;
+    frame->size = req.shmSize;
+  }
+  if (frame->base == NULL) {
+    return CL_INVALID_VALUE;
+  }
+
+  // pitch 为 0 表示紧密排列
+  int inPitch = req.inPitch > 0 ? req.inPitch : req.width;
+  int outPitch = req.outPitch > 0 ? req.outPitch : req.width;
+  if (inPitch < req.width || outPitch < req.width || inPitch > kMaxDimension ||
+      outPitch > kMaxDimension) {
+    return CL_INVALID_VALUE;
+  }
+  size_t inBytes = StridedBytes(req.width, req.height, inPitch, sizeof(int));
+  size_t outBytes = StridedBytes(req.width, req.height, outPitch, sizeof(int));
+  if (req.inOffset > frame->size || req.outOffset > frame->size ||
+      inBytes > frame->size - req.inOffset ||
+      outBytes > frame->size - req.outOffset) {
+    return CL_INVALID_BUFFER_SIZE;
+  }
+
+  if (req.priority != kRotatePriorityInteractive &&
+      req.priority != kRotatePriorityBulk) {
+    return CL_INVALID_VALUE;
+  }
+
+  // 2. 批处理模式：直接把共享内存中的 host 指针交给调度器
+  if (batcher_ != NULL) {
+    return batcher_->Submit((const int *)((char *)frame->base + req.inOffset),
+                            inPitch,
+                            (int *)((char *)frame->base + req.outOffset),
+                            outPitch, req.width, req.height, req.sinTheta,
+                            req.cosTheta, (RotatePriority)req.priority);
+  }
+
+  // 3. 引擎串行执行，等锁的时间就是这条路径上的排队时间；
+  //    客户端在 out 中写好的内容就是背景：设备路径在 kernel 之前把它同步到设备端
+  //    副本（RotateHostPtr），没有可用设备时在 CPU 上完成，同样不填背景
+  std::chrono::steady_clock::time_point waitStart =
+      std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(engineMutex_);
+  Metrics().queueWaitSeconds.Observe(
+      std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                    waitStart)
+          .count());
+  const int *in = (const int *)((char *)frame->base + req.inOffset);
+  int *out = (int *)((char *)frame->base + req.outOffset);
+  return rotator_->Run(
+      1,
+      [&](const std::shared_ptr<RotateEngine> &engine) {
+        return RotateShared(engine, req, inPitch, outPitch, inBytes, outBytes,
+                            frame);
+      },
+      [&]() {
+        rotator_->RotateOnCpu(in, inPitch, out, outPitch, req.width,
+                              req.height, req.sinTheta, req.cosTheta, false);
+      });
+}
+
+cl_int RotateDaemon::RotateShared(const std::shared_ptr<RotateEngine> &engine,
+                                  const RotateRequest &req, int inPitch,
+                                  int outPitch, size_t inBytes,
+                                  size_t outBytes, SharedFrame *frame) {
+  // 帧大小、偏移或引擎变化时重新包装 cl_mem，否则直接复用
+  if (frame->in == NULL || frame->out == NULL || frame->engine != engine ||
+      frame->inBytes != inBytes || frame->outBytes != outBytes ||
+      frame->inOffset != req.inOffset || frame->outOffset != req.outOffset) {
+    Metrics().bufferPoolMisses.Add();
+    frame->ReleaseBuffers();
+    frame->engine = engine;
+    cl_int status = CL_SUCCESS;
+    frame->in = engine->CreateHostPtrBuffer(
+        (char *)frame->base + req.inOffset, inBytes, CL_MEM_READ_ONLY,
+        &status);
+    if (status != CL_SUCCESS) {
+      return status;
+    }
+    frame->out = engine->CreateHostPtrBuffer(
+        (char *)frame->base + req.outOffset, outBytes, CL_MEM_READ_WRITE,
+        &status);
+    if (status != CL_SUCCESS) {
+      return status;
+    }
+    frame->inBytes = inBytes;
+    frame->outBytes = outBytes;
+    frame->inOffset = req.inOffset;
+    frame->outOffset = req.outOffset;
+  } else {
+    Metrics().bufferPoolHits.Add();
+  }
+  return engine->RotateHostPtr(frame->in, inPitch, frame->out, outPitch,
+                               req.width, req.height, req.sinTheta,
+                               req.cosTheta, false);
+}
@@ -0,0 +1,84 @@
+#ifndef OPENCL_EXAMPLE_ROTATE_DAEMON_H_
+#define OPENCL_EXAMPLE_ROTATE_DAEMON_H_
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "rotate_engine.h"
+#include "rotate_failover.h"
+#include "rotate_protocol.h"
+#include "rotate_scheduler.h"
+
+/**
+ * @brief opencl_rotate 的守护进程模式
+ * @note 引擎只初始化一次并保持常驻，客户端通过 Unix domain socket 提交请求，
+ *       图像数据位于客户端传来的 memfd 共享内存中（协议见 rotate_protocol.h）。
+ *       每个连接一个线程，引擎由 engineMutex_ 串行访问；如果提供了
+ *       BatchScheduler，则请求交给调度器合并成批次后再执行。
+ *       引擎由 FailoverRotator 持有：设备不可用或出错时请求在 CPU 上完成，
+ *       设备恢复后自动切回，吞吐下降但不会中断服务。
+ */
+class RotateDaemon {
+ public:
+  explicit RotateDaemon(FailoverRotator *rotator,
+                        BatchScheduler *batcher = NULL);
+
+  /**
+   * @brief 监听 socketPath 并处理请求，直到 Stop() 被调用
+   * @return 0 表示正常退出
+   */
+  int Run(const std::string &socketPath);
+
+  /**
+   * @brief 请求退出，可以在信号处理函数中调用
+   */
+  void Stop() { running_.store(false); }
+
+ private:
+  /**
+   * @brief 一个连接对应的共享内存映射以及包装它的 cl_mem
+   * @note in/out 属于 engine 的 context；引擎被故障转移换掉后重新包装，
+   *       持有 engine 保证旧引擎在这些 cl_mem 释放之前不会销毁
+   */
+  struct SharedFrame {
+    SharedFrame();
+    ~SharedFrame();
+    void Reset();
+    void ReleaseBuffers();
+
+    void *base;
+    size_t size;
+    std::shared_ptr<RotateEngine> engine;
+    cl_mem in;
+    cl_mem out;
+    uint64_t inOffset;
+    uint64_t outOffset;
+    size_t inBytes;
+    size_t outBytes;
+  };
+
+  /**
+   * @brief 一个连接的处理线程，结束时置位 done，由 Run 在 accept 循环中 join
+   */
+  struct ClientThread {
+    ClientThread() : done(false) {}
+    std::thread thread;
+    std::atomic<bool> done;
+  };
+
+  void ServeClient(int clientFd, std::atomic<bool> *done);
+  int32_t Handle(const RotateRequest &req, int fd, SharedFrame *frame);
+  // 零拷贝路径的设备部分：按需（重新）包装共享内存，然后 RotateHostPtr
+  cl_int RotateShared(const std::shared_ptr<RotateEngine> &engine,
+                      const RotateRequest &req, int inPitch, int outPitch,
+                      size_t inBytes, size_t outBytes, SharedFrame *frame);
+
+  FailoverRotator *rotator_;
+  BatchScheduler *batcher_;
+  std::mutex engineMutex_;
+  std::atomic<bool> running_;
+};
+
+#endif  // OPENCL_EXAMPLE_ROTATE_DAEMON_H_
@@ -0,0 +1,162 @@
+#include "rotate_deadline.h"
+
+#include <algorithm>
+
+#include "rotate_trace.h"
+
+const char *FrameOutcomeName(FrameOutcome outcome) {
+  switch (outcome) {
+    case kFrameRotated:
+      return "rotated";
+    case kFrameDegraded:
+      return "degraded";
+    case kFrameDropped:
+      return "dropped";
+    default:
+      return "unknown";
+  }
+}
+
+DeadlineScheduler::DeadlineScheduler(RotateEngine *engine,
+                                     const DeadlineOptions &options)
+    : engine_(engine),
+      options_(options),
+      fullCost_(0),
+      degradedCost_(0),
+      late_(0) {
+  for (int i = 0; i < kFrameOutcomeCount; i++) {
+    outcomes_[i] = 0;
+  }
+  options_.alpha = std::min(1.0, std::max(0.01, options_.alpha));
+  options_.margin = std::max(1.0, options_.margin);
+  options_.degradeFactor = std::max(1, options_.degradeFactor);
+}
+
+void DeadlineScheduler::Observe(double *estimate, double seconds,
+                                size_t pixels) {
+  double cost = seconds / (double)std::max<size_t>(1, pixels);
+  *estimate = *estimate == 0
+                  ? cost
+                  : options_.alpha * cost + (1 - options_.alpha) * *estimate;
+}
+
+cl_int DeadlineScheduler::Process(const int *in, int inPitch, int *out,
+                                  int outPitch, int w, int h, float sinTheta,
+                                  float cosTheta, Clock::time_point deadline,
+                                  FrameOutcome *outcome) {
+  // 降级路径不经过 RotateStrided，参数在这里统一检查
+  if (w <= 0 || h <= 0 || inPitch < w || outPitch < w) {
+    return CL_INVALID_VALUE;
+  }
+  ROTATE_TRACE_SCOPE("DeadlineScheduler::Process");
+  const size_t pixels = (size_t)w * h;
+  const int factor = options_.degradeFactor;
+  const size_t smallPixels =
+      (size_t)((w + factor - 1) / factor) * ((h + factor - 1) / factor);
+  Clock::time_point start = Clock::now();
+  std::chrono::duration<double> budget = deadline - start;
+
+  // 1. 选择路径：没有样本时先完整执行一次；降级路径没有样本时按像素数从完整路径推算
+  FrameOutcome choice = kFrameRotated;
+  if (budget.count() <= 0) {
+    choice = kFrameDropped;
+  } else if (fullCost_ > 0 &&
+             fullCost_ * pixels * options_.margin > budget.count()) {
+    double degradedCost = degradedCost_ > 0 ? degradedCost_ : fullCost_;
+    if (factor > 1 &&
+        degradedCost * smallPixels * options_.margin <= budget.count()) {
+      choice = kFrameDegraded;
+    } else {
+      choice = kFrameDropped;
+    }
+  }
+
+  // 2. 执行并用实测耗时更新估计（按像素折算，不同尺寸的帧可以共用）
+  cl_int status = CL_SUCCESS;
+  if (choice == kFrameRotated) {
+    status = engine_->RotateStrided(in, inPitch, out, outPitch, w, h, sinTheta,
+                                    cosTheta);
+    if (status == CL_SUCCESS) {
+      Observe(&fullCost_, std::chrono::duration<double>(Clock::now() - start)
+                              .count(),
+              pixels);
+    }
+  } else if (choice == kFrameDegraded) {
+    double engineSeconds = 0;
+    status = RotateDegraded(in, inPitch, out, outPitch, w, h, sinTheta,
+                            cosTheta, &engineSeconds);
+    if (status == CL_SUCCESS) {
+      // 完整路径此时不会被执行，用引擎旋转缩小图的每像素耗时（固定开销摊到更少的像素上，
+      // 偏保守）更新它，负载回落后才能重新选择完整路径
+      Observe(&degradedCost_,
+              std::chrono::duration<double>(Clock::now() - start).count(),
+              smallPixels);
+      Observe(&fullCost_, engineSeconds, smallPixels);
+    }
+  } else {
+    // 丢帧没有新的样本，估计按 alpha 衰减，避免一次突发之后一直丢下去
+    fullCost_ *= 1 - options_.alpha;
+    degradedCost_ *= 1 - options_.alpha;
+  }
+  if (status != CL_SUCCESS) {
+    return status;
+  }
+  outcomes_[choice]++;
+  if (choice != kFrameDropped && Clock::now() > deadline) {
+    late_++;
+  }
+  if (outcome != NULL) {
+    *outcome = choice;
+  }
+  return CL_SUCCESS;
+}
+
+cl_int DeadlineScheduler::RotateDegraded(const int *in, int inPitch, int *out,
+                                         int outPitch, int w, int h,
+                                         float sinTheta, float cosTheta,
+                                         double *engineSeconds) {
+  ROTATE_TRACE_SCOPE("DeadlineScheduler::RotateDegraded");
+  const int factor = options_.degradeFactor;
+  const int sw = (w + factor - 1) / factor;
+  const int sh = (h + factor - 1) / factor;
+  smallIn_.resize((size_t)sw * sh);
+  smallOut_.resize((size_t)sw * sh);
+  // 1. 最近邻抽样缩小，中心随之缩小，旋转角度不变
+  for (int y = 0; y < sh; y++) {
+    const int *row = in + (size_t)y * factor * inPitch;
+    int *dst = smallIn_.data() + (size_t)y * sw;
+    for (int x = 0; x < sw; x++) {
+      dst[x] = row[x * factor];
+    }
+  }
+  Clock::time_point start = Clock::now();
+  cl_int status = engine_->Rotate(smallIn_.data(), smallOut_.data(), sw, sh,
+                                  sinTheta, cosTheta);
+  if (status != CL_SUCCESS) {
+    return status;
+  }
+  *engineSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+  // 2. 最近邻放大写回 out，每行末尾的填充保持不变
+  for (int y = 0; y < h; y++) {
+    const int *src = smallOut_.data() + (size_t)(y / factor) * sw;
+    int *dst = out + (size_t)y * outPitch;
+    for (int x = 0; x < w; x++) {
+      dst[x] = src[x / factor];
+    }
+  }
+  return CL_SUCCESS;
+}
+
+void DeadlineScheduler::PrintStats(std::ostream &os) const {
+  uint64_t total = 0;
+  for (int i = 0; i < kFrameOutcomeCount; i++) {
+    total += outcomes_[i];
+  }
+  os << "deadline: " << total << " frames";
+  for (int i = 0; i < kFrameOutcomeCount; i++) {
+    os << ", " << FrameOutcomeName((FrameOutcome)i) << " " << outcomes_[i];
+  }
+  os << ", late " << late_ << "; estimate " << fullCost_ * 1e9
+     << " ns/pixel full, " << degradedCost_ * 1e9 << " ns/pixel degraded"
+     << std::endl;
+}
@@ -0,0 +1,91 @@
+#ifndef OPENCL_EXAMPLE_ROTATE_DEADLINE_H_
+#define OPENCL_EXAMPLE_ROTATE_DEADLINE_H_
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "rotate_engine.h"
+
+/**
+ * @brief 截止时间调度的参数
+ * @param alpha 耗时估计的 EWMA 系数，越大越跟得上负载突变
+ * @param margin 预测耗时乘上的安全系数
+ * @param degradeFactor 降级路径的缩小倍数（每个方向），1 表示不允许降级
+ */
+struct DeadlineOptions {
+  DeadlineOptions() : alpha(0.2), margin(1.2), degradeFactor(2) {}
+  double alpha;
+  double margin;
+  int degradeFactor;
+};
+
+/**
+ * @brief 一帧的处理结果
+ */
+enum FrameOutcome {
+  kFrameRotated,   // 完整分辨率旋转
+  kFrameDegraded,  // 缩小 degradeFactor 倍旋转，再最近邻放大回原尺寸
+  kFrameDropped,   // 来不及，直接跳过，out 保持原样
+  kFrameOutcomeCount
+};
+
+const char *FrameOutcomeName(FrameOutcome outcome);
+
+/**
+ * ========== 按截止时间处理帧的调度器 ==========
+ * 实时视频里错过显示时间的帧没有意义，与其全部按顺序处理，不如在负载突增时丢掉或降级。
+ * 每帧带一个截止时间，调度器用最近几帧的实测耗时（按像素折算的 EWMA，包含传输）
+ * 预测完成时间：
+ *  - 完整路径来得及：正常旋转
+ *  - 只有降级路径来得及：源图按 degradeFactor 抽样缩小后旋转，再最近邻放大写回 out，
+ *    kernel 和传输的数据量都降到 1/degradeFactor^2
+ *  - 都来不及（或截止时间已过）：丢帧
+ * 还没有实测数据时按完整路径执行一次，用来建立估计；降级和丢帧时估计会逐渐回落，
+ * 负载恢复后重新回到完整路径。
+ * 与 RotateEngine 一样不是线程安全的，由一个线程按帧顺序调用。
+ */
+class DeadlineScheduler {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  DeadlineScheduler(RotateEngine *engine, const DeadlineOptions &options);
+
+  /**
+   * @brief 在 deadline 之前处理一帧，参数与 RotateEngine::RotateStrided 相同
+   * @param outcome 可以为 NULL
+   * @return 丢帧时返回 CL_SUCCESS，out 不变；尺寸或行跨度无效时返回 CL_INVALID_VALUE
+   */
+  cl_int Process(const int *in, int inPitch, int *out, int outPitch, int w,
+                 int h, float sinTheta, float cosTheta,
+                 Clock::time_point deadline, FrameOutcome *outcome);
+
+  /**
+   * @brief 打印各结果的帧数、实际超时的帧数以及当前的耗时估计
+   */
+  void PrintStats(std::ostream &os) const;
+
+ private:
+  // engineSeconds 返回其中引擎旋转（不含 host 端缩放）的耗时
+  cl_int RotateDegraded(const int *in, int inPitch, int *out, int outPitch,
+                        int w, int h, float sinTheta, float cosTheta,
+                        double *engineSeconds);
+  void Observe(double *estimate, double seconds, size_t pixels);
+
+  RotateEngine *engine_;
+  DeadlineOptions options_;
+
+  // 每像素耗时（秒）的 EWMA，0 表示还没有样本
+  double fullCost_;
+  double degradedCost_;
+
+  // 降级路径的暂存：缩小后的源图和旋转结果
+  std::vector<int> smallIn_;
+  std::vector<int> smallOut_;
+
+  uint64_t outcomes_[kFrameOutcomeCount];
+  uint64_t late_;  // 执行了但仍然晚于截止时间的帧
+};
+
+#endif  // OPENCL_EXAMPLE_ROTATE_DEADLINE_H_
@@ -0,0 +1,1916 @@
+#include "rotate_engine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "rotate_angle.h"
+#include "rotate_image.h"
+#include "rotate_metrics.h"
+#include "rotate_trace.h"
+
+/**
+ * @brief 从 profiling event 中取出 kernel 执行时间并记录到指标中
+ * @return kernel 执行时间（纳秒），取不到时返回 0
+ */
+static cl_ulong RecordKernelTime(cl_event event) {
+  cl_ulong start = 0;
+  cl_ulong end = 0;
+  if (clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START,
+                              sizeof(start), &start, NULL) == CL_SUCCESS &&
+      clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(end),
+                              &end, NULL) == CL_SUCCESS &&
+      end >= start) {
+    Metrics().kernelSeconds.Observe((end - start) * 1e-9);
+    return end - start;
+  }
+  return 0;
+}
+
+/**
+ * @brief 在设备 buffer 和 host 内存之间搬运 rows 行，每行 rowBytes 字节
+ * @note buffer 中从第 firstRow 行开始，行跨度为 bufferPitch；host 的行跨度为 hostPitch。
+ *       两边都紧密排列时用普通的 clEnqueueWrite/ReadBuffer，否则用 *Rect 版本，
+ *       只搬运每行有效的部分，host 行尾的填充不会被读回覆盖
+ */
+static cl_int EnqueueRows(cl_command_queue queue, cl_mem buffer, bool write,
+                          size_t bufferPitch, size_t firstRow, void *host,
+                          size_t hostPitch, size_t rowBytes, int rows,
+                          cl_bool blocking) {
+  if (bufferPitch == rowBytes && hostPitch == rowBytes) {
+    size_t offset = firstRow * rowBytes;
+    size_t bytes = rowBytes * rows;
+    return write ? clEnqueueWriteBuffer(queue, buffer, blocking, offset, bytes,
+                                        host, 0, NULL, NULL)
+                 : clEnqueueReadBuffer(queue, buffer, blocking, offset, bytes,
+                                       host, 0, NULL, NULL);
+  }
+  size_t bufferOrigin[3] = {0, firstRow, 0};
+  size_t hostOrigin[3] = {0, 0, 0};
+  size_t region[3] = {rowBytes, (size_t)rows, 1};
+  return write ? clEnqueueWriteBufferRect(queue, buffer, blocking, bufferOrigin,
+                                          hostOrigin, region, bufferPitch, 0,
+                                          hostPitch, 0, host, 0, NULL, NULL)
+               : clEnqueueReadBufferRect(queue, buffer, blocking, bufferOrigin,
+                                         hostOrigin, region, bufferPitch, 0,
+                                         hostPitch, 0, host, 0, NULL, NULL);
+}
+
+RotateEngine::RotateEngine()
+    : platform_(NULL),
+      device_(NULL),
+      context_(NULL),
+      program_(NULL),
+      kernel_(NULL),
+      yuvKernel_(NULL),
+      tiledKernel_(NULL),
+      bandKernel_(NULL),
+      packedKernel_(NULL),
+      resampleKernel_(NULL),
+      packedArgs_(false),
+      queue_(NULL),
+      bulkQueue_(NULL),
+      bandQueue_(NULL),
+      priorityHints_(false),
+      buildPending_(false),
+      buildSeconds_(0),
+      buildThreads_(0),
+      quiet_(false),
+      resampleWeights_(NULL),
+      resampleWeightsBytes_(0),
+      resampleSampling_(-1),
+      resampleSin_(0),
+      resampleCos_(1),
+      lastKernelNanos_(0),
+      background_(0),
+      svmCaps_(0),
+      transferIn_(NULL),
+      transferOut_(NULL),
+      transferBytes_(0),
+      stageIn_(NULL),
+      stageOut_(NULL),
+      stageInPtr_(NULL),
+      stageOutPtr_(NULL),
+      stageBytes_(0) {
+  for (int i = 0; i < kRotateVariantCount; i++) {
+    variantBuilds_[i] = -1;
+    variantReady_[i] = false;
+  }
+}
+
+const char *RotateVariantName(RotateVariant variant) {
+  switch (variant) {
+    case kVariantCore:
+      return "core";
+    case kVariantBatch:
+      return "batch";
+    case kVariantLayout:
+      return "layout";
+    case kVariantYuv:
+      return "yuv";
+    case kVariantResample:
+      return "resample";
+    default:
+      return "unknown";
+  }
+}
+
+RotateEngine::~RotateEngine() { Release(); }
+
+cl_int RotateEngine::Init(const std::string &kernelPath,
+                          cl_device_type deviceType) {
+  cl_int status = BeginInit(kernelPath, deviceType);
+  if (status != CL_SUCCESS) {
+    return status;
+  }
+  return FinishInit();
+}
+
+cl_int RotateEngine::BeginInit(const std::string &kernelPath,
+                               cl_device_type deviceType) {
+  /*********************************** 查询并选择一个Platform ************************************/
+  // 1.1 获取系统中所有的Platform
+  cl_int status = 0;
+  cl_uint numPlatforms = 0;
+  status = clGetPlatformIDs(0, NULL, &numPlatforms);
+  if (status != CL_SUCCESS || numPlatforms == 0) {
+    if (!quiet_) {
+      std::cout << "clGetPlatformIDs failed (1)" << std::endl;
+    }
+    return status != CL_SUCCESS ? status : CL_DEVICE_NOT_FOUND;
+  }
+  std::vector<cl_platform_id> platforms(numPlatforms);
+  status = clGetPlatformIDs(numPlatforms, platforms.data(), NULL);
+  if (status != CL_SUCCESS) {
+    if (!quiet_) {
+      std::cout << "clGetPlatformIDs failed (2)" << std::endl;
+    }
+    return status;
+  }
+
+  // 1.2 选择第一个拥有指定类型设备的Platform
+  for (cl_uint i = 0; i < numPlatforms && device_ == NULL; ++i) {
+    cl_device_id device = NULL;
+    if (clGetDeviceIDs(platforms[i], deviceType, 1, &device, NULL) ==
+        CL_SUCCESS) {
+      platform_ = platforms[i];
+      device_ = device;
+    }
+  }
+  if (device_ == NULL) {
+    if (!quiet_) {
+      std::cout << "No OpenCL device of the requested type." << std::endl;
+    }
+    return CL_DEVICE_NOT_FOUND;
+  }
+  char pbuff[100];
+  clGetPlatformInfo(platform_, CL_PLATFORM_VENDOR, sizeof(pbuff), pbuff, NULL);
+  if (!quiet_) {
+    std::cout << "Platform vendor: " << pbuff << std::endl;
+  }
+
+  /*********************************** 在Platform上创建一个Context ************************************/
+  cl_context_properties cps[3] = {CL_CONTEXT_PLATFORM,
+                                  (cl_context_properties)platform_, 0};
+  {
+    ROTATE_TRACE_SCOPE("clCreateContext");
+    context_ = clCreateContext(cps, 1, &device_, NULL, NULL, &status);
+  }
+  if (status != CL_SUCCESS) {
+    if (!quiet_) {
+      std::cout << "clCreateContext failed." << std::endl;
+    }
+    return status;
+  }
+
+  /************************************* Running Time **********************************/
+  // 4.1. 加载OpenCL内核程序并创建一个Program对象
+  std::ifstream kernelFile(kernelPath.c_str(), std::ios::in);
+  if (!kernelFile.is_open()) {
+    if (!quiet_) {
+      std::cout << "Failed to open kernel file: " << kernelPath << std::endl;
+    }
+    return CL_INVALID_VALUE;
+  }
+  std::stringstream ss;
+  ss << kernelFile.rdbuf();
+  std::string kernelSource = ss.str();
+  if (buildThreads_ > 0) {
+    // 拆分编译：每个变体一个 program，core 优先，其余在后台按提交顺序编译
+    builder_.reset(new ProgramBuilder(buildThreads_));
+    for (int i = 0; i < kRotateVariantCount; i++) {
+      BuildJob job;
+      job.context = context_;
+      job.device = device_;
+      job.name = RotateVariantName((RotateVariant)i);
+      job.source = kernelSource;
+      job.options = "-DROTATE_VARIANT=" + std::to_string(i);
+      job.priority = i == kVariantCore ? 0 : 1;
+      job.quiet = quiet_;
+      variantBuilds_[i] = builder_->Submit(job);
+    }
+    return CL_SUCCESS;
+  }
+  const char *kernelSourceCStr = kernelSource.c_str();
+  program_ = clCreateProgramWithSource(context_, 1, &kernelSourceCStr, NULL,
+                                       &status);
+  if (status != CL_SUCCESS) {
+    if (!quiet_) {
+      std::cout << "clCreateProgramWithSource failed." << std::endl;
+    }
+    return status;
+  }
+  // 4.2. 为指定的device编译Program中的kernel：传入 pfn_notify 后 clBuildProgram
+  //      可以立即返回，编译完成时由驱动回调 BuildNotify
+  Metrics().buildCacheMisses.Add();
+  {
+    std::lock_guard<std::mutex> lock(buildMutex_);
+    buildPending_ = true;
+    buildStart_ = std::chrono::steady_clock::now();
+  }
+  {
+    ROTATE_TRACE_SCOPE("clBuildProgram");
+    status = clBuildProgram(program_, 1, &device_, NULL, BuildNotify, this);
+  }
+  if (status != CL_SUCCESS) {
+    // 同步返回错误时不会再有回调；编译失败留给 FinishInit 带着日志报告
+    MarkBuildFinished();
+    if (status != CL_BUILD_PROGRAM_FAILURE) {
+      if (!quiet_) {
+        std::cout << "clBuildProgram failed." << std::endl;
+      }
+      return status;
+    }
+  }
+  return CL_SUCCESS;
+}
+
+void CL_CALLBACK RotateEngine::BuildNotify(cl_program /* program */,
+                                           void *userData) {
+  static_cast<RotateEngine *>(userData)->MarkBuildFinished();
+}
+
+void RotateEngine::MarkBuildFinished() {
+  std::lock_guard<std::mutex> lock(buildMutex_);
+  if (buildPending_) {
+    buildPending_ = false;
+    buildEnd_ = std::chrono::steady_clock::now();
+  }
+  buildDone_.notify_all();
+}
+
+void RotateEngine::WaitForBuild() {
+  std::unique_lock<std::mutex> lock(buildMutex_);
+  buildDone_.wait(lock, [this] { return !buildPending_; });
+}
+
+bool RotateEngine::buildFinished() {
+  std::lock_guard<std::mutex> lock(buildMutex_);
+  return !buildPending_;
+}
+
+void RotateEngine::CaptureBuildLog() {
+  buildLog_.clear();
+  size_t size = 0;
+  if (clGetProgramBuildInfo(program_, device_, CL_PROGRAM_BUILD_LOG, 0, NULL,
+                            &size) != CL_SUCCESS ||
+      size <= 1) {
+    return;
+  }
+  buildLog_.resize(size);
+  if (clGetProgramBuildInfo(program_, device_, CL_PROGRAM_BUILD_LOG, size,
+                            &buildLog_[0], NULL) != CL_SUCCESS) {
+    buildLog_.clear();
+    return;
+  }
+  buildLog_.resize(strlen(buildLog_.c_str()));
+  // 只有空白（有的驱动成功时返回 "\n"）按没有日志处理
+  if (buildLog_.find_first_not_of(" \t\r\n") == std::string::npos) {
+    buildLog_.clear();
+  }
+}
+
+cl_int RotateEngine::FinishInit() {
+  if (builder_) {
+    cl_int status = CL_SUCCESS;
+    {
+      ROTATE_TRACE_SCOPE("RotateEngine::WaitForBuild");
+      program_ = builder_->Wait(variantBuilds_[kVariantCore], &status);
+    }
+    buildSeconds_ = builder_->buildSeconds(variantBuilds_[kVariantCore]);
+    buildLog_ = builder_->buildLog(variantBuilds_[kVariantCore]);
+    if (status != CL_SUCCESS) {
+      program_ = NULL;
+      return status;
+    }
+    // program() 交给调用方使用，引擎自己也持有一份引用
+    clRetainProgram(program_);
+    status = CreateVariantKernels(kVariantCore, program_);
+    if (status != CL_SUCCESS) {
+      return status;
+    }
+    return FinishDeviceSetup();
+  }
+  if (program_ == NULL) {
+    return CL_INVALID_PROGRAM;
+  }
+  {
+    ROTATE_TRACE_SCOPE("RotateEngine::WaitForBuild");
+    WaitForBuild();
+  }
+  buildSeconds_ =
+      std::chrono::duration<double>(buildEnd_ - buildStart_).count();
+  Metrics().buildSeconds.Observe(buildSeconds_);
+  CaptureBuildLog();
+  cl_build_status buildStatus = CL_BUILD_ERROR;
+  cl_int status =
+      clGetProgramBuildInfo(program_, device_, CL_PROGRAM_BUILD_STATUS,
+                            sizeof(buildStatus), &buildStatus, NULL);
+  if (status != CL_SUCCESS || buildStatus != CL_BUILD_SUCCESS) {
+    if (!quiet_) {
+      std::cout << "clBuildProgram failed." << std::endl;
+      if (!buildLog_.empty()) {
+        std::cout << "Build log:" << std::endl << buildLog_ << std::endl;
+      }
+    }
+    Metrics().buildFailures.Add();
+    return CL_BUILD_PROGRAM_FAILURE;
+  }
+  // 4.3. 创建指定名字的kernel对象
+  for (int i = 0; i < kRotateVariantCount; i++) {
+    status = CreateVariantKernels((RotateVariant)i, program_);
+    if (status != CL_SUCCESS) {
+      return status;
+    }
+  }
+  return FinishDeviceSetup();
+}
+
+cl_int RotateEngine::FinishDeviceSetup() {
+  // 4.5. 查询 SVM 能力，OpenCL 1.x 设备不认识这个查询，按不支持处理
+  svmCaps_ = 0;
+  if (clGetDeviceInfo(device_, CL_DEVICE_SVM_CAPABILITIES, sizeof(svmCaps_),
+                      &svmCaps_, NULL) != CL_SUCCESS) {
+    svmCaps_ = 0;
+  }
+  // 4.6. 在指定的device上创建 Command Queue，打开 profiling 以便统计 kernel 耗时
+  return CreateQueues();
+}
+
+cl_int RotateEngine::CreateVariantKernels(RotateVariant variant,
+                                          cl_program program) {
+  struct KernelSlot {
+    const char *name;
+    cl_kernel *kernel;
+    KernelArgCache *args;
+  };
+  KernelSlot slots[2] = {};
+  int count = 0;
+  switch (variant) {
+    case kVariantCore:
+      slots[count++] = {"image_rotate", &kernel_, &kernelArgs_};
+      slots[count++] = {"image_rotate_packed", &packedKernel_,
+                        &packedKernelArgs_};
+      break;
+    case kVariantBatch:
+      // 每个 priority 一个 kernel 对象，两个线程可以同时设置参数
+      slots[count++] = {"image_rotate_batch",
+                        &batch_[kPriorityInteractive].kernel,
+                        &batch_[kPriorityInteractive].args};
+      slots[count++] = {"image_rotate_batch", &batch_[kPriorityBulk].kernel,
+                        &batch_[kPriorityBulk].args};
+      break;
+    case kVariantLayout:
+      slots[count++] = {"image_rotate_tiled", &tiledKernel_, &tiledArgs_};
+      slots[count++] = {"image_rotate_band", &bandKernel_, &bandArgs_};
+      break;
+    case kVariantYuv:
+      slots[count++] = {"image_rotate_yuv", &yuvKernel_, &yuvArgs_};
+      break;
+    case kVariantResample:
+      slots[count++] = {"image_rotate_resample", &resampleKernel_,
+                        &resampleArgs_};
+      break;
+    default:
+      return CL_INVALID_VALUE;
+  }
+  for (int i = 0; i < count; i++) {
+    cl_int status = CL_SUCCESS;
+    *slots[i].kernel = clCreateKernel(program, slots[i].name, &status);
+    if (status != CL_SUCCESS) {
+      if (!quiet_) {
+        std::cout << "clCreateKernel(" << slots[i].name << ") failed."
+                  << std::endl;
+      }
+      *slots[i].kernel = NULL;
+      return status;
+    }
+    slots[i].args->Bind(*slots[i].kernel);
+  }
+  variantReady_[variant] = true;
+  return CL_SUCCESS;
+}
+
+cl_int RotateEngine::EnsureVariant(RotateVariant variant) {
+  std::lock_guard<std::mutex> lock(variantMutex_);
+  if (variantReady_[variant]) {
+    return CL_SUCCESS;
+  }
+  if (!builder_) {
+    return CL_INVALID_KERNEL;
+  }
+  ROTATE_TRACE_SCOPE("RotateEngine::EnsureVariant");
+  cl_int status = CL_SUCCESS;
+  cl_program program = builder_->Wait(variantBuilds_[variant], &status);
+  if (status != CL_SUCCESS) {
+    return status;
+  }
+  return CreateVariantKernels(variant, program);
+}
+
+void RotateEngine::PrintBuildStats(std::ostream &os) {
+  if (builder_) {
+    builder_->PrintStats(os);
+  }
+}
+
+bool RotateEngine::HasExtension(const char *name) const {
+  size_t size = 0;
+  if (device_ == NULL ||
+      clGetDeviceInfo(device_, CL_DEVICE_EXTENSIONS, 0, NULL, &size) !=
+          CL_SUCCESS ||
+      size == 0) {
+    return false;
+  }
+  std::string extensions(size, '\0');
+  if (clGetDeviceInfo(device_, CL_DEVICE_EXTENSIONS, size, &extensions[0],
+                      NULL) != CL_SUCCESS) {
+    return false;
+  }
+  extensions.resize(strlen(extensions.c_str()));
+  return (" " + extensions + " ").find(" " + std::string(name) + " ") !=
+         std::string::npos;
+}
+
+cl_int RotateEngine::CreateQueues() {
+  cl_int status = CL_SUCCESS;
+  priorityHints_ = false;
+#ifdef CL_QUEUE_PRIORITY_KHR
+  // 交互请求用高优先级 queue，后台批量用低优先级 queue，由设备在两者之间调度
+  if (HasExtension("cl_khr_priority_hints")) {
+    cl_queue_properties high[] = {CL_QUEUE_PROPERTIES,
+                                  CL_QUEUE_PROFILING_ENABLE,
+                                  CL_QUEUE_PRIORITY_KHR,
+                                  CL_QUEUE_PRIORITY_HIGH_KHR, 0};
+    cl_queue_properties low[] = {CL_QUEUE_PROPERTIES,
+                                 CL_QUEUE_PROFILING_ENABLE,
+                                 CL_QUEUE_PRIORITY_KHR,
+                                 CL_QUEUE_PRIORITY_LOW_KHR, 0};
+    queue_ = clCreateCommandQueueWithProperties(context_, device_, high,
+                                                &status);
+    if (status == CL_SUCCESS) {
+      bulkQueue_ = clCreateCommandQueueWithProperties(context_, device_, low,
+                                                      &status);
+    }
+    if (status == CL_SUCCESS) {
+      priorityHints_ = true;
+      return CL_SUCCESS;
+    }
+    if (!quiet_) {
+      std::cout << "Priority queues unavailable, using plain queues."
+                << std::endl;
+    }
+    if (queue_ != NULL) clReleaseCommandQueue(queue_);
+    queue_ = NULL;
+    bulkQueue_ = NULL;
+  }
+#endif
+  // 没有优先级提示时仍然分成两个 queue，批量请求不会排在交互请求的同一个 queue 里
+  queue_ = clCreateCommandQueue(context_, device_, CL_QUEUE_PROFILING_ENABLE,
+                                &status);
+  if (status != CL_SUCCESS) {
+    if (!quiet_) {
+      std::cout << "clCreateCommandQueue failed." << std::endl;
+    }
+    queue_ = NULL;
+    return status;
+  }
+  bulkQueue_ = clCreateCommandQueue(context_, device_,
+                                    CL_QUEUE_PROFILING_ENABLE, &status);
+  if (status != CL_SUCCESS) {
+    if (!quiet_) {
+      std::cout << "clCreateCommandQueue failed." << std::endl;
+    }
+    bulkQueue_ = NULL;
+    return status;
+  }
+  return CL_SUCCESS;
+}
+
+cl_int RotateEngine::RotateStrided(const int *in, int inPitch, int *out,
+                                   int outPitch, int w, int h, float sinTheta,
+                                   float cosTheta) {
+  if (inPitch < w || outPitch < w) {
+    std::cout << "Row pitch must not be smaller than the width." << std::endl;
+    return CL_INVALID_VALUE;
+  }
+  size_t bytes = (size_t)w * h * sizeof(int);
+  switch (transferProfile_.Select(bytes)) {
+    case kTransferPinned:
+      return RotatePinned(in, inPitch, out, outPitch, w, h, sinTheta,
+                          cosTheta);
+    case kTransferHostPtr:
+      return RotateWrapped(in, inPitch, out, outPitch, w, h, sinTheta,
+                           cosTheta);
+    case kTransferMap:
+      return RotateMapped(in, inPitch, out, outPitch, w, h, sinTheta,
+                          cosTheta);
+    default:
+      return RotatePageable(in, inPitch, out, outPitch, w, h, sinTheta,
+                            cosTheta);
+  }
+}
+
+cl_int RotateEngine::RotateYuvStrided(const unsigned char *in, int inPitch,
+                                      unsigned char *out, int outPitch, int w,
+                                      int h, YuvFormat format, float sinTheta,
+                                      float cosTheta) {
+  if (w <= 0 || h <= 0 || w % 2 != 0 || h % 2 != 0) {
+    std::cout << "YUV420 frames need an even width and height." << std::endl;
+    return CL_INVALID_IMAGE_SIZE;
+  }
+  if (inPitch < w || outPitch < w || inPitch % 2 != 0 || outPitch % 2 != 0) {
+    std::cout << "YUV420 row pitch must be even and not smaller than the width."
+              << std::endl;
+    return CL_INVALID_VALUE;
+  }
+  cl_int status = EnsureVariant(kVariantYuv);
+  if (status != CL_SUCCESS) {
+    return status;
+  }
+  size_t inBytes = YuvPitchedFrameBytes(h, inPitch);
+  size_t bytes = YuvPitchedFrameBytes(h, outPitch);
+  cl_mem inputBuffer = NULL;
+  cl_mem outputBuffer = NULL;
+  {
+    ROTATE_TRACE_SCOPE("clCreateBuffer");
+    inputBuffer =
+        clCreateBuffer(context_, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                       inBytes, (void *)in, &status);
+    if (status != CL_SUCCESS) {
+      std::cout << "clCreateBuffer failed." << std::endl;
+      return status;
+    }
+    // out 整帧上传再整帧读回，背景像素和行尾填充都保持调用方的内容
+    outputBuffer =
+        clCreateBuffer(context_, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                       bytes, out, &status);
+    if (status != CL_SUCCESS) {
+      std::cout << "clCreateBuffer failed." << std::endl;
+      clReleaseMemObject(inputBuffer);
+      return status;
+    }
+  }
+
+  cl_int widthParam = w;
+  cl_int heightParam = h;
+  cl_float sinParam = sinTheta;
+  cl_float cosParam = cosTheta;
+  cl_int semiPlanar = IsSemiPlanar(format) ? 1 : 0;
+  cl_int srcPitch = inPitch;
+  cl_int dstPitch = outPitch;
+  {
+    ROTATE_TRACE_SCOPE("clSetKernelArg");
+    status = clSetKernelArg(yuvKernel_, 0, sizeof(cl_mem), &inputBuffer);
+    status |= clSetKernelArg(yuvKernel_, 1, sizeof(cl_mem), &outputBuffer);
+    status |= yuvArgs_.Set(2, widthParam);
+    status |= yuvArgs_.Set(3, heightParam);
+    status |= yuvArgs_.Set(4, sinParam);
+    status |= yuvArgs_.Set(5, cosParam);
+    status |= yuvArgs_.Set(6, semiPlanar);
+    status |= yuvArgs_.Set(7, srcPitch);
+    status |= yuvArgs_.Set(8, dstPitch);
+  }
+  if (status != CL_SUCCESS) {
+    std::cout << "clSetKernelArg failed." << std::endl;
+    clReleaseMemObject(outputBuffer);
+    clReleaseMemObject(inputBuffer);
+    return CL_INVALID_ARG_VALUE;
+  }
+  // 全局尺寸是亮度平面，色度由左上 1/4 的 work-item 顺带处理
+  size_t globalThreads[2] = {(size_t)w, (size_t)h};
+  cl_event kernelEvent = NULL;
+  {
+    ROTATE_TRACE_SCOPE("clEnqueueNDRangeKernel");
+    status = clEnqueueNDRangeKernel(queue_, yuvKernel_, 2, NULL, globalThreads,
+                                    NULL, 0, NULL, &kernelEvent);
+  }
+  if (status != CL_SUCCESS) {
+    std::cout << "clEnqueueNDRangeKernel failed." << std::endl;
+  } else {
+    ROTATE_TRACE_SCOPE("clEnqueueReadBuffer");
+    status = clEnqueueReadBuffer(queue_, outputBuffer, CL_TRUE, 0, bytes, out,
+                                 0, NULL, NULL);
+    if (status != CL_SUCCESS) {
+      std::cout << "clEnqueueReadBuffer failed." << std::endl;
+    }
+  }
+  if (status == CL_SUCCESS) {
+    lastKernelNanos_ = RecordKernelTime(kernelEvent);
+    Metrics().frames.Add();
+    Metrics().batchSize.Observe(1);
+    Metrics().bytesHostToDevice.Add(inBytes + bytes);
+    Metrics().bytesDeviceToHost.Add(bytes);
+  }
+  if (kernelEvent != NULL) clReleaseEvent(kernelEvent);
+  clReleaseMemObject(outputBuffer);
+  clReleaseMemObject(inputBuffer);
+  return status;
+}
+
+cl_int RotateEngine::UseTransferProfile(const std::string &path) {
+  TransferProfile profile;
+  if (!LoadTransferProfile(path, &profile)) {
+    return CL_INVALID_VALUE;
+  }
+  char deviceName[256] = {0};
+  clGetDeviceInfo(device_, CL_DEVICE_NAME, sizeof(deviceName) - 1, deviceName,
+                  NULL);
+  if (profile.deviceName != deviceName) {
+    std::cout << "Transfer profile is for \"" << profile.deviceName
+              << "\", not \"" << deviceName << "\"; ignored." << std::endl;
+    return CL_INVALID_DEVICE;
+  }
+  transferProfile_ = profile;
+  return CL_SUCCESS;
+}
+
+cl_int RotateEngine::RotatePageable(const int *in, int inPitch, int *out,
+                                    int outPitch, int w, int h, float sinTheta,
+                                    float cosTheta) {
+  cl_int status = CL_SUCCESS;
+  size_t inBytes = StridedBytes(w, h, inPitch, sizeof(int));
+  size_t bytes = StridedBytes(w, h, outPitch, sizeof(int));
+  // 4.4. 为kernel创建内存对象
+  cl_mem inputBuffer = NULL;
+  cl_mem outputBuffer = NULL;
+  {
+    ROTATE_TRACE_SCOPE("clCreateBuffer");
+    inputBuffer =
+        clCreateBuffer(context_, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                       inBytes, (void *)in, &status);
+    if (status != CL_SUCCESS) {
+      std::cout << "clCreateBuffer failed." << std::endl;
+      return status;
+    }
+    outputBuffer =
+        clCreateBuffer(context_, CL_MEM_READ_WRITE, bytes, NULL, &status);
+    if (status != CL_SUCCESS) {
+      std::cout << "clCreateBuffer failed." << std::endl;
+      clReleaseMemObject(inputBuffer);
+      return status;
+    }
+  }
+
+  status = FillBackground(outputBuffer, bytes, w, h, sinTheta, cosTheta);
+  if (status == CL_SUCCESS) {
+    status = SetArgsAndRun(inputBuffer, inPitch, outputBuffer, outPitch, w, h,
+                           sinTheta, cosTheta);
+  }
+  // 4.8. 读取kernel执行结果，返回给host
+  if (status == CL_SUCCESS) {
+    ROTATE_TRACE_SCOPE("clEnqueueReadBuffer");
+    size_t pitchBytes = (size_t)outPitch * sizeof(int);
+    status = EnqueueRows(queue_, outputBuffer, false, pitchBytes, 0, out,
+                         pitchBytes, (size_t)w * sizeof(int), h, CL_TRUE);
+    if (status != CL_SUCCESS) {
+      std::cout << "clEnqueueReadBuffer failed." << std::endl;
+    }
+  }
+  if (status == CL_SUCCESS) {
+    Metrics().frames.Add();
+    Metrics().batchSize.Observe(1);
+    Metrics().bytesHostToDevice.Add(inBytes);
+    Metrics().bytesDeviceToHost.Add(bytes);
+  }
+  clReleaseMemObject(outputBuffer);
+  clReleaseMemObject(inputBuffer);
+  return status;
+}
+
+cl_int RotateEngine::FillBackground(cl_mem out, size_t bytes, int w, int h,
+                                    float sinTheta, float cosTheta,
+                                    cl_command_queue queue) {
+  if (RotationCoversOutput(w, h, sinTheta, cosTheta)) {
+    return CL_SUCCESS;
+  }
+  ROTATE_TRACE_SCOPE("clEnqueueFillBuffer");
+  cl_int status = clEnqueueFillBuffer(queue != NULL ? queue : queue_, out,
+                                      &background_,
+                                      sizeof(background_), 0, bytes, 0, NULL,
+                                      NULL);
+  if (status != CL_SUCCESS) {
+    std::cout << "clEnqueueFillBuffer failed." << std::endl;
+  }
+  return status;
+}
+
+cl_int RotateEngine::EnsureTransferBuffers(size_t bytes, bool pinned) {
+  bool hit = transferIn_ != NULL && transferBytes_ >= bytes &&
+             (!pinned || (stageIn_ != NULL && stageBytes_ >= bytes));
+  if (hit) {
+    Metrics().bufferPoolHits.Add();
+    return CL_SUCCESS;
+  }
+  Metrics().bufferPoolMisses.Add();
+  ReleaseTransferBuffers();
+
+  ROTATE_TRACE_SCOPE("clCreateBuffer");
+  cl_int status = CL_SUCCESS;
+  transferIn_ =
+      clCreateBuffer(context_, CL_MEM_READ_WRITE, bytes, NULL, &status);
+  if (status == CL_SUCCESS) {
+    transferOut_ =
+        clCreateBuffer(context_, CL_MEM_READ_WRITE, bytes, NULL, &status);
+  }
+  if (status != CL_SUCCESS) {
+    std::cout << "clCreateBuffer failed." << std::endl;
+    ReleaseTransferBuffers();
+    return status;
+  }
+  transferBytes_ = bytes;
+  if (!pinned) {
+    return CL_SUCCESS;
+  }
+
+  // 锁页暂存区：CL_MEM_ALLOC_HOST_PTR 由驱动分配（通常是 pinned 内存），保持映射状态，
+  // 映射出的指针作为 clEnqueueWrite/ReadBuffer 的 host 端，DMA 不需要驱动再中转
+  stageIn_ = clCreateBuffer(context_, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR,
+                            bytes, NULL, &status);
+  if (status == CL_SUCCESS) {
+    stageOut_ = clCreateBuffer(
+        context_, CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR, bytes, NULL,
+        &status);
+  }
+  if (status == CL_SUCCESS) {
+    stageInPtr_ = clEnqueueMapBuffer(queue_, stageIn_, CL_TRUE, CL_MAP_WRITE,
+                                     0, bytes, 0, NULL, NULL, &status);
+  }
+  if (status == CL_SUCCESS) {
+    stageOutPtr_ = clEnqueueMapBuffer(queue_, stageOut_, CL_TRUE, CL_MAP_READ,
+                                      0, bytes, 0, NULL, NULL, &status);
+  }
+  if (status != CL_SUCCESS) {
+    std::cout << "Pinned staging buffer setup failed." << std::endl;
+    ReleaseTransferBuffers();
+    return status;
+  }
+  stageBytes_ = bytes;
+  return CL_SUCCESS;
+}
+
+void RotateEngine::ReleaseTransferBuffers() {
+  if (stageInPtr_ != NULL) {
+    clEnqueueUnmapMemObject(queue_, stageIn_, stageInPtr_, 0, NULL, NULL);
+  }
+  if (stageOutPtr_ != NULL) {
+    clEnqueueUnmapMemObject(queue_, stageOut_, stageOutPtr_, 0, NULL, NULL);
+  }
+  if (stageInPtr_ != NULL || stageOutPtr_ != NULL) {
+    clFinish(queue_);
+  }
+  if (stageIn_ != NULL) clReleaseMemObject(stageIn_);
+  if (stageOut_ != NULL) clReleaseMemObject(stageOut_);
+  if (transferIn_ != NULL) clReleaseMemObject(transferIn_);
+  if (transferOut_ != NULL) clReleaseMemObject(transferOut_);
+  stageIn_ = NULL;
+  stageOut_ = NULL;
+  stageInPtr_ = NULL;
+  stageOutPtr_ = NULL;
+  stageBytes_ = 0;
+  transferIn_ = NULL;
+  transferOut_ = NULL;
+  transferBytes_ = 0;
+}
+
+cl_int RotateEngine::RotatePinned(const int *in, int inPitch, int *out,
+                                  int outPitch, int w, int h, float sinTheta,
+                                  float cosTheta) {
+  size_t inBytes = StridedBytes(w, h, inPitch, sizeof(int));
+  size_t bytes = StridedBytes(w, h, outPitch, sizeof(int));
+  cl_int status = EnsureTransferBuffers(std::max(inBytes, bytes), true);
+  if (status != CL_SUCCESS) {
+    return status;
+  }
+  memcpy(stageInPtr_, in, inBytes);
+  {
+    ROTATE_TRACE_SCOPE("clEnqueueWriteBuffer");
+    status = clEnqueueWriteBuffer(queue_, transferIn_, CL_FALSE, 0, inBytes,
+                                  stageInPtr_, 0, NULL, NULL);
+  }
+  if (status != CL_SUCCESS) {
+    std::cout << "clEnqueueWriteBuffer failed." << std::endl;
+    clFinish(queue_);
+    return status;
+  }
+  // 与上面的非阻塞上传一起排队，host 不等待
+  status = FillBackground(transferOut_, bytes, w, h, sinTheta, cosTheta);
+  if (status != CL_SUCCESS) {
+    clFinish(queue_);
+    return status;
+  }
+  status = SetArgsAndRun(transferIn_, inPitch, transferOut_, outPitch, w, h,
+                         sinTheta, cosTheta);
+  if (status != CL_SUCCESS) {
+    return status;
+  }
+  {
+    ROTATE_TRACE_SCOPE("clEnqueueReadBuffer");
+    status = clEnqueueReadBuffer(queue_, transferOut_, CL_TRUE, 0, bytes,
+                                 stageOutPtr_, 0, NULL, NULL);
+  }
+  if (status != CL_SUCCESS) {
+    std::cout << "clEnqueueReadBuffer failed." << std::endl;
+    return status;
+  }
+  CopyRows(out, (size_t)outPitch * sizeof(int), stageOutPtr_,
+           (size_t)outPitch * sizeof(int), (size_t)w * sizeof(int), h);
+  Metrics().frames.Add();
+  Metrics().batchSize.Observe(1);
+  Metrics().bytesHostToDevice.Add(inBytes);
+  Metrics().bytesDeviceToHost.Add(bytes);
+  return CL_SUCCESS;
+}
+
+cl_int RotateEngine::RotateWrapped(const int *in, int inPitch, int *out,
+                                   int outPitch, int w, int h, float sinTheta,
+                                   float cosTheta) {
+  size_t inBytes = StridedBytes(w, h, inPitch, sizeof(int));
+  size_t bytes = StridedBytes(w, h, outPitch, sizeof(int));
+  cl_int status = CL_SUCCESS;
+  // out 就是设备内存：带行跨度时整块填充会改写行尾的填充字节，只能逐行在 host 上填
+  bool hostFill =
+      outPitch != w && !RotationCoversOutput(w, h, sinTheta, cosTheta);
+  for (int y = 0; hostFill && y < h; y++) {
+    std::fill_n(out + (size_t)y * outPitch, w, background_);
+  }
+  cl_mem inputBuffer =
+      CreateHostPtrBuffer((void *)in, inBytes, CL_MEM_READ_ONLY, &status);
+  if (status != CL_SUCCESS) {
+    return status;
+  }
+  cl_mem outputBuffer =
+      CreateHostPtrBuffer(out, bytes, CL_MEM_READ_WRITE, &status);
+  if (status != CL_SUCCESS) {
+    clReleaseMemObject(inputBuffer);
+    return status;
+  }
+  // 逐行在 host 上填过背景时把它同步到设备，否则在设备上整块填充
+  status = RotateHostPtr(inputBuffer, inPitch, outputBuffer, outPitch, w, h,
+                         sinTheta, cosTheta, !hostFill);
+  clReleaseMemObject(outputBuffer);
+  clReleaseMemObject(inputBuffer);
+  return status;
+}
+
+cl_int RotateEngine::RotateMapped(const int *in, int inPitch, int *out,
+                                  int outPitch, int w, int h, float sinTheta,
+                                  float cosTheta) {
+  size_t inBytes = StridedBytes(w, h, inPitch, sizeof(int));
+  size_t bytes = StridedBytes(w, h, outPitch, sizeof(int));
+  cl_int status = EnsureTransferBuffers(std::max(inBytes, bytes), false);
+  if (status != CL_SUCCESS) {
+    return status;
+  }
+  // 先把输出填充排进队列，设备填充时 host 正在往映射的输入里拷贝
+  status = FillBackground(transferOut_, bytes, w, h, sinTheta, cosTheta);
+  if (status != CL_SUCCESS) {
+    return status;
+  }
+  void *mapped = NULL;
+  {
+    ROTATE_TRACE_SCOPE("clEnqueueMapBuffer(in)");
+    mapped = clEnqueueMapBuffer(queue_, transferIn_, CL_TRUE, CL_MAP_WRITE, 0,
+                                inBytes, 0, NULL, NULL, &status);
+    if (status != CL_SUCCESS) {
+      std::cout << "clEnqueueMapBuffer failed." << std::endl;
+      return status;
+    }
+    memcpy(mapped, in, inBytes);
+    clEnqueueUnmapMemObject(queue_, transferIn_, mapped, 0, NULL, NULL);
+  }
+  status = SetArgsAndRun(transferIn_, inPitch, transferOut_, outPitch, w, h,
+                         sinTheta, cosTheta);
+  if (status != CL_SUCCESS) {
+    return status;
+  }
+  ROTATE_TRACE_SCOPE("clEnqueueMapBuffer(out)");
+  mapped = clEnqueueMapBuffer(queue_, transferOut_, CL_TRUE, CL_MAP_READ, 0,
+                              bytes, 0, NULL, NULL, &status);
+  if (status != CL_SUCCESS) {
+    std::cout << "clEnqueueMapBuffer failed." << std::endl;
+    return status;
+  }
+  CopyRows(out, (size_t)outPitch * sizeof(int), mapped,
+           (size_t)outPitch * sizeof(int), (size_t)w * sizeof(int), h);
+  status = clEnqueueUnmapMemObject(queue_, transferOut_, mapped, 0, NULL, NULL);
+  if (status != CL_SUCCESS) {
+    std::cout << "clEnqueueUnmapMemObject failed." << std::endl;
+    return status;
+  }
+  Metrics().frames.Add();
+  Metrics().batchSize.Observe(1);
+  Metrics().bytesHostToDevice.Add(inBytes);
+  Metrics().bytesDeviceToHost.Add(bytes);
+  return CL_SUCCESS;
+}
+
+cl_mem RotateEngine::CreateHostPtrBuffer(void *ptr, size_t bytes,
+                                         cl_mem_flags flags, cl_int *status) {
+  cl_mem buffer =
+      clCreateBuffer(context_, flags | CL_MEM_USE_HOST_PTR, bytes, ptr, status);
+  if (*status != CL_SUCCESS) {
+    std::cout << "clCreateBuffer(CL_MEM_USE_HOST_PTR) failed." << std::endl;
+    return NULL;
+  }
+  return buffer;
+}
+
+cl_int RotateEngine::RotateHostPtr(cl_mem in, int inPitch, cl_mem out,
+                                   int outPitch, int w, int h, float sinTheta,
+                                   float cosTheta, bool fillBackground) {
+  cl_int status = CL_SUCCESS;
+  size_t inBytes = StridedBytes(w, h, inPitch, sizeof(int));
+  size_t bytes = StridedBytes(w, h, outPitch, sizeof(int));
+  /**
+   * CL_MEM_USE_HOST_PTR 的内存对象允许实现缓存一份设备端副本。
+   * host 在两次 kernel 之间改写了输入，需要 map/unmap 一次通知运行时同步；
+   * 与 host 共享内存的设备（集显、CPU）上这是零拷贝的。
+   * 用 CL_MAP_WRITE_INVALIDATE_REGION：CL_MAP_WRITE 允许 map 时先把设备端的旧副本
+   * 写回 host 指针，会覆盖 host 刚写入的新内容。
+   */
+  void *mapped = NULL;
+  {
+    ROTATE_TRACE_SCOPE("clEnqueueMapBuffer(in)");
+    mapped = clEnqueueMapBuffer(queue_, in, CL_TRUE,
+                                CL_MAP_WRITE_INVALIDATE_REGION, 0, inBytes, 0,
+                                NULL, NULL, &status);
+    if (status != CL_SUCCESS) {
+      std::cout << "clEnqueueMapBuffer failed." << std::endl;
+      return status;
+    }
+    clEnqueueUnmapMemObject(queue_, in, mapped, 0, NULL, NULL);
+  }
+  // image_rotate 只写命中的像素：背景要么在设备上填充，要么是 host 上 out 原有的
+  // 内容，后者同样需要同步到设备端副本，否则空洞里是上一次结果的像素
+  if (fillBackground) {
+    status = FillBackground(out, bytes, w, h, sinTheta, cosTheta);
+    if (status != CL_SUCCESS) {
+      return status;
+    }
+  } else if (!RotationCoversOutput(w, h, sinTheta, cosTheta)) {
+    ROTATE_TRACE_SCOPE("clEnqueueMapBuffer(out)");
+    mapped = clEnqueueMapBuffer(queue_, out, CL_TRUE,
+                                CL_MAP_WRITE_INVALIDATE_REGION, 0, bytes, 0,
+                                NULL, NULL, &status);
+    if (status != CL_SUCCESS) {
+      std::cout << "clEnqueueMapBuffer failed." << std::endl;
+      return status;
+    }
+    clEnqueueUnmapMemObject(queue_, out, mapped, 0, NULL, NULL);
+  }
+
+  status = SetArgsAndRun(in, inPitch, out, outPitch, w, h, sinTheta, cosTheta);
+  if (status != CL_SUCCESS) {
+    return status;
+  }
+  // 结果通过 map 同步回 host 指针，而不是 clEnqueueReadBuffer 拷贝
+  ROTATE_TRACE_SCOPE("clEnqueueMapBuffer(out)");
+  mapped = clEnqueueMapBuffer(queue_, out, CL_TRUE, CL_MAP_READ, 0, bytes, 0,
+                              NULL, NULL, &status);
+  if (status != CL_SUCCESS) {
+    std::cout << "clEnqueueMapBuffer failed." << std::endl;
+    return status;
+  }
+  status = clEnqueueUnmapMemObject(queue_, out, mapped, 0, NULL, NULL);
+  if (status != CL_SUCCESS) {
+    std::cout << "clEnqueueUnmapMemObject failed." << std::endl;
+    return status;
+  }
+  status = clFinish(queue_);
+  if (status == CL_SUCCESS) {
+    // 零拷贝路径没有显式的上传/读回，不计入 bytes 指标
+    Metrics().frames.Add();
+    Metrics().batchSize.Observe(1);
+  }
+  return status;
+}
+
+cl_int RotateEngine::SetArgsAndRun(cl_mem in, int inPitch, cl_mem out,
+                                   int outPitch, int w, int h, float sinTheta,
+                                   float cosTheta) {
+  cl_int status = CL_SUCCESS;
+  // 4.5. 设置kernel参数
+  {
+    ROTATE_TRACE_SCOPE("clSetKernelArg");
+    status = clSetKernelArg(rotateKernel(), 0, sizeof(cl_mem), &in);
+    status |= clSetKernelArg(rotateKernel(), 1, sizeof(cl_mem), &out);
+  }
+  if (status != CL_SUCCESS) {
+    std::cout << "clSetKernelArg failed." << std::endl;
+    return CL_INVALID_ARG_VALUE;
+  }
+  return RunRotateKernel(inPitch, outPitch, w, h, sinTheta, cosTheta);
+}
+
+cl_int RotateEngine::RunRotateKernel(int inPitch, int outPitch, int w, int h,
+                                     float sinTheta, float cosTheta) {
+  cl_int status = CL_SUCCESS;
+  {
+    // 只有变化的参数才真正调用 clSetKernelArg，连续同尺寸旋转时通常只剩 sin/cos
+    ROTATE_TRACE_SCOPE("clSetKernelArg");
+    if (packedArgs_) {
+      RotateKernelParams params;
+      params.width = w;
+      params.height = h;
+      params.sinTheta = sinTheta;
+      params.cosTheta = cosTheta;
+      params.srcPitch = inPitch;
+      params.dstPitch = outPitch;
+      status = packedKernelArgs_.Set(2, params);
+    } else {
+      cl_int widthParam = w;
+      cl_int heightParam = h;
+      cl_float sinParam = sinTheta;
+      cl_float cosParam = cosTheta;
+      cl_int srcPitch = inPitch;
+      cl_int dstPitch = outPitch;
+      status = kernelArgs_.Set(2, widthParam);
+      status |= kernelArgs_.Set(3, heightParam);
+      status |= kernelArgs_.Set(4, sinParam);
+      status |= kernelArgs_.Set(5, cosParam);
+      status |= kernelArgs_.Set(6, srcPitch);
+      status |= kernelArgs_.Set(7, dstPitch);
+    }
+    if (status != CL_SUCCESS) {
+      std::cout << "clSetKernelArg failed." << std::endl;
+      return CL_INVALID_ARG_VALUE;
+    }
+  }
+  // 4.7. 将要执行的kernel加入Command Queue
+  size_t globalThreads[2] = {(size_t)w, (size_t)h};
+  cl_event kernelEvent = NULL;
+  {
+    ROTATE_TRACE_SCOPE("clEnqueueNDRangeKernel");
+    status = clEnqueueNDRangeKernel(queue_, rotateKernel(), 2, NULL,
+                                    globalThreads,
+                                    NULL, 0, NULL, &kernelEvent);
+    if (status != CL_SUCCESS) {
+      std::cout << "clEnqueueNDRangeKernel failed." << std::endl;
+      return status;
+    }
+  }
+  // 4.7.1. 确认command queue中的命令已经执行完毕
+  {
+    ROTATE_TRACE_SCOPE("clFinish");
+    status = clFinish(queue_);
+  }
+  if (status != CL_SUCCESS) {
+    std::cout << "clFinish failed." << std::endl;
+  } else {
+    lastKernelNanos_ = RecordKernelTime(kernelEvent);
+  }
+  clReleaseEvent(kernelEvent);
+  return status;
+}
+
+cl_int RotateEngine::EnsureBatchBuffers(RotatePriority priority,
+                                        size_t frames, size_t frameBytes) {
+  BatchSlot &slot = batch_[priority];
+  size_t bytes = frames * frameBytes;
+  if (slot.in != NULL && slot.bytes >= bytes && slot.frames >= frames) {
+    Metrics().bufferPoolHits.Add();
+    return CL_SUCCESS;
+  }
+  Metrics().bufferPoolMisses.Add();
+  if (slot.in != NULL) clReleaseMemObject(slot.in);
+  if (slot.out != NULL) clReleaseMemObject(slot.out);
+  if (slot.angles != NULL) clReleaseMemObject(slot.angles);
+  slot.in = NULL;
+  slot.out = NULL;
+  slot.angles = NULL;
+  slot.bytes = 0;
+  slot.frames = 0;
+
+  ROTATE_TRACE_SCOPE("clCreateBuffer");
+  cl_int status = CL_SUCCESS;
+  slot.in = clCreateBuffer(context_, CL_MEM_READ_ONLY, bytes, NULL, &status);
+  if (status != CL_SUCCESS) {
+    std::cout << "clCreateBuffer failed." << std::endl;
+    slot.in = NULL;
+    return status;
+  }
+  slot.out = clCreateBuffer(context_, CL_MEM_READ_WRITE, bytes, NULL, &status);
+  if (status != CL_SUCCESS) {
+    std::cout << "clCreateBuffer failed." << std::endl;
+    slot.out = NULL;
+    return status;
+  }
+  slot.angles = clCreateBuffer(context_, CL_MEM_READ_ONLY,
+                               frames * 2 * sizeof(cl_float), NULL, &status);
+  if (status != CL_SUCCESS) {
+    std::cout << "clCreateBuffer failed." << std::endl;
+    slot.angles = NULL;
+    return status;
+  }
+  slot.bytes = bytes;
+  slot.frames = frames;
+  return CL_SUCCESS;
+}
+
+cl_int RotateEngine::RotateBatch(const RotateJob *jobs, size_t count, int w,
+                                 int h, RotatePriority priority) {
+  if (count == 0) {
+    return CL_SUCCESS;
+  }
+  ROTATE_TRACE_SCOPE("RotateBatch");
+  if (priority < 0 || priority >= kRotatePriorityCount) {
+    return CL_INVALID_VALUE;
+  }
+  cl_command_queue queue = priority == kPriorityBulk ? bulkQueue_ : queue_;
+  BatchSlot &slot = batch_[priority];
+  size_t frameBytes = (size_t)w * h * sizeof(int);
+  cl_int status = EnsureVariant(kVariantBatch);
+  if (status == CL_SUCCESS) {
+    status = EnsureBatchBuffers(priority, count, frameBytes);
+  }
+  if (status != CL_SUCCESS) {
+    return status;
+  }
+
+  // 1. 各帧按偏移写入暂存 buffer，非阻塞入队，in-order queue 保证先于 kernel 完成。
+  //    暂存 buffer 中各帧紧密排列，带行跨度的帧在这里顺带去掉行尾填充
+  const size_t rowBytes = (size_t)w * sizeof(int);
+  std::vector<cl_float> angles(count * 2);
+  for (size_t i = 0; i < count; i++) {
+    int inPitch = jobs[i].inPitch > 0 ? jobs[i].inPitch : w;
+    int outPitch = jobs[i].outPitch > 0 ? jobs[i].outPitch : w;
+    if (inPitch < w || outPitch < w) {
+      std::cout << "Row pitch must not be smaller than the width." << std::endl;
+      clFinish(queue);
+      return CL_INVALID_VALUE;
+    }
+    ROTATE_TRACE_SCOPE("clEnqueueWriteBuffer");
+    status = EnqueueRows(queue, slot.in, true, rowBytes, i * h,
+                         (void *)jobs[i].in, inPitch * sizeof(int), rowBytes,
+                         h, CL_FALSE);
+    status |= EnqueueRows(queue, slot.out, true, rowBytes, i * h,
+                          jobs[i].out, outPitch * sizeof(int), rowBytes, h,
+                          CL_FALSE);
+    if (status != CL_SUCCESS) {
+      std::cout << "clEnqueueWriteBuffer failed." << std::endl;
+      clFinish(queue);
+      return CL_OUT_OF_RESOURCES;
+    }
+    angles[i * 2] = jobs[i].sinTheta;
+    angles[i * 2 + 1] = jobs[i].cosTheta;
+  }
+  status = clEnqueueWriteBuffer(queue, slot.angles, CL_FALSE, 0,
+                                angles.size() * sizeof(cl_float),
+                                angles.data(), 0, NULL, NULL);
+  if (status != CL_SUCCESS) {
+    std::cout << "clEnqueueWriteBuffer failed." << std::endl;
+    clFinish(queue);
+    return status;
+  }
+
+  // 2. 一次 launch 处理整个批次
+  cl_int widthParam = w;
+  cl_int heightParam = h;
+  {
+    ROTATE_TRACE_SCOPE("clSetKernelArg");
+    status = clSetKernelArg(slot.kernel, 0, sizeof(cl_mem), &slot.in);
+    status |= clSetKernelArg(slot.kernel, 1, sizeof(cl_mem), &slot.out);
+    status |= slot.args.Set(2, widthParam);
+    status |= slot.args.Set(3, heightParam);
+    status |= clSetKernelArg(slot.kernel, 4, sizeof(cl_mem), &slot.angles);
+    status |= slot.args.Set(5, widthParam);
+    status |= slot.args.Set(6, widthParam);
+    if (status != CL_SUCCESS) {
+      std::cout << "clSetKernelArg failed." << std::endl;
+      clFinish(queue);
+      return CL_INVALID_ARG_VALUE;
+    }
+  }
+  size_t globalThreads[3] = {(size_t)w, (size_t)h, count};
+  cl_event kernelEvent = NULL;
+  {
+    ROTATE_TRACE_SCOPE("clEnqueueNDRangeKernel");
+    status = clEnqueueNDRangeKernel(queue, slot.kernel, 3, NULL,
+                                    globalThreads, NULL, 0, NULL, &kernelEvent);
+    if (status != CL_SUCCESS) {
+      std::cout << "clEnqueueNDRangeKernel failed." << std::endl;
+      clFinish(queue);
+      return status;
+    }
+  }
+
+  // 3. 把结果分发回各自的 out
+  for (size_t i = 0; i < count; i++) {
+    ROTATE_TRACE_SCOPE("clEnqueueReadBuffer");
+    int outPitch = jobs[i].outPitch > 0 ? jobs[i].outPitch : w;
+    status = EnqueueRows(queue, slot.out, false, rowBytes, i * h,
+                         jobs[i].out, outPitch * sizeof(int), rowBytes, h,
+                         CL_FALSE);
+    if (status != CL_SUCCESS) {
+      std::cout << "clEnqueueReadBuffer failed." << std::endl;
+      clFinish(queue);
+      clReleaseEvent(kernelEvent);
+      return status;
+    }
+  }
+  {
+    ROTATE_TRACE_SCOPE("clFinish");
+    status = clFinish(queue);
+  }
+  if (status != CL_SUCCESS) {
+    std::cout << "clFinish failed." << std::endl;
+  } else {
+    lastKernelNanos_ = RecordKernelTime(kernelEvent);
+    Metrics().frames.Add(count);
+    Metrics().batchSize.Observe((double)count);
+    Metrics().bytesHostToDevice.Add(2 * count * frameBytes +
+                                    angles.size() * sizeof(cl_float));
+    Metrics().bytesDeviceToHost.Add(count * frameBytes);
+  }
+  clReleaseEvent(kernelEvent);
+  return status;
+}
+
+cl_int RotateEngine::UploadTiled(const int *in, int inPitch, int w, int h,
+                                 int tile, TiledImage *image) {
+  if (w <= 0 || h <= 0 || inPitch < w || !IsValidTile(tile)) {
+    std::cout << "Invalid tiled image: " << w << "x" << h << ", pitch "
+              << inPitch << ", tile " << tile << std::endl;
+    return CL_INVALID_VALUE;
+  }
+  ReleaseTiled(image);
+  ROTATE_TRACE_SCOPE("UploadTiled");
+  std::vector<int> tiled(TiledElements(w, h, tile));
+  TileImage<int>(in, inPitch, w, h, tile, tiled.data());
+  size_t bytes = tiled.size() * sizeof(int);
+  cl_int status = CL_SUCCESS;
+  image->buffer =
+      clCreateBuffer(context_, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, bytes,
+                     tiled.data(), &status);
+  if (status != CL_SUCCESS) {
+    std::cout << "clCreateBuffer failed." << std::endl;
+    image->buffer = NULL;
+    return status;
+  }
+  image->width = w;
+  image->height = h;
+  image->tile = tile;
+  Metrics().bytesHostToDevice.Add(bytes);
+  return CL_SUCCESS;
+}
+
+void RotateEngine::ReleaseTiled(TiledImage *image) {
+  if (image->buffer != NULL) clReleaseMemObject(image->buffer);
+  *image = TiledImage();
+}
+
+cl_int RotateEngine::RotateTiled(const TiledImage &image, int *out,
+                                 int outPitch, float sinTheta,
+                                 float cosTheta) {
+  const int w = image.width;
+  const int h = image.height;
+  if (image.buffer == NULL || outPitch < w) {
+    return CL_INVALID_VALUE;
+  }
+  size_t bytes = StridedBytes(w, h, outPitch, sizeof(int));
+  cl_int status = EnsureVariant(kVariantLayout);
+  if (status == CL_SUCCESS) {
+    status = EnsureTransferBuffers(bytes, false);
+  }
+  if (status == CL_SUCCESS) {
+    status = FillBackground(transferOut_, bytes, w, h, sinTheta, cosTheta);
+  }
+  if (status != CL_SUCCESS) {
+    return status;
+  }
+  cl_int widthParam = w;
+  cl_int heightParam = h;
+  cl_float sinParam = sinTheta;
+  cl_float cosParam = cosTheta;
+  cl_int tileShift = 0;
+  while ((1 << tileShift) < image.tile) {
+    tileShift++;
+  }
+  cl_int dstPitch = outPitch;
+  {
+    ROTATE_TRACE_SCOPE("clSetKernelArg");
+    status = clSetKernelArg(tiledKernel_, 0, sizeof(cl_mem), &image.buffer);
+    status |= clSetKernelArg(tiledKernel_, 1, sizeof(cl_mem), &transferOut_);
+    status |= tiledArgs_.Set(2, widthParam);
+    status |= tiledArgs_.Set(3, heightParam);
+    status |= tiledArgs_.Set(4, sinParam);
+    status |= tiledArgs_.Set(5, cosParam);
+    status |= tiledArgs_.Set(6, tileShift);
+    status |= tiledArgs_.Set(7, dstPitch);
+    if (status != CL_SUCCESS) {
+      std::cout << "clSetKernelArg failed." << std::endl;
+      return CL_INVALID_ARG_VALUE;
+    }
+  }
+  // 一个 work-group 正好是一个 tile；设备不支持这么大的 work-group 时交给实现决定
+  size_t globalThreads[1] = {TiledElements(w, h, image.tile)};
+  size_t localThreads[1] = {(size_t)image.tile * image.tile};
+  size_t maxLocal = 0;
+  clGetKernelWorkGroupInfo(tiledKernel_, device_, CL_KERNEL_WORK_GROUP_SIZE,
+                           sizeof(maxLocal), &maxLocal, NULL);
+  cl_event kernelEvent = NULL;
+  {
+    ROTATE_TRACE_SCOPE("clEnqueueNDRangeKernel");
+    status = clEnqueueNDRangeKernel(
+        queue_, tiledKernel_, 1, NULL, globalThreads,
+        localThreads[0] <= maxLocal ? localThreads : NULL, 0, NULL,
+        &kernelEvent);
+    if (status != CL_SUCCESS) {
+      std::cout << "clEnqueueNDRangeKernel failed." << std::endl;
+      return status;
+    }
+  }
+  {
+    ROTATE_TRACE_SCOPE("clEnqueueReadBuffer");
+    size_t pitchBytes = (size_t)outPitch * sizeof(int);
+    status = EnqueueRows(queue_, transferOut_, false, pitchBytes, 0, out,
+                         pitchBytes, (size_t)w * sizeof(int), h, CL_TRUE);
+  }
+  if (status != CL_SUCCESS) {
+    std::cout << "clEnqueueReadBuffer failed." << std::endl;
+  } else {
+    lastKernelNanos_ = RecordKernelTime(kernelEvent);
+    Metrics().frames.Add();
+    Metrics().batchSize.Observe(1);
+    Metrics().bytesDeviceToHost.Add(bytes);
+  }
+  clReleaseEvent(kernelEvent);
+  return status;
+}
+
+cl_int RotateEngine::EnsureResampleWeights(RotateSampling sampling,
+                                           float sinTheta, float cosTheta) {
+  // lanczos3 的权重表与角度无关；area 与角度有关，角度变化时重新生成
+  if (resampleWeights_ != NULL && resampleSampling_ == sampling &&
+      (sampling != kSampleArea ||
+       (resampleSin_ == sinTheta && resampleCos_ == cosTheta))) {
+    return CL_SUCCESS;
+  }
+  std::vector<float> weights;
+  BuildResampleWeights(sampling, sinTheta, cosTheta, &weights);
+  // bilinear 不查表，但 constant 参数仍需要一个有效的 buffer
+  if (weights.empty()) {
+    weights.push_back(0.0f);
+  }
+  size_t bytes = weights.size() * sizeof(float);
+  cl_int status = CL_SUCCESS;
+  if (resampleWeightsBytes_ < bytes) {
+    if (resampleWeights_ != NULL) clReleaseMemObject(resampleWeights_);
+    resampleWeights_ =
+        clCreateBuffer(context_, CL_MEM_READ_ONLY, bytes, NULL, &status);
+    if (status != CL_SUCCESS) {
+      std::cout << "clCreateBuffer(resample weights) failed." << std::endl;
+      resampleWeights_ = NULL;
+      resampleWeightsBytes_ = 0;
+      resampleSampling_ = -1;
+      return status;
+    }
+    resampleWeightsBytes_ = bytes;
+  }
+  {
+    ROTATE_TRACE_SCOPE("clEnqueueWriteBuffer(weights)");
+    status = clEnqueueWriteBuffer(queue_, resampleWeights_, CL_TRUE, 0, bytes,
+                                  weights.data(), 0, NULL, NULL);
+  }
+  if (status != CL_SUCCESS) {
+    std::cout << "clEnqueueWriteBuffer failed." << std::endl;
+    resampleSampling_ = -1;
+    return status;
+  }
+  Metrics().bytesHostToDevice.Add(bytes);
+  resampleSampling_ = sampling;
+  resampleSin_ = sinTheta;
+  resampleCos_ = cosTheta;
+  return CL_SUCCESS;
+}
+
+cl_int RotateEngine::RotateResampled(const int *in, int inPitch, int *out,
+                                     int outPitch, int w, int h,
+                                     float sinTheta, float cosTheta,
+                                     RotateSampling sampling) {
+  if (w <= 0 || h <= 0 || inPitch < w || outPitch < w || sampling < 0 ||
+      sampling >= kRotateSamplingCount) {
+    return CL_INVALID_VALUE;
+  }
+  ROTATE_TRACE_SCOPE("RotateResampled");
+  size_t inBytes = StridedBytes(w, h, inPitch, sizeof(int));
+  size_t bytes = StridedBytes(w, h, outPitch, sizeof(int));
+  size_t rowBytes = (size_t)w * sizeof(int);
+  size_t inPitchBytes = (size_t)inPitch * sizeof(int);
+  size_t outPitchBytes = (size_t)outPitch * sizeof(int);
+  cl_int status = EnsureVariant(kVariantResample);
+  if (status == CL_SUCCESS) {
+    status = EnsureTransferBuffers(std::max(inBytes, bytes), false);
+  }
+  if (status == CL_SUCCESS) {
+    status = EnsureResampleWeights(sampling, sinTheta, cosTheta);
+  }
+  if (status != CL_SUCCESS) {
+    return status;
+  }
+  // 1. 非阻塞上传源图；反向映射写满每个输出像素，不需要填充背景
+  {
+    ROTATE_TRACE_SCOPE("clEnqueueWriteBuffer");
+    status = EnqueueRows(queue_, transferIn_, true, inPitchBytes, 0,
+                         (void *)in, inPitchBytes, rowBytes, h, CL_FALSE);
+  }
+  if (status != CL_SUCCESS) {
+    std::cout << "clEnqueueWriteBuffer failed." << std::endl;
+    clFinish(queue_);
+    return status;
+  }
+  cl_int widthParam = w;
+  cl_int heightParam = h;
+  cl_float sinParam = sinTheta;
+  cl_float cosParam = cosTheta;
+  cl_int srcPitch = inPitch;
+  cl_int dstPitch = outPitch;
+  cl_int mode = sampling;
+  cl_int background = background_;
+  {
+    ROTATE_TRACE_SCOPE("clSetKernelArg");
+    status = clSetKernelArg(resampleKernel_, 0, sizeof(cl_mem), &transferIn_);
+    status |= clSetKernelArg(resampleKernel_, 1, sizeof(cl_mem), &transferOut_);
+    status |= resampleArgs_.Set(2, widthParam);
+    status |= resampleArgs_.Set(3, heightParam);
+    status |= resampleArgs_.Set(4, sinParam);
+    status |= resampleArgs_.Set(5, cosParam);
+    status |= resampleArgs_.Set(6, srcPitch);
+    status |= resampleArgs_.Set(7, dstPitch);
+    status |= resampleArgs_.Set(8, mode);
+    status |= clSetKernelArg(resampleKernel_, 9, sizeof(cl_mem),
+                             &resampleWeights_);
+    status |= resampleArgs_.Set(10, background);
+    if (status != CL_SUCCESS) {
+      std::cout << "clSetKernelArg failed." << std::endl;
+      clFinish(queue_);
+      return CL_INVALID_ARG_VALUE;
+    }
+  }
+  // 2. 一个 work-item 一个输出像素
+  size_t globalThreads[2] = {(size_t)w, (size_t)h};
+  cl_event kernelEvent = NULL;
+  {
+    ROTATE_TRACE_SCOPE("clEnqueueNDRangeKernel");
+    status = clEnqueueNDRangeKernel(queue_, resampleKernel_, 2, NULL,
+                                    globalThreads, NULL, 0, NULL,
+                                    &kernelEvent);
+  }
+  if (status != CL_SUCCESS) {
+    std::cout << "clEnqueueNDRangeKernel failed." << std::endl;
+    clFinish(queue_);
+    return status;
+  }
+  // 3. 阻塞读回，只搬运每行有效的部分
+  {
+    ROTATE_TRACE_SCOPE("clEnqueueReadBuffer");
+    status = EnqueueRows(queue_, transferOut_, false, outPitchBytes, 0, out,
+                         outPitchBytes, rowBytes, h, CL_TRUE);
+  }
+  if (status != CL_SUCCESS) {
+    std::cout << "clEnqueueReadBuffer failed." << std::endl;
+  } else {
+    lastKernelNanos_ = RecordKernelTime(kernelEvent);
+    Metrics().frames.Add();
+    Metrics().batchSize.Observe(1);
+    Metrics().bytesHostToDevice.Add(inBytes);
+    Metrics().bytesDeviceToHost.Add(bytes);
+  }
+  clReleaseEvent(kernelEvent);
+  return status;
+}
+
+void *RotateEngine::AllocFrame(size_t bytes) {
+  if (!svmSupported()) {
+    void *ptr = NULL;
+    return posix_memalign(&ptr, 4096, bytes) == 0 ? ptr : NULL;
+  }
+  cl_svm_mem_flags flags = CL_MEM_READ_WRITE;
+  if (svmFineGrained()) {
+    flags |= CL_MEM_SVM_FINE_GRAIN_BUFFER;
+  }
+  void *ptr = clSVMAlloc(context_, flags, bytes, 4096);
+  if (ptr == NULL) {
+    std::cout << "clSVMAlloc failed." << std::endl;
+    return NULL;
+  }
+  if (!svmFineGrained()) {
+    // coarse-grained：平时保持映射给 host，只在 kernel 执行期间 unmap
+    cl_int status = clEnqueueSVMMap(queue_, CL_TRUE,
+                                    CL_MAP_READ | CL_MAP_WRITE, ptr, bytes, 0,
+                                    NULL, NULL);
+    if (status != CL_SUCCESS) {
+      std::cout << "clEnqueueSVMMap failed." << std::endl;
+      clSVMFree(context_, ptr);
+      return NULL;
+    }
+  }
+  return ptr;
+}
+
+void RotateEngine::FreeFrame(void *ptr) {
+  if (ptr == NULL) {
+    return;
+  }
+  if (!svmSupported()) {
+    free(ptr);
+    return;
+  }
+  if (!svmFineGrained()) {
+    clEnqueueSVMUnmap(queue_, ptr, 0, NULL, NULL);
+    clFinish(queue_);
+  }
+  clSVMFree(context_, ptr);
+}
+
+cl_int RotateEngine::RotateSvm(const int *in, int inPitch, int *out,
+                               int outPitch, int w, int h, float sinTheta,
+                               float cosTheta) {
+  if (!svmSupported()) {
+    return RotateStrided(in, inPitch, out, outPitch, w, h, sinTheta, cosTheta);
+  }
+  if (inPitch < w || outPitch < w) {
+    std::cout << "Row pitch must not be smaller than the width." << std::endl;
+    return CL_INVALID_VALUE;
+  }
+  ROTATE_TRACE_SCOPE("RotateSvm");
+  size_t outBytes = StridedBytes(w, h, outPitch, sizeof(int));
+  cl_int status = CL_SUCCESS;
+  bool coarse = !svmFineGrained();
+  // 1. coarse-grained：把 host 的写入交还给设备
+  if (coarse) {
+    status = clEnqueueSVMUnmap(queue_, (void *)in, 0, NULL, NULL);
+    status |= clEnqueueSVMUnmap(queue_, out, 0, NULL, NULL);
+    if (status != CL_SUCCESS) {
+      std::cout << "clEnqueueSVMUnmap failed." << std::endl;
+      return CL_INVALID_OPERATION;
+    }
+  }
+  // 2. 直接把 SVM 指针作为 kernel 参数，没有 cl_mem 和暂存拷贝
+  {
+    ROTATE_TRACE_SCOPE("clSetKernelArgSVMPointer");
+    status = clSetKernelArgSVMPointer(rotateKernel(), 0, in);
+    status |= clSetKernelArgSVMPointer(rotateKernel(), 1, out);
+  }
+  if (status != CL_SUCCESS) {
+    std::cout << "clSetKernelArgSVMPointer failed." << std::endl;
+    status = CL_INVALID_ARG_VALUE;
+  } else {
+    status = RunRotateKernel(inPitch, outPitch, w, h, sinTheta, cosTheta);
+  }
+  // 3. coarse-grained：无论成功与否都重新映射，保持“平时映射给 host”的约定
+  if (coarse) {
+    size_t inBytes = StridedBytes(w, h, inPitch, sizeof(int));
+    cl_int mapStatus =
+        clEnqueueSVMMap(queue_, CL_FALSE, CL_MAP_READ | CL_MAP_WRITE,
+                        (void *)in, inBytes, 0, NULL, NULL);
+    mapStatus |= clEnqueueSVMMap(queue_, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE,
+                                 out, outBytes, 0, NULL, NULL);
+    if (mapStatus != CL_SUCCESS) {
+      std::cout << "clEnqueueSVMMap failed." << std::endl;
+      if (status == CL_SUCCESS) status = CL_INVALID_OPERATION;
+    }
+  }
+  if (status == CL_SUCCESS) {
+    // 与零拷贝路径一样，没有显式的上传/读回
+    Metrics().frames.Add();
+    Metrics().batchSize.Observe(1);
+  }
+  return status;
+}
+
+void PlanRotateBands(int w, int h, float sinTheta, float cosTheta, int inPitch,
+                     int outPitch, int bands, size_t align,
+                     std::vector<RotateBand> *plan) {
+  plan->clear();
+  if (w <= 0 || h <= 0 || bands <= 0) {
+    return;
+  }
+  // 1. 条带边界只取输出行起点满足对齐的行：rowStep 行的字节数是 align 的倍数
+  size_t rowBytes = (size_t)outPitch * sizeof(int);
+  size_t a = align;
+  size_t b = rowBytes;
+  while (b != 0) {
+    size_t t = a % b;
+    a = b;
+    b = t;
+  }
+  int rowStep = (int)(align / a);
+  int bandRows = (h + bands - 1) / bands;
+  bandRows = (bandRows + rowStep - 1) / rowStep * rowStep;
+
+  const float xc = (float)(w / 2);
+  const float yc = (float)(h / 2);
+  for (int y0 = 0; y0 < h; y0 += bandRows) {
+    RotateBand band;
+    band.dstRow0 = y0;
+    band.dstRows = std::min(bandRows, h - y0);
+    // 2. 输出区域 [-1, w] x [y0-1, y0+rows] 的四角逆旋转，取源图行的范围
+    //    （kernel 中向零取整，-1 < pos < 0 的像素也会落到第 0 行/列）
+    float lo = 1e30f;
+    float hi = -1e30f;
+    const float xs[2] = {-1.0f, (float)w};
+    const float ys[2] = {(float)(y0 - 1), (float)(y0 + band.dstRows)};
+    for (int i = 0; i < 2; i++) {
+      for (int j = 0; j < 2; j++) {
+        float sy = yc - (xs[i] - xc) * sinTheta + (ys[j] - yc) * cosTheta;
+        lo = std::min(lo, sy);
+        hi = std::max(hi, sy);
+      }
+    }
+    int sy0 = std::max(0, (int)std::floor(lo) - 1);
+    int sy1 = std::min(h, (int)std::ceil(hi) + 2);
+    band.srcRow0 = std::min(sy0, h - 1);
+    band.srcRows = std::max(1, sy1 - band.srcRow0);
+
+    // 3. sub-buffer 起点向下对齐，剩下的偏移交给 kernel
+    size_t srcStart = (size_t)band.srcRow0 * inPitch * sizeof(int);
+    band.srcOrigin = srcStart / align * align;
+    band.srcBase = (int)((srcStart - band.srcOrigin) / sizeof(int));
+    band.srcSize = srcStart - band.srcOrigin +
+                   StridedBytes(w, band.srcRows, inPitch, sizeof(int));
+    size_t dstStart = (size_t)band.dstRow0 * rowBytes;
+    band.dstOrigin = dstStart / align * align;
+    band.dstBase = (int)((dstStart - band.dstOrigin) / sizeof(int));
+    band.dstSize = dstStart - band.dstOrigin +
+                   StridedBytes(w, band.dstRows, outPitch, sizeof(int));
+    plan->push_back(band);
+  }
+}
+
+cl_int RotateEngine::RotateBanded(const int *in, int inPitch, int *out,
+                                  int outPitch, int w, int h, float sinTheta,
+                                  float cosTheta, int bands) {
+  if (w <= 0 || h <= 0 || inPitch < w || outPitch < w || bands <= 0) {
+    return CL_INVALID_VALUE;
+  }
+  ROTATE_TRACE_SCOPE("RotateBanded");
+  cl_int variantStatus = EnsureVariant(kVariantLayout);
+  if (variantStatus != CL_SUCCESS) {
+    return variantStatus;
+  }
+  // CL_DEVICE_MEM_BASE_ADDR_ALIGN 以位为单位
+  cl_uint alignBits = 0;
+  clGetDeviceInfo(device_, CL_DEVICE_MEM_BASE_ADDR_ALIGN, sizeof(alignBits),
+                  &alignBits, NULL);
+  size_t align = std::max((size_t)alignBits / 8, sizeof(int));
+  std::vector<RotateBand> plan;
+  PlanRotateBands(w, h, sinTheta, cosTheta, inPitch, outPitch, bands, align,
+                  &plan);
+  cl_int status = CL_SUCCESS;
+  if (plan.size() > 1 && bandQueue_ == NULL) {
+    bandQueue_ = clCreateCommandQueue(context_, device_,
+                                      CL_QUEUE_PROFILING_ENABLE, &status);
+    if (status != CL_SUCCESS) {
+      // 只是少了并行，所有条带仍然可以放在 queue_ 上
+      std::cout << "clCreateCommandQueue failed, bands share one queue."
+                << std::endl;
+      bandQueue_ = NULL;
+      status = CL_SUCCESS;
+    }
+  }
+
+  // 1. 每帧一个父 buffer，源图整帧上传一次
+  size_t inBytes = StridedBytes(w, h, inPitch, sizeof(int));
+  size_t outBytes = StridedBytes(w, h, outPitch, sizeof(int));
+  cl_mem parentIn =
+      clCreateBuffer(context_, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                     inBytes, (void *)in, &status);
+  if (status != CL_SUCCESS) {
+    std::cout << "clCreateBuffer failed." << std::endl;
+    return status;
+  }
+  cl_mem parentOut =
+      clCreateBuffer(context_, CL_MEM_READ_WRITE, outBytes, NULL, &status);
+  if (status != CL_SUCCESS) {
+    std::cout << "clCreateBuffer failed." << std::endl;
+    clReleaseMemObject(parentIn);
+    return status;
+  }
+
+  // 2. 各条带：sub-buffer -> 填充 -> kernel -> 非阻塞读回，条带之间互不依赖。
+  //    同一条带的命令都在同一个 in-order queue 上，奇数条带放在 bandQueue_ 上；
+  //    kernel 参数在入队时捕获，同一个 kernel 对象可以交替入队到两个 queue
+  std::vector<cl_mem> subBuffers;
+  std::vector<cl_event> events;
+  cl_int widthParam = w;
+  cl_int heightParam = h;
+  cl_float sinParam = sinTheta;
+  cl_float cosParam = cosTheta;
+  cl_int srcPitch = inPitch;
+  cl_int dstPitch = outPitch;
+  for (size_t i = 0; i < plan.size() && status == CL_SUCCESS; i++) {
+    const RotateBand &band = plan[i];
+    cl_command_queue queue =
+        (i % 2 == 1 && bandQueue_ != NULL) ? bandQueue_ : queue_;
+    cl_buffer_region srcRegion = {band.srcOrigin, band.srcSize};
+    cl_buffer_region dstRegion = {band.dstOrigin, band.dstSize};
+    cl_mem src = clCreateSubBuffer(parentIn, CL_MEM_READ_ONLY,
+                                   CL_BUFFER_CREATE_TYPE_REGION, &srcRegion,
+                                   &status);
+    if (status != CL_SUCCESS) {
+      std::cout << "clCreateSubBuffer failed." << std::endl;
+      break;
+    }
+    subBuffers.push_back(src);
+    cl_mem dst = clCreateSubBuffer(parentOut, CL_MEM_READ_WRITE,
+                                   CL_BUFFER_CREATE_TYPE_REGION, &dstRegion,
+                                   &status);
+    if (status != CL_SUCCESS) {
+      std::cout << "clCreateSubBuffer failed." << std::endl;
+      break;
+    }
+    subBuffers.push_back(dst);
+    // 每个条带只填自己的输出范围，条带之间仍然互不依赖
+    status =
+        FillBackground(dst, band.dstSize, w, h, sinTheta, cosTheta, queue);
+    if (status != CL_SUCCESS) {
+      break;
+    }
+
+    cl_int srcRow0 = band.srcRow0;
+    cl_int srcBase = band.srcBase;
+    cl_int dstRow0 = band.dstRow0;
+    cl_int dstRows = band.dstRows;
+    cl_int dstBase = band.dstBase;
+    {
+      ROTATE_TRACE_SCOPE("clSetKernelArg");
+      status = clSetKernelArg(bandKernel_, 0, sizeof(cl_mem), &src);
+      status |= clSetKernelArg(bandKernel_, 1, sizeof(cl_mem), &dst);
+      status |= bandArgs_.Set(2, widthParam);
+      status |= bandArgs_.Set(3, heightParam);
+      status |= bandArgs_.Set(4, sinParam);
+      status |= bandArgs_.Set(5, cosParam);
+      status |= bandArgs_.Set(6, srcPitch);
+      status |= bandArgs_.Set(7, dstPitch);
+      status |= bandArgs_.Set(8, srcRow0);
+      status |= bandArgs_.Set(9, srcBase);
+      status |= bandArgs_.Set(10, dstRow0);
+      status |= bandArgs_.Set(11, dstRows);
+      status |= bandArgs_.Set(12, dstBase);
+    }
+    if (status != CL_SUCCESS) {
+      std::cout << "clSetKernelArg failed." << std::endl;
+      status = CL_INVALID_ARG_VALUE;
+      break;
+    }
+    size_t globalThreads[2] = {(size_t)w, (size_t)band.srcRows};
+    cl_event kernelEvent = NULL;
+    {
+      ROTATE_TRACE_SCOPE("clEnqueueNDRangeKernel");
+      status = clEnqueueNDRangeKernel(queue, bandKernel_, 2, NULL,
+                                      globalThreads, NULL, 0, NULL,
+                                      &kernelEvent);
+    }
+    if (status != CL_SUCCESS) {
+      std::cout << "clEnqueueNDRangeKernel failed." << std::endl;
+      break;
+    }
+    events.push_back(kernelEvent);
+    {
+      // 条带边界取在对齐的行上，dstBase 总是 0，输出 sub-buffer 从第 0 行读起
+      ROTATE_TRACE_SCOPE("clEnqueueReadBuffer");
+      size_t pitchBytes = (size_t)outPitch * sizeof(int);
+      status = EnqueueRows(queue, dst, false, pitchBytes, 0,
+                           out + (size_t)band.dstRow0 * outPitch, pitchBytes,
+                           (size_t)w * sizeof(int), band.dstRows, CL_FALSE);
+    }
+    if (status != CL_SUCCESS) {
+      std::cout << "clEnqueueReadBuffer failed." << std::endl;
+      break;
+    }
+  }
+
+  // 3. bandQueue_ 上的条带以 marker 事件汇合到 queue_，等 queue_ 完成即全部完成；
+  //    然后再释放 sub-buffer，再释放父 buffer
+  bool joined = false;
+  if (status == CL_SUCCESS && plan.size() > 1 && bandQueue_ != NULL) {
+    cl_event joinEvent = NULL;
+    status = clEnqueueMarkerWithWaitList(bandQueue_, 0, NULL, &joinEvent);
+    if (status == CL_SUCCESS) {
+      status = clEnqueueBarrierWithWaitList(queue_, 1, &joinEvent, NULL);
+      clReleaseEvent(joinEvent);
+    }
+    if (status != CL_SUCCESS) {
+      std::cout << "clEnqueueBarrierWithWaitList failed." << std::endl;
+    } else {
+      joined = true;
+    }
+  }
+  if (bandQueue_ != NULL && !joined) {
+    // 出错或者只有一个条带时直接等 bandQueue_
+    clFinish(bandQueue_);
+  }
+  cl_int finishStatus = clFinish(queue_);
+  if (status == CL_SUCCESS) {
+    status = finishStatus;
+  }
+  if (status == CL_SUCCESS) {
+    cl_ulong nanos = 0;
+    for (size_t i = 0; i < events.size(); i++) {
+      nanos += RecordKernelTime(events[i]);
+    }
+    lastKernelNanos_ = nanos;
+    Metrics().frames.Add();
+    Metrics().batchSize.Observe(1);
+    Metrics().bytesHostToDevice.Add(inBytes);
+    Metrics().bytesDeviceToHost.Add(outBytes);
+  }
+  for (size_t i = 0; i < events.size(); i++) {
+    clReleaseEvent(events[i]);
+  }
+  for (size_t i = 0; i < subBuffers.size(); i++) {
+    clReleaseMemObject(subBuffers[i]);
+  }
+  clReleaseMemObject(parentOut);
+  clReleaseMemObject(parentIn);
+  return status;
+}
+
+void RotateEngine::Release() {
+  // 4.9. Cleanup：编译还没结束时驱动之后会回调 this，先等它结束
+  WaitForBuild();
+  ReleaseTransferBuffers();
+  for (int i = 0; i < kRotatePriorityCount; i++) {
+    BatchSlot &slot = batch_[i];
+    if (slot.in != NULL) clReleaseMemObject(slot.in);
+    if (slot.out != NULL) clReleaseMemObject(slot.out);
+    if (slot.angles != NULL) clReleaseMemObject(slot.angles);
+    if (slot.kernel != NULL) clReleaseKernel(slot.kernel);
+    slot.in = NULL;
+    slot.out = NULL;
+    slot.angles = NULL;
+    slot.bytes = 0;
+    slot.frames = 0;
+    slot.kernel = NULL;
+    slot.args.Bind(NULL);
+  }
+  if (resampleWeights_ != NULL) clReleaseMemObject(resampleWeights_);
+  resampleWeights_ = NULL;
+  resampleWeightsBytes_ = 0;
+  resampleSampling_ = -1;
+  if (bandQueue_ != NULL) clReleaseCommandQueue(bandQueue_);
+  if (bulkQueue_ != NULL) clReleaseCommandQueue(bulkQueue_);
+  if (queue_ != NULL) clReleaseCommandQueue(queue_);
+  if (yuvKernel_ != NULL) clReleaseKernel(yuvKernel_);
+  if (tiledKernel_ != NULL) clReleaseKernel(tiledKernel_);
+  if (bandKernel_ != NULL) clReleaseKernel(bandKernel_);
+  if (packedKernel_ != NULL) clReleaseKernel(packedKernel_);
+  if (resampleKernel_ != NULL) clReleaseKernel(resampleKernel_);
+  if (kernel_ != NULL) clReleaseKernel(kernel_);
+  if (program_ != NULL) clReleaseProgram(program_);
+  // 等待后台正在编译的变体，释放它们的 program（还没开始的直接丢弃）
+  builder_.reset();
+  for (int i = 0; i < kRotateVariantCount; i++) {
+    variantBuilds_[i] = -1;
+    variantReady_[i] = false;
+  }
+  if (context_ != NULL) clReleaseContext(context_);
+  queue_ = NULL;
+  bulkQueue_ = NULL;
+  bandQueue_ = NULL;
+  priorityHints_ = false;
+  kernel_ = NULL;
+  yuvKernel_ = NULL;
+  tiledKernel_ = NULL;
+  bandKernel_ = NULL;
+  packedKernel_ = NULL;
+  resampleKernel_ = NULL;
+  kernelArgs_.Bind(NULL);
+  yuvArgs_.Bind(NULL);
+  tiledArgs_.Bind(NULL);
+  bandArgs_.Bind(NULL);
+  packedKernelArgs_.Bind(NULL);
+  resampleArgs_.Bind(NULL);
+  program_ = NULL;
+  context_ = NULL;
+  device_ = NULL;
+  platform_ = NULL;
+  svmCaps_ = 0;
+}
@@ -0,0 +1,474 @@
+#ifndef OPENCL_EXAMPLE_ROTATE_ENGINE_H_
+#define OPENCL_EXAMPLE_ROTATE_ENGINE_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <CL/cl.h>
+
+#include "rotate_build.h"
+#include "rotate_format.h"
+#include "rotate_kernel_args.h"
+#include "rotate_resample.h"
+#include "rotate_transfer.h"
+
+/**
+ * @brief 批量旋转中的一帧，in/out 为 host 内存
+ * @note inPitch / outPitch 为行跨度（像素），0 表示紧密排列（等于 w）
+ */
+struct RotateJob {
+  RotateJob()
+      : in(NULL), out(NULL), sinTheta(0), cosTheta(1), inPitch(0), outPitch(0) {}
+  const int *in;
+  int *out;
+  float sinTheta;
+  float cosTheta;
+  int inPitch;
+  int outPitch;
+};
+
+/**
+ * @brief 请求的优先级：交互式的单帧请求和后台的大批量请求走不同的 command queue
+ */
+enum RotatePriority {
+  kPriorityInteractive = 0,
+  kPriorityBulk = 1,
+  kRotatePriorityCount
+};
+
+/**
+ * @brief rotate.cl 按用途拆成的编译变体（-DROTATE_VARIANT=n），见 SetBuildThreads
+ *  - core：单帧旋转（image_rotate、image_rotate_packed），第一帧就需要
+ *  - batch：批量旋转
+ *  - layout：tile 排列和条带旋转
+ *  - yuv：YUV420 旋转
+ *  - resample：反向映射的重采样旋转（bilinear / lanczos3 / area）
+ */
+enum RotateVariant {
+  kVariantCore = 0,
+  kVariantBatch = 1,
+  kVariantLayout = 2,
+  kVariantYuv = 3,
+  kVariantResample = 4,
+  kRotateVariantCount
+};
+
+const char *RotateVariantName(RotateVariant variant);
+
+/**
+ * @brief 按 tile 重排后常驻设备端的源图，由 RotateEngine::UploadTiled 创建
+ */
+struct TiledImage {
+  TiledImage() : buffer(NULL), width(0), height(0), tile(0) {}
+  cl_mem buffer;
+  int width;
+  int height;
+  int tile;
+};
+
+/**
+ * @brief 条带分解中的一个条带：输出的一段行，以及可能映射进来的源图行（含 halo）
+ * @note origin/size 是在父 buffer 中的字节范围，origin 按 CL_DEVICE_MEM_BASE_ADDR_ALIGN
+ *       对齐，可以直接用于 clCreateSubBuffer；base 是对齐后第一行在 sub-buffer 内的
+ *       偏移（元素）。相邻条带的输出范围互不重叠，源图范围可以重叠（只读）
+ */
+struct RotateBand {
+  int dstRow0;
+  int dstRows;
+  int srcRow0;
+  int srcRows;
+  size_t srcOrigin;
+  size_t srcSize;
+  int srcBase;
+  size_t dstOrigin;
+  size_t dstSize;
+  int dstBase;
+};
+
+/**
+ * @brief 把 w*h 的旋转按输出行切成最多 bands 个条带
+ * @param align 子 buffer 起点的对齐字节数；条带边界取在输出行起点对齐的行上，
+ *        所以实际条带数可能少于 bands
+ * @note 源图范围由条带四角逆旋转得到，上下各多留一行抵消取整误差
+ */
+void PlanRotateBands(int w, int h, float sinTheta, float cosTheta, int inPitch,
+                     int outPitch, int bands, size_t align,
+                     std::vector<RotateBand> *plan);
+
+/**
+ * @brief 常驻的图像旋转引擎
+ * @note 把 rotate.cpp 原先 main() 中的 1~6 步（Platform、Context、Device、
+ *       Program、Kernel、Command Queue）只执行一次并保存下来，之后每次旋转
+ *       只需要准备内存对象、设置参数、入队执行，避免每帧重复初始化的开销。
+ *       引擎本身不是线程安全的，多线程使用时需要由调用方加锁。例外是 RotateBatch：
+ *       不同 priority 的调用各自使用独立的 kernel 对象、暂存 buffer 和 queue，
+ *       可以在两个线程上同时进行（同一 priority 仍然需要串行）。
+ */
+class RotateEngine {
+ public:
+  RotateEngine();
+  ~RotateEngine();
+
+  RotateEngine(const RotateEngine &) = delete;
+  RotateEngine &operator=(const RotateEngine &) = delete;
+
+  /**
+   * @brief 查询Platform、创建Context/Device、编译kernel并创建Command Queue
+   * @param kernelPath rotate.cl 的路径
+   * @param deviceType 需要的设备类型，例如 CL_DEVICE_TYPE_GPU
+   */
+  cl_int Init(const std::string &kernelPath, cl_device_type deviceType);
+
+  /**
+   * @brief Init 的前半部分：创建 Context 和 Program 后以 pfn_notify 方式调用
+   *        clBuildProgram，不等编译完成就返回
+   * @note 编译在驱动的线程上进行，调用方可以先做别的事（例如在 CPU 上处理请求），
+   *       再调用 FinishInit()。Init() 等价于两者连续调用
+   */
+  cl_int BeginInit(const std::string &kernelPath, cl_device_type deviceType);
+
+  /**
+   * @brief 等待 BeginInit 启动的编译完成，然后创建 kernel 和 Command Queue
+   * @return 编译失败时返回 CL_BUILD_PROGRAM_FAILURE，编译日志见 buildLog()
+   */
+  cl_int FinishInit();
+
+  // BeginInit 启动的编译是否已经结束（成功或失败），不阻塞
+  bool buildFinished();
+  // 最近一次编译的 CL_PROGRAM_BUILD_LOG（FinishInit 之后有效）
+  const std::string &buildLog() const { return buildLog_; }
+  // 最近一次编译从 clBuildProgram 到完成回调的耗时（秒）
+  double buildSeconds() const { return buildSeconds_; }
+
+  /**
+   * @brief 把 rotate.cl 拆成各个 RotateVariant 分别编译，由 threads 个线程并行完成
+   * @note 需要在 Init/BeginInit 之前调用。core 变体优先编译，FinishInit 只等待它；
+   *       其余变体在后台继续编译，第一次 RotateBatch/RotateYuv/RotateTiled/RotateBanded
+   *       时才等待并创建 kernel。threads 为 0（默认）时整个 rotate.cl 作为一个
+   *       program 编译（见 BeginInit）
+   */
+  void SetBuildThreads(int threads) { buildThreads_ = threads; }
+
+  /**
+   * @brief 初始化（BeginInit/FinishInit）失败时不打印诊断信息，只返回错误码
+   * @note FailoverRotator 的后台探测反复初始化，由它自己决定什么时候报告；
+   *       编译日志仍然可以通过 buildLog() 取得
+   */
+  void SetQuiet(bool quiet) { quiet_ = quiet; }
+
+  /**
+   * @brief 打印各变体的排队和编译时间（SetBuildThreads 之后才有内容）
+   */
+  void PrintBuildStats(std::ostream &os);
+
+  /**
+   * @brief 拷贝方式旋转：in/out 为调用方的普通 host 内存
+   * @note 上传/读回的方式由传输策略决定（见 rotate_transfer.h），
+   *       没有加载 profile 时使用 kTransferPageable：输入通过 CL_MEM_COPY_HOST_PTR
+   *       上传，结果阻塞读回 out
+   */
+  cl_int Rotate(const int *in, int *out, int w, int h, float sinTheta,
+                float cosTheta) {
+    return RotateStrided(in, w, out, w, w, h, sinTheta, cosTheta);
+  }
+
+  /**
+   * @brief 带行跨度的拷贝方式旋转，inPitch / outPitch 以像素计且不小于 w
+   * @note 解码器等给出的带填充的帧可以直接传入，不需要先重新排列；
+   *       out 每行末尾的填充不会被改写（见 rotate_image.h）
+   */
+  cl_int RotateStrided(const int *in, int inPitch, int *out, int outPitch,
+                       int w, int h, float sinTheta, float cosTheta);
+
+  /**
+   * @brief YUV420（I420/NV12/NV21）旋转，亮度和色度在一次 launch 中完成
+   * @note in/out 各为 YuvFrameBytes(w, h) 字节，w、h 必须是偶数。
+   *       out 原有内容会一并上传，未被旋转覆盖的像素保持调用方的背景值
+   */
+  cl_int RotateYuv(const unsigned char *in, unsigned char *out, int w, int h,
+                   YuvFormat format, float sinTheta, float cosTheta) {
+    return RotateYuvStrided(in, w, out, w, w, h, format, sinTheta, cosTheta);
+  }
+
+  /**
+   * @brief 带行跨度的 YUV420 旋转，inPitch / outPitch 是亮度行跨度（字节，偶数），
+   *        in/out 各为 YuvPitchedFrameBytes(h, pitch) 字节
+   */
+  cl_int RotateYuvStrided(const unsigned char *in, int inPitch,
+                          unsigned char *out, int outPitch, int w, int h,
+                          YuvFormat format, float sinTheta, float cosTheta);
+
+  /**
+   * @brief 设置拷贝方式旋转的背景值，未被旋转覆盖的输出像素取这个值（默认 0）
+   * @note Rotate/RotateStrided/RotateTiled/RotateBanded 的设备端输出 buffer 在 kernel
+   *       之前用 clEnqueueFillBuffer 填充，和输入上传一起排队，host 不需要先 memset；
+   *       旋转写满整个输出时（见 RotationCoversOutput）跳过填充。
+   *       带行跨度的 kTransferHostPtr 方式直接包装调用方内存，逐行在 host 上填充。
+   *       零拷贝、SVM、YUV 和批量路径以调用方 out 中原有的内容作为背景
+   */
+  void SetBackground(int value) { background_ = value; }
+  int background() const { return background_; }
+
+  /**
+   * @brief 读取 opencl_bandwidth 生成的传输 profile，之后 Rotate 按帧大小选择传输方式
+   * @note 需要在 Init 之后调用；profile 记录的设备与当前设备不一致时不生效
+   */
+  cl_int UseTransferProfile(const std::string &path);
+  void SetTransferProfile(const TransferProfile &profile) {
+    transferProfile_ = profile;
+  }
+  TransferStrategy transferStrategy(size_t bytes) const {
+    return transferProfile_.Select(bytes);
+  }
+
+  /**
+   * @brief 使用 CL_MEM_USE_HOST_PTR 包装一段 host 内存，不产生额外拷贝
+   * @note host 指针在 cl_mem 释放前必须保持有效，且建议按页对齐
+   */
+  cl_mem CreateHostPtrBuffer(void *ptr, size_t bytes, cl_mem_flags flags,
+                             cl_int *status);
+
+  /**
+   * @brief 零拷贝旋转：in/out 均为 CreateHostPtrBuffer 创建的内存对象
+   * @param fillBackground 为 true 时在设备上填充背景；为 false 时 out 对应的 host
+   *        内存原有的内容就是背景，kernel 之前先同步到设备端
+   * @note 返回时 out 对应的 host 内存中已经是旋转结果。
+   *       inPitch / outPitch 为行跨度（像素），内存对象至少 StridedBytes 大小
+   */
+  cl_int RotateHostPtr(cl_mem in, int inPitch, cl_mem out, int outPitch, int w,
+                       int h, float sinTheta, float cosTheta,
+                       bool fillBackground);
+
+  /**
+   * @brief 批量旋转：count 帧相同尺寸的图像合并成一次 clEnqueueNDRangeKernel
+   * @note 各帧先写入同一个暂存 buffer（按帧偏移），kernel 执行后再分别读回各自的 out。
+   *       暂存 buffer 中各帧紧密排列，带行跨度的帧用 clEnqueueWrite/ReadBufferRect 搬运。
+   *       暂存 buffer 在引擎内复用，只有容量不足时才重新分配。
+   *       image_rotate 只写入命中的像素，所以 out 原有的内容也会一并上传，
+   *       保证和单帧路径的结果一致。
+   *       priority 为 kPriorityBulk 时在低优先级的 bulkQueue 上执行（见 priorityHints）。
+   *       两个 priority 可以由两个线程同时调用：交互批次在批量批次执行期间就能提交到
+   *       设备，由设备按 queue 优先级调度；每次调用自己等到本批次完成（clFinish）
+   */
+  cl_int RotateBatch(const RotateJob *jobs, size_t count, int w, int h,
+                     RotatePriority priority = kPriorityInteractive);
+
+  /**
+   * @brief 把源图重排成 tile 排列并上传，之后可以用不同角度多次 RotateTiled
+   * @param tile 块边长，2 的幂（8、16 最常用，最大 32）
+   * @note 重排在 host 上做一次；image 原有的 buffer 会先释放
+   */
+  cl_int UploadTiled(const int *in, int inPitch, int w, int h, int tile,
+                     TiledImage *image);
+
+  /**
+   * @brief 旋转一个已上传的 tile 排列源图，结果按 outPitch（像素）写回 out
+   * @note 与 Rotate 一样，未命中的输出像素是未定义的
+   */
+  cl_int RotateTiled(const TiledImage &image, int *out, int outPitch,
+                     float sinTheta, float cosTheta);
+  void ReleaseTiled(TiledImage *image);
+
+  /**
+   * @brief 分配一帧由应用直接读写、kernel 也能直接访问的内存
+   * @note 设备支持 OpenCL 2.0 SVM 时用 clSVMAlloc（优先 fine-grained，否则 coarse-grained，
+   *       coarse-grained 的分配在返回前已经映射给 host）；不支持时退化为页对齐的普通内存。
+   *       必须用 FreeFrame 释放，且在 Release 之前释放
+   */
+  void *AllocFrame(size_t bytes);
+  void FreeFrame(void *ptr);
+
+  /**
+   * @brief SVM 旋转：in/out 为 AllocFrame 分配的内存，kernel 直接访问，没有暂存拷贝
+   * @note 不支持 SVM 时退化为 RotateStrided（按传输策略拷贝）。
+   *       coarse-grained 时在 kernel 前后 unmap/map，返回时 host 可以直接读 out
+   */
+  cl_int RotateSvm(const int *in, int inPitch, int *out, int outPitch, int w,
+                   int h, float sinTheta, float cosTheta);
+  bool svmSupported() const { return svmCaps_ != 0; }
+  bool svmFineGrained() const {
+    return (svmCaps_ & CL_DEVICE_SVM_FINE_GRAIN_BUFFER) != 0;
+  }
+
+  /**
+   * @brief 条带分解旋转：每帧一个父 buffer，各条带是对齐的 clCreateSubBuffer 区域
+   * @note 源图整帧上传一次，各条带的 kernel 只读自己的源图 sub-buffer（含 halo），
+   *       只写自己的输出 sub-buffer，并各自读回，条带之间没有额外拷贝。
+   *       相邻条带交替放在 queue_ 和 bandQueue_ 上，一个条带读回时另一个条带的
+   *       kernel 可以同时执行；bandQueue_ 末尾的 marker 事件接到 queue_ 上汇合
+   */
+  cl_int RotateBanded(const int *in, int inPitch, int *out, int outPitch,
+                      int w, int h, float sinTheta, float cosTheta, int bands);
+
+  /**
+   * @brief 重采样旋转：反向映射，按 sampling 对源像素滤波（见 rotate_resample.h）
+   * @note 像素按 4 个 8 位通道滤波，每个输出像素都会被写到，源图外的部分取 background()。
+   *       权重表按 sampling（area 还包括角度）缓存在设备端的 constant buffer 中，
+   *       参数不变的连续帧不会重复上传。结果与 RotateCpuResampled 一致（个别通道可能差 1）
+   */
+  cl_int RotateResampled(const int *in, int inPitch, int *out, int outPitch,
+                         int w, int h, float sinTheta, float cosTheta,
+                         RotateSampling sampling);
+
+  /**
+   * @brief 单帧旋转是否改用 image_rotate_packed：6 个标量打包成一个按值传递的结构体，
+   *        任何一个变化时只需要一次 clSetKernelArg
+   * @note 两种方式的参数都经过 KernelArgCache，未变化的参数不会重复设置
+   */
+  void SetPackedArgs(bool packed) { packedArgs_ = packed; }
+  bool packedArgs() const { return packedArgs_; }
+
+  void Release();
+
+  bool ready() const { return kernel_ != NULL && queue_ != NULL; }
+  cl_platform_id platform() const { return platform_; }
+  cl_context context() const { return context_; }
+  cl_device_id device() const { return device_; }
+  cl_command_queue queue() const { return queue_; }
+  // 后台批量请求使用的 queue；设备支持 cl_khr_priority_hints 时为低优先级
+  cl_command_queue bulkQueue() const { return bulkQueue_; }
+  // queue / bulkQueue 是否真的带有 CL_QUEUE_PRIORITY_KHR（否则只是两个普通 queue）
+  bool priorityHints() const { return priorityHints_; }
+  /**
+   * @brief 设备的 CL_DEVICE_EXTENSIONS 中是否有 name
+   */
+  bool HasExtension(const char *name) const;
+  // 已构建的 rotate.cl，RotatePipeline 用它创建私有的 kernel 对象
+  cl_program program() const { return program_; }
+  // 最近一次成功执行的 kernel 耗时（profiling event 的 START~END，纳秒）
+  cl_ulong lastKernelNanos() const { return lastKernelNanos_; }
+
+ private:
+  cl_int SetArgsAndRun(cl_mem in, int inPitch, cl_mem out, int outPitch, int w,
+                       int h, float sinTheta, float cosTheta);
+  // 设置 kernel_ 除 src/dest 之外的参数并执行到完成
+  cl_int RunRotateKernel(int inPitch, int outPitch, int w, int h,
+                         float sinTheta, float cosTheta);
+  // 当前单帧旋转使用的 kernel 对象（见 SetPackedArgs）
+  cl_kernel rotateKernel() const {
+    return packedArgs_ ? packedKernel_ : kernel_;
+  }
+  cl_int CreateQueues();
+  // kernel 创建之后的设备设置：查询 SVM 能力并创建 Command Queue
+  cl_int FinishDeviceSetup();
+  // clBuildProgram 的 pfn_notify，在驱动的线程上调用，只负责唤醒 FinishInit
+  static void CL_CALLBACK BuildNotify(cl_program, void *userData);
+  void MarkBuildFinished();
+  void WaitForBuild();
+  void CaptureBuildLog();
+  // 创建 variant 包含的 kernel 并绑定参数缓存
+  cl_int CreateVariantKernels(RotateVariant variant, cl_program program);
+  // 拆分编译时等待 variant 编译完成并创建 kernel，整体编译时直接返回；
+  // 两个 priority 的 RotateBatch 可能同时第一次调用，由 variantMutex_ 串行
+  cl_int EnsureVariant(RotateVariant variant);
+  cl_int EnsureBatchBuffers(RotatePriority priority, size_t frames,
+                            size_t frameBytes);
+  cl_int EnsureResampleWeights(RotateSampling sampling, float sinTheta,
+                               float cosTheta);
+  cl_int RotatePageable(const int *in, int inPitch, int *out, int outPitch,
+                        int w, int h, float sinTheta, float cosTheta);
+  cl_int RotatePinned(const int *in, int inPitch, int *out, int outPitch, int w,
+                      int h, float sinTheta, float cosTheta);
+  cl_int RotateWrapped(const int *in, int inPitch, int *out, int outPitch,
+                       int w, int h, float sinTheta, float cosTheta);
+  cl_int RotateMapped(const int *in, int inPitch, int *out, int outPitch, int w,
+                      int h, float sinTheta, float cosTheta);
+  cl_int EnsureTransferBuffers(size_t bytes, bool pinned);
+  // queue 为 NULL 时在 queue_ 上填充
+  cl_int FillBackground(cl_mem out, size_t bytes, int w, int h, float sinTheta,
+                        float cosTheta, cl_command_queue queue = NULL);
+  void ReleaseTransferBuffers();
+
+  cl_platform_id platform_;
+  cl_device_id device_;
+  cl_context context_;
+  cl_program program_;
+  cl_kernel kernel_;
+  cl_kernel yuvKernel_;
+  cl_kernel tiledKernel_;
+  cl_kernel bandKernel_;
+  cl_kernel packedKernel_;
+  cl_kernel resampleKernel_;
+  bool packedArgs_;
+  // 每个 kernel 对象的标量参数缓存（cl_mem 参数每次都直接设置）
+  KernelArgCache kernelArgs_;
+  KernelArgCache yuvArgs_;
+  KernelArgCache tiledArgs_;
+  KernelArgCache bandArgs_;
+  KernelArgCache packedKernelArgs_;
+  KernelArgCache resampleArgs_;
+  cl_command_queue queue_;
+  cl_command_queue bulkQueue_;
+  // RotateBanded 的第二个 queue，第一次用到时创建；与 queue_ 同等优先级，
+  // 不与批量请求共用 bulkQueue_
+  cl_command_queue bandQueue_;
+  bool priorityHints_;
+
+  // 异步编译的状态：buildPending_ 表示已经调用 clBuildProgram 而回调还没有到
+  std::mutex buildMutex_;
+  std::condition_variable buildDone_;
+  bool buildPending_;
+  std::chrono::steady_clock::time_point buildStart_;
+  std::chrono::steady_clock::time_point buildEnd_;
+  std::string buildLog_;
+  double buildSeconds_;
+
+  // 拆分编译：builder_ 持有各变体的 program，variantBuilds_ 是任务编号
+  int buildThreads_;
+  bool quiet_;
+  std::unique_ptr<ProgramBuilder> builder_;
+  std::mutex variantMutex_;
+  int variantBuilds_[kRotateVariantCount];
+  bool variantReady_[kRotateVariantCount];
+
+  /**
+   * @brief 一个 priority 的批量旋转状态：kernel 对象（clSetKernelArg 不能跨线程共享）
+   *        和按容量复用的暂存 buffer
+   */
+  struct BatchSlot {
+    BatchSlot()
+        : kernel(NULL), in(NULL), out(NULL), angles(NULL), bytes(0),
+          frames(0) {}
+    cl_kernel kernel;
+    KernelArgCache args;
+    cl_mem in;
+    cl_mem out;
+    cl_mem angles;
+    size_t bytes;
+    size_t frames;
+  };
+  BatchSlot batch_[kRotatePriorityCount];
+
+  // 重采样的权重表及其对应的参数（resampleSampling_ 为 -1 表示还没有上传）
+  cl_mem resampleWeights_;
+  size_t resampleWeightsBytes_;
+  int resampleSampling_;
+  float resampleSin_;
+  float resampleCos_;
+
+  std::atomic<cl_ulong> lastKernelNanos_;
+  int background_;
+
+  // 设备的 CL_DEVICE_SVM_CAPABILITIES，OpenCL 1.x 设备为 0
+  cl_device_svm_capabilities svmCaps_;
+
+  // 单帧 Rotate 的传输策略，以及 pinned/map 方式复用的设备 buffer 和锁页暂存区
+  TransferProfile transferProfile_;
+  cl_mem transferIn_;
+  cl_mem transferOut_;
+  size_t transferBytes_;
+  cl_mem stageIn_;
+  cl_mem stageOut_;
+  void *stageInPtr_;
+  void *stageOutPtr_;
+  size_t stageBytes_;
+};
+
+#endif  // OPENCL_EXAMPLE_ROTATE_ENGINE_H_
@@ -0,0 +1,351 @@
+#include "rotate_failover.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "rotate_angle.h"
+#include "rotate_cpu.h"
+#include "rotate_metrics.h"
+
+// 自检用的帧：奇数边长的正方形旋转 90° 是一一映射，设备结果与 CPU 逐像素相同
+static const int kSelfTestSize = 17;
+
+FailoverRotator::FailoverRotator(const FailoverOptions &options)
+    : options_(options),
+      deviceType_(CL_DEVICE_TYPE_GPU),
+      background_(0),
+      onDevice_(false),
+      probing_(false),
+      building_(false),
+      stopping_(false),
+      deviceFrames_(0),
+      cpuFrames_(0),
+      failovers_(0),
+      recoveries_(0),
+      lastError_(CL_SUCCESS) {
+  options_.probeIntervalMs = std::max(1, options_.probeIntervalMs);
+  options_.probeMaxIntervalMs =
+      std::max(options_.probeIntervalMs, options_.probeMaxIntervalMs);
+}
+
+FailoverRotator::~FailoverRotator() { StopProbe(); }
+
+cl_int FailoverRotator::Init(const std::string &kernelPath,
+                             cl_device_type deviceType,
+                             const std::string &transferProfilePath) {
+  kernelPath_ = kernelPath;
+  deviceType_ = deviceType;
+  transferProfilePath_ = transferProfilePath;
+  if (options_.asyncBuild) {
+    // 只同步做到 clBuildProgram，之后的帧先走 CPU，编译由探测线程等待并接管
+    std::unique_ptr<RotateEngine> engine(new RotateEngine());
+    engine->SetBuildThreads(options_.buildThreads);
+    cl_int status = engine->BeginInit(kernelPath_, deviceType_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (status != CL_SUCCESS) {
+      FailOver(status);
+    } else {
+      building_.store(true);
+      StartProbe(std::move(engine));
+    }
+    return CL_SUCCESS;
+  }
+  cl_int status = CL_SUCCESS;
+  std::unique_ptr<RotateEngine> engine = CreateEngine(&status, false);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (engine) {
+    engine_ = std::move(engine);
+    onDevice_.store(true);
+  } else {
+    FailOver(status);
+  }
+  return CL_SUCCESS;
+}
+
+std::unique_ptr<RotateEngine> FailoverRotator::CreateEngine(cl_int *status,
+                                                            bool quiet) {
+  std::unique_ptr<RotateEngine> engine(new RotateEngine());
+  engine->SetBuildThreads(options_.buildThreads);
+  engine->SetQuiet(quiet);
+  *status = engine->BeginInit(kernelPath_, deviceType_);
+  if (*status == CL_SUCCESS) {
+    *status = FinishEngine(engine.get(), quiet);
+  }
+  if (*status != CL_SUCCESS) {
+    return std::unique_ptr<RotateEngine>();
+  }
+  // 投入使用之后的错误照常打印
+  engine->SetQuiet(false);
+  return engine;
+}
+
+cl_int FailoverRotator::FinishEngine(RotateEngine *engine, bool quiet) {
+  cl_int status = engine->FinishInit();
+  if (status != CL_SUCCESS) {
+    return status;
+  }
+  if (!transferProfilePath_.empty()) {
+    engine->UseTransferProfile(transferProfilePath_);
+  }
+  engine->SetBackground(background_.load());
+
+  // 初始化成功不代表能正常执行，先跑一帧结果确定的旋转
+  const int n = kSelfTestSize;
+  std::vector<int> in(n * n);
+  std::vector<int> out(n * n, 0);
+  std::vector<int> expected(n * n, 0);
+  for (int i = 0; i < n * n; i++) {
+    in[i] = i + 1;
+  }
+  float sinTheta = 0;
+  float cosTheta = 1;
+  AngleToSinCos(90.0f, &sinTheta, &cosTheta);
+  status = engine->Rotate(in.data(), out.data(), n, n, sinTheta, cosTheta);
+  if (status != CL_SUCCESS) {
+    return status;
+  }
+  RotateCpu<int>(in.data(), expected.data(), n, n, sinTheta, cosTheta);
+  if (out != expected) {
+    if (!quiet) {
+      std::cout << "Device self-test produced wrong pixels." << std::endl;
+    }
+    return CL_INVALID_OPERATION;
+  }
+  return CL_SUCCESS;
+}
+
+void FailoverRotator::FailOver(cl_int status) {
+  std::cout << "OpenCL error " << status
+            << ", falling back to the CPU path." << std::endl;
+  Metrics().errors.Add(status);
+  Metrics().deviceFailovers.Add();
+  failovers_.fetch_add(1);
+  lastError_.store(status);
+  onDevice_.store(false);
+  engine_.reset();
+  StartProbe(std::unique_ptr<RotateEngine>());
+}
+
+void FailoverRotator::ReportFailure(RotateEngine *engine, cl_int status) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (engine_.get() != engine) {
+    return;
+  }
+  FailOver(status);
+}
+
+void FailoverRotator::StartProbe(std::unique_ptr<RotateEngine> pending) {
+  // 上一个探测线程已经结束（probing_ 为 false）时先回收它
+  if (probing_.load()) {
+    return;
+  }
+  if (probe_.joinable()) {
+    probe_.join();
+  }
+  {
+    std::lock_guard<std::mutex> lock(probeMutex_);
+    if (stopping_) {
+      return;
+    }
+  }
+  probing_.store(true);
+  probe_ = std::thread(&FailoverRotator::ProbeLoop, this, std::move(pending));
+}
+
+void FailoverRotator::ProbeLoop(std::unique_ptr<RotateEngine> pending) {
+  if (pending) {
+    // 异步编译的首个引擎：不等待间隔，编译一结束就接管
+    cl_int status = FinishEngine(pending.get(), false);
+    building_.store(false);
+    if (status == CL_SUCCESS) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      engine_ = std::move(pending);
+      onDevice_.store(true);
+      std::cout << "OpenCL build finished in " << engine_->buildSeconds()
+                << " s, leaving the CPU path." << std::endl;
+      probing_.store(false);
+      return;
+    }
+    pending.reset();
+    std::cout << "OpenCL error " << status << ", staying on the CPU path."
+              << std::endl;
+    Metrics().errors.Add(status);
+    Metrics().deviceFailovers.Add();
+    failovers_.fetch_add(1);
+    lastError_.store(status);
+  }
+  // 永久性的故障（没有 platform、编译错误）时不必每秒重新编译一次：每次失败后间隔
+  // 翻倍，最多 probeMaxIntervalMs。探测的引擎不打印，错误码变化时才报告一行
+  int intervalMs = options_.probeIntervalMs;
+  cl_int reported = lastError_.load();
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(probeMutex_);
+      probeWakeup_.wait_for(lock, std::chrono::milliseconds(intervalMs),
+                            [this] { return stopping_; });
+      if (stopping_) {
+        break;
+      }
+    }
+    // 在锁外初始化新引擎（编译可能要几百毫秒），成功后再替换进去
+    cl_int status = CL_SUCCESS;
+    std::unique_ptr<RotateEngine> engine = CreateEngine(&status, true);
+    if (!engine) {
+      lastError_.store(status);
+      intervalMs = intervalMs > options_.probeMaxIntervalMs / 2
+                       ? options_.probeMaxIntervalMs
+                       : intervalMs * 2;
+      if (status != reported) {
+        std::cout << "OpenCL device probe failed with error " << status
+                  << ", retrying in " << intervalMs << " ms." << std::endl;
+        reported = status;
+      }
+      continue;
+    }
+    // 与上面的分支一样在 mutex_ 内清掉 probing_：解锁后的第一帧就可能失败，
+    // 那时 FailOver 必须能重新启动探测
+    std::lock_guard<std::mutex> lock(mutex_);
+    engine_ = std::move(engine);
+    onDevice_.store(true);
+    recoveries_.fetch_add(1);
+    std::cout << "OpenCL device recovered, leaving the CPU path." << std::endl;
+    probing_.store(false);
+    return;
+  }
+  probing_.store(false);
+}
+
+void FailoverRotator::StopProbe() {
+  {
+    std::lock_guard<std::mutex> lock(probeMutex_);
+    stopping_ = true;
+  }
+  probeWakeup_.notify_all();
+  if (probe_.joinable()) {
+    probe_.join();
+  }
+}
+
+void FailoverRotator::SetBackground(int value) {
+  // 引擎的背景值只在 Rotate 中使用，与它串行
+  std::lock_guard<std::mutex> rotateLock(rotateMutex_);
+  background_.store(value);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (engine_) {
+    engine_->SetBackground(value);
+  }
+}
+
+cl_int FailoverRotator::Run(size_t frames, const DeviceFn &deviceFn,
+                            const std::function<void()> &cpuFn) {
+  std::shared_ptr<RotateEngine> engine;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    engine = engine_;
+  }
+  if (engine) {
+    cl_int status = deviceFn(engine);
+    if (status == CL_SUCCESS) {
+      deviceFrames_.fetch_add(frames);
+      return CL_SUCCESS;
+    }
+    // 参数错误换到 CPU 上也一样，直接返回；其余错误都当作设备故障
+    if (status == CL_INVALID_VALUE) {
+      return status;
+    }
+    ReportFailure(engine.get(), status);
+  }
+  cpuFn();
+  return CL_SUCCESS;
+}
+
+cl_int FailoverRotator::Rotate(const int *in, int inPitch, int *out,
+                               int outPitch, int w, int h, float sinTheta,
+                               float cosTheta) {
+  if (w <= 0 || h <= 0 || inPitch < w || outPitch < w) {
+    return CL_INVALID_VALUE;
+  }
+  std::lock_guard<std::mutex> lock(rotateMutex_);
+  return Run(
+      1,
+      [&](const std::shared_ptr<RotateEngine> &engine) {
+        return engine->RotateStrided(in, inPitch, out, outPitch, w, h,
+                                     sinTheta, cosTheta);
+      },
+      [&]() {
+        RotateOnCpu(in, inPitch, out, outPitch, w, h, sinTheta, cosTheta);
+      });
+}
+
+cl_int FailoverRotator::RotateBatch(const RotateJob *jobs, size_t count,
+                                    int w, int h, RotatePriority priority) {
+  if (count == 0) {
+    return CL_SUCCESS;
+  }
+  // CPU 路径直接按 pitch 访问内存，参数在这里先检查
+  if (w <= 0 || h <= 0 || priority < 0 || priority >= kRotatePriorityCount) {
+    return CL_INVALID_VALUE;
+  }
+  for (size_t i = 0; i < count; i++) {
+    if ((jobs[i].inPitch != 0 && jobs[i].inPitch < w) ||
+        (jobs[i].outPitch != 0 && jobs[i].outPitch < w)) {
+      return CL_INVALID_VALUE;
+    }
+  }
+  std::lock_guard<std::mutex> lock(batchMutex_[priority]);
+  return Run(
+      count,
+      [&](const std::shared_ptr<RotateEngine> &engine) {
+        return engine->RotateBatch(jobs, count, w, h, priority);
+      },
+      [&]() {
+        for (size_t i = 0; i < count; i++) {
+          RotateOnCpu(jobs[i].in, jobs[i].inPitch > 0 ? jobs[i].inPitch : w,
+                      jobs[i].out, jobs[i].outPitch > 0 ? jobs[i].outPitch : w,
+                      w, h, jobs[i].sinTheta, jobs[i].cosTheta, false);
+        }
+      });
+}
+
+void FailoverRotator::RotateOnCpu(const int *in, int inPitch, int *out,
+                                  int outPitch, int w, int h, float sinTheta,
+                                  float cosTheta, bool fillBackground) {
+  // 与设备路径一致：旋转不能写满输出时先填背景
+  if (fillBackground && !RotationCoversOutput(w, h, sinTheta, cosTheta)) {
+    int background = background_.load();
+    for (int y = 0; y < h; y++) {
+      std::fill(out + (size_t)y * outPitch, out + (size_t)y * outPitch + w,
+                background);
+    }
+  }
+  RotateCpuParallel(in, inPitch, out, outPitch, w, h, sinTheta, cosTheta,
+                    options_.cpuThreads);
+  cpuFrames_.fetch_add(1);
+  Metrics().frames.Add();
+  Metrics().cpuFallbackFrames.Add();
+}
+
+void FailoverRotator::PrintStats(std::ostream &os) const {
+  os << "failover: "
+     << (onDevice() ? "on device" : building() ? "on CPU, building" : "on CPU")
+     << ", device frames " << deviceFrames_.load() << ", CPU frames "
+     << cpuFrames_.load() << ", failovers " << failovers_.load()
+     << ", recoveries " << recoveries_.load();
+  if (failovers_.load() > 0) {
+    os << ", last error " << lastError_.load();
+  }
+  os << std::endl;
+}
+
+void FailoverRotator::PrintBuildStats(std::ostream &os) {
+  std::shared_ptr<RotateEngine> engine;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    engine = engine_;
+  }
+  if (engine) {
+    engine->PrintBuildStats(os);
+  }
+}
@@ -0,0 +1,164 @@
+#ifndef OPENCL_EXAMPLE_ROTATE_FAILOVER_H_
+#define OPENCL_EXAMPLE_ROTATE_FAILOVER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+#include <CL/cl.h>
+
+#include "rotate_engine.h"
+
+/**
+ * @brief 故障转移的参数
+ * @param probeIntervalMs 退到 CPU 之后重新探测设备的间隔
+ * @param probeMaxIntervalMs 探测连续失败时间隔逐次翻倍，最多到这个值
+ * @param cpuThreads CPU 路径的线程数，0 表示 hardware_concurrency
+ * @param asyncBuild Init 不等待 kernel 编译，编译期间的帧在 CPU 上完成，编译好后切到设备
+ * @param buildThreads 传给 RotateEngine::SetBuildThreads
+ */
+struct FailoverOptions {
+  FailoverOptions()
+      : probeIntervalMs(1000), probeMaxIntervalMs(60000), cpuThreads(0),
+        asyncBuild(false), buildThreads(0) {}
+  int probeIntervalMs;
+  int probeMaxIntervalMs;
+  int cpuThreads;
+  bool asyncBuild;
+  int buildThreads;
+};
+
+/**
+ * ========== 带 CPU 故障转移的旋转 ==========
+ * 设备不可用（没有 GPU、clBuildProgram 失败）或运行时出错（CL_OUT_OF_RESOURCES 等）时，
+ * 不再让整个任务失败，而是透明地改用多线程 CPU 路径（RotateCpuParallel），结果与
+ * 设备路径相同。退到 CPU 后后台线程每隔 probeIntervalMs 重新初始化一个引擎（连续失败时
+ * 间隔翻倍，最多 probeMaxIntervalMs；错误码变化时才打印），并用一帧
+ * 结果确定的自检（奇数边长正方形旋转 90°）确认设备正常后再切回去。
+ *  - CL_INVALID_VALUE 这类调用方参数错误直接返回，不触发故障转移
+ *  - 出错的那一帧在 CPU 上重做，调用方只会看到 CL_SUCCESS
+ * asyncBuild 时 Init 只同步创建 Context/Program，clBuildProgram 在后台完成（见
+ * RotateEngine::BeginInit），第一帧不用等编译，编译完成并通过自检后再切到设备。
+ * 单帧（Rotate）、批量（RotateBatch，守护进程的 BatchScheduler）和调用方自定义的设备
+ * 操作（Run，守护进程的零拷贝路径）都经过同一个引擎和同一套故障转移。
+ * 每次调用先在锁内取得当前引擎的引用，执行期间不持有这把锁：出错时引擎被换下，
+ * 等正在使用它的调用结束后才销毁。Rotate() 之间由内部的锁串行，两个 priority 的
+ * RotateBatch 可以同时进行（见 RotateEngine::RotateBatch）。
+ */
+class FailoverRotator {
+ public:
+  explicit FailoverRotator(const FailoverOptions &options);
+  ~FailoverRotator();
+
+  FailoverRotator(const FailoverRotator &) = delete;
+  FailoverRotator &operator=(const FailoverRotator &) = delete;
+
+  /**
+   * @brief 初始化设备引擎，失败时进入 CPU 模式并开始后台探测；asyncBuild 时不等编译
+   * @param transferProfilePath 非空时每个新引擎都加载这个传输 profile
+   * @return 总是 CL_SUCCESS；是否在设备上见 onDevice()
+   */
+  cl_int Init(const std::string &kernelPath, cl_device_type deviceType,
+              const std::string &transferProfilePath);
+
+  /**
+   * @brief 与 RotateEngine::RotateStrided 相同，设备出错时自动在 CPU 上完成
+   */
+  cl_int Rotate(const int *in, int inPitch, int *out, int outPitch, int w,
+                int h, float sinTheta, float cosTheta);
+
+  /**
+   * @brief 与 RotateEngine::RotateBatch 相同，设备出错时各帧在 CPU 上完成
+   * @note 与设备路径一致，out 原有的内容就是背景；同一 priority 的调用由内部的锁串行
+   */
+  cl_int RotateBatch(const RotateJob *jobs, size_t count, int w, int h,
+                     RotatePriority priority);
+
+  typedef std::function<cl_int(const std::shared_ptr<RotateEngine> &)>
+      DeviceFn;
+  /**
+   * @brief 在当前的设备引擎上执行 deviceFn；没有设备（包括 asyncBuild 编译期间），
+   *        或者 deviceFn 返回 CL_INVALID_VALUE 以外的错误时，故障转移并执行 cpuFn
+   * @param frames 本次处理的帧数，只用于统计
+   * @note 调用方可以缓存与引擎绑定的资源（例如包装 host 内存的 cl_mem），同时持有
+   *       engine 的引用；传入的 engine 与缓存的不同时说明引擎已经更换，需要重建。
+   *       deviceFn 之间的串行由调用方负责
+   */
+  cl_int Run(size_t frames, const DeviceFn &deviceFn,
+             const std::function<void()> &cpuFn);
+
+  /**
+   * @brief CPU 路径（RotateCpuParallel），计入 CPU 帧数
+   * @param fillBackground 旋转不能写满输出时是否先填背景；为 false 时 out 原有的内容
+   *        就是背景，与零拷贝、批量的设备路径一致
+   */
+  void RotateOnCpu(const int *in, int inPitch, int *out, int outPitch, int w,
+                   int h, float sinTheta, float cosTheta,
+                   bool fillBackground = true);
+
+  void SetBackground(int value);
+
+  bool onDevice() const { return onDevice_.load(); }
+  // asyncBuild 启动的首次编译是否还在进行
+  bool building() const { return building_.load(); }
+
+  /**
+   * @brief 打印设备/CPU 各自处理的帧数以及故障转移、恢复的次数
+   */
+  void PrintStats(std::ostream &os) const;
+  /**
+   * @brief 当前引擎的 RotateEngine::PrintBuildStats，在 CPU 上时不打印
+   */
+  void PrintBuildStats(std::ostream &os);
+
+ private:
+  // 新建一个引擎并自检，失败返回 NULL
+  // quiet 时初始化和自检失败都不打印（后台探测用）
+  std::unique_ptr<RotateEngine> CreateEngine(cl_int *status, bool quiet);
+  // 等 BeginInit 之后的编译完成，再配置并自检
+  cl_int FinishEngine(RotateEngine *engine, bool quiet);
+  // 调用时持有 mutex_
+  void FailOver(cl_int status);
+  // 使用 engine 的调用出错：engine 仍是当前引擎时故障转移（其他线程可能已经处理过）
+  void ReportFailure(RotateEngine *engine, cl_int status);
+  // 调用时持有 mutex_；pending 非空时探测线程先等它编译完成，不等待间隔
+  void StartProbe(std::unique_ptr<RotateEngine> pending);
+  void ProbeLoop(std::unique_ptr<RotateEngine> pending);
+  void StopProbe();
+
+  FailoverOptions options_;
+  std::string kernelPath_;
+  cl_device_type deviceType_;
+  std::string transferProfilePath_;
+  std::atomic<int> background_;
+
+  // mutex_ 保护 engine_ 的替换；rotateMutex_ 串行 Rotate，batchMutex_ 串行同一 priority
+  // 的 RotateBatch。加锁顺序：rotateMutex_ / batchMutex_ 在 mutex_ 之前
+  std::mutex mutex_;
+  std::shared_ptr<RotateEngine> engine_;
+  std::atomic<bool> onDevice_;
+  std::mutex rotateMutex_;
+  std::mutex batchMutex_[kRotatePriorityCount];
+
+  // 后台探测线程：probing_ 为 true 时线程在运行，stopping_ 通知它退出
+  std::thread probe_;
+  std::atomic<bool> probing_;
+  std::atomic<bool> building_;
+  bool stopping_;
+  std::mutex probeMutex_;
+  std::condition_variable probeWakeup_;
+
+  std::atomic<uint64_t> deviceFrames_;
+  std::atomic<uint64_t> cpuFrames_;
+  std::atomic<uint64_t> failovers_;
+  std::atomic<uint64_t> recoveries_;
+  std::atomic<int> lastError_;
+};
+
+#endif  // OPENCL_EXAMPLE_ROTATE_FAILOVER_H_
@@ -0,0 +1,49 @@
+#ifndef OPENCL_EXAMPLE_ROTATE_FORMAT_H_
+#define OPENCL_EXAMPLE_ROTATE_FORMAT_H_
+
+#include <cstddef>
+#include <string>
+
+/**
+ * ========== YUV420 帧格式 ==========
+ * 三种格式都是 W*H 的亮度平面后面跟着半分辨率（W/2 * H/2）的色度：
+ *  - I420：U 平面，然后 V 平面
+ *  - NV12：一个 UV 交错的平面（U 在前）
+ *  - NV21：一个 VU 交错的平面（V 在前）
+ * 旋转只搬运样本、不改变样本的含义，所以 NV12 和 NV21 的处理完全相同，
+ * 色度以 2 字节为单位整体移动。W、H 必须是偶数。
+ */
+enum YuvFormat { kYuvI420 = 0, kYuvNV12, kYuvNV21 };
+
+inline bool ParseYuvFormat(const std::string &name, YuvFormat *format) {
+  if (name == "i420") {
+    *format = kYuvI420;
+  } else if (name == "nv12") {
+    *format = kYuvNV12;
+  } else if (name == "nv21") {
+    *format = kYuvNV21;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+inline bool IsSemiPlanar(YuvFormat format) { return format != kYuvI420; }
+
+/**
+ * @brief 一帧 YUV420 的字节数：W*H + 2 * (W/2) * (H/2)
+ */
+inline size_t YuvFrameBytes(int w, int h) {
+  return (size_t)w * h + 2 * (size_t)(w / 2) * (h / 2);
+}
+
+/**
+ * @brief 亮度行跨度为 pitch 字节（偶数）的 YUV420 帧大小
+ * @note 色度平面紧接在 pitch*H 之后，I420 的 U、V 行跨度为 pitch/2，
+ *       NV12/NV21 的 UV 行跨度为 pitch，两种排列的总大小相同
+ */
+inline size_t YuvPitchedFrameBytes(int h, size_t pitch) {
+  return pitch * h + 2 * (pitch / 2) * (size_t)(h / 2);
+}
+
+#endif  // OPENCL_EXAMPLE_ROTATE_FORMAT_H_
@@ -0,0 +1,149 @@
+#ifndef OPENCL_EXAMPLE_ROTATE_IMAGE_H_
+#define OPENCL_EXAMPLE_ROTATE_IMAGE_H_
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+/**
+ * ========== 带行跨度（pitch）的图像 ==========
+ * 解码器、相机驱动等给出的帧通常每行末尾有填充，第 y 行从 y * pitch 开始。
+ * 所有 kernel 和引擎接口都接受输入、输出各自的 pitch（单位是像素/元素，
+ * YUV 接口是字节），pitch == width 就是原来紧密排列的情况。
+ * 自己分配图像时用 PitchedImage，行宽按 cache line（也是 AVX-512 的宽度）对齐，
+ * 每行的起始地址都对齐，SIMD 访问不会跨 cache line。
+ */
+
+static const size_t kRowAlignment = 64;
+
+/**
+ * @brief 把一行 width 个 elemSize 字节的元素向上对齐到 alignment 字节，返回以元素计的 pitch
+ */
+inline size_t AlignedPitch(int width, size_t elemSize,
+                           size_t alignment = kRowAlignment) {
+  size_t rowBytes = (size_t)width * elemSize;
+  size_t aligned = (rowBytes + alignment - 1) / alignment * alignment;
+  return aligned / elemSize;
+}
+
+/**
+ * @brief pitch 排列的 w*h 图像实际占用的字节数（最后一行不需要填充）
+ */
+inline size_t StridedBytes(int w, int h, size_t pitch, size_t elemSize) {
+  if (w <= 0 || h <= 0) {
+    return 0;
+  }
+  return ((size_t)(h - 1) * pitch + w) * elemSize;
+}
+
+/**
+ * @brief 逐行拷贝 rows 行、每行 rowBytes 字节，两边都是紧密排列时退化为一次 memcpy
+ * @note 只写 dst 每行的前 rowBytes 字节，行尾的填充保持原值
+ */
+inline void CopyRows(void *dst, size_t dstPitchBytes, const void *src,
+                     size_t srcPitchBytes, size_t rowBytes, int rows) {
+  if (dstPitchBytes == rowBytes && srcPitchBytes == rowBytes) {
+    memcpy(dst, src, rowBytes * rows);
+    return;
+  }
+  for (int y = 0; y < rows; y++) {
+    memcpy((char *)dst + y * dstPitchBytes,
+           (const char *)src + y * srcPitchBytes, rowBytes);
+  }
+}
+
+/**
+ * ========== tile 排列 ==========
+ * 图像切成 tile*tile 的小块（tile 为 2 的幂，通常 8 或 16），块按行优先依次存放，
+ * 块内也按行优先排列，右边和下边不满一块的部分补齐。
+ * 旋转是正向映射：按行读源图时，连续像素写到输出中的一条斜线上，30~60° 时每次写都
+ * 落在不同的 cache line / DRAM 页。按块遍历时相邻像素来自同一个小方块，
+ * 写出的位置也集中在旋转后的小方块里，读依然是连续的。
+ * 重排只在上传时做一次，同一源图旋转多次或图像很大时收益最明显。
+ */
+
+inline bool IsValidTile(int tile) {
+  return tile >= 2 && tile <= 32 && (tile & (tile - 1)) == 0;
+}
+
+/**
+ * @brief tile 排列的 w*h 图像占用的元素个数（含补齐部分）
+ */
+inline size_t TiledElements(int w, int h, int tile) {
+  size_t tilesX = (size_t)(w + tile - 1) / tile;
+  size_t tilesY = (size_t)(h + tile - 1) / tile;
+  return tilesX * tilesY * tile * tile;
+}
+
+/**
+ * @brief 把行跨度为 srcPitch（元素）的图像重排成 tile 排列，补齐部分填 0
+ * @param dst 至少 TiledElements(w, h, tile) 个元素
+ */
+template <typename T>
+void TileImage(const T *src, size_t srcPitch, int w, int h, int tile, T *dst) {
+  int tilesX = (w + tile - 1) / tile;
+  int tilesY = (h + tile - 1) / tile;
+  for (int ty = 0; ty < tilesY; ty++) {
+    for (int tx = 0; tx < tilesX; tx++) {
+      T *block = dst + ((size_t)ty * tilesX + tx) * tile * tile;
+      for (int y = 0; y < tile; y++) {
+        int sy = ty * tile + y;
+        for (int x = 0; x < tile; x++) {
+          int sx = tx * tile + x;
+          block[y * tile + x] =
+              (sx < w && sy < h) ? src[(size_t)sy * srcPitch + sx] : T();
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief 行对齐的图像缓冲区，起始地址按页对齐，可以直接用于 CL_MEM_USE_HOST_PTR
+ */
+template <typename T>
+class PitchedImage {
+ public:
+  PitchedImage() : data_(NULL), width_(0), height_(0), pitch_(0) {}
+  PitchedImage(int width, int height) : PitchedImage() {
+    Allocate(width, height);
+  }
+  ~PitchedImage() { free(data_); }
+
+  PitchedImage(const PitchedImage &) = delete;
+  PitchedImage &operator=(const PitchedImage &) = delete;
+
+  bool Allocate(int width, int height) {
+    free(data_);
+    data_ = NULL;
+    width_ = width;
+    height_ = height;
+    pitch_ = AlignedPitch(width, sizeof(T));
+    void *ptr = NULL;
+    if (posix_memalign(&ptr, 4096, bytes() == 0 ? 1 : bytes()) != 0) {
+      width_ = height_ = 0;
+      pitch_ = 0;
+      return false;
+    }
+    data_ = (T *)ptr;
+    memset(data_, 0, bytes());
+    return true;
+  }
+
+  T *data() { return data_; }
+  const T *data() const { return data_; }
+  T *row(int y) { return data_ + (size_t)y * pitch_; }
+  const T *row(int y) const { return data_ + (size_t)y * pitch_; }
+  int width() const { return width_; }
+  int height() const { return height_; }
+  size_t pitch() const { return pitch_; }  // 以元素计
+  size_t bytes() const { return pitch_ * height_ * sizeof(T); }
+
+ private:
+  T *data_;
+  int width_;
+  int height_;
+  size_t pitch_;
+};
+
+#endif  // OPENCL_EXAMPLE_ROTATE_IMAGE_H_
@@ -0,0 +1,87 @@
+#ifndef OPENCL_EXAMPLE_ROTATE_KERNEL_ARGS_H_
+#define OPENCL_EXAMPLE_ROTATE_KERNEL_ARGS_H_
+
+#include <cstring>
+#include <vector>
+
+#include <CL/cl.h>
+
+#include "rotate_metrics.h"
+
+/**
+ * @brief rotate.cl 中 image_rotate_packed 按值传递的参数结构体
+ * @note 字段顺序、大小与 kernel 中的 RotateParams 一致，全部 4 字节，没有填充
+ */
+struct RotateKernelParams {
+  cl_int width;
+  cl_int height;
+  cl_float sinTheta;
+  cl_float cosTheta;
+  cl_int srcPitch;
+  cl_int dstPitch;
+};
+
+/**
+ * ========== kernel 参数缓存 ==========
+ * kernel 对象的参数在两次 launch 之间保持不变，连续旋转时往往只有 sin/cos 在变。
+ * 每个 kernel 对象配一个 KernelArgCache，记住每个参数下标上次设置的值，
+ * 只有值变化时才调用 clSetKernelArg，命中/未命中计入 Metrics()。
+ *
+ * @note 只用于标量（包括按值传递的结构体）。cl_mem 句柄不要经过缓存：临时 buffer
+ *       释放后，新建的 buffer 可能拿到同一个句柄值，按值比较会漏掉这次设置。
+ *       kernel 的参数被缓存之外的调用改写过时，调用 Invalidate()。
+ */
+class KernelArgCache {
+ public:
+  // 单个参数的最大字节数，足够放下 rotate.cl 里按值传递的参数结构体
+  static const size_t kMaxArgBytes = 32;
+
+  KernelArgCache() : kernel_(NULL) {}
+
+  void Bind(cl_kernel kernel) {
+    kernel_ = kernel;
+    args_.clear();
+  }
+
+  void Invalidate() { args_.clear(); }
+
+  cl_int Set(cl_uint index, size_t size, const void *value) {
+    if (size > kMaxArgBytes) {
+      return clSetKernelArg(kernel_, index, size, value);
+    }
+    if (index >= args_.size()) {
+      args_.resize(index + 1);
+    }
+    Entry &entry = args_[index];
+    if (entry.valid && entry.size == size &&
+        memcmp(entry.bytes, value, size) == 0) {
+      Metrics().kernelArgsSkipped.Add();
+      return CL_SUCCESS;
+    }
+    cl_int status = clSetKernelArg(kernel_, index, size, value);
+    // 失败时 kernel 上的值不确定，下一次一定重新设置
+    entry.valid = status == CL_SUCCESS;
+    entry.size = size;
+    memcpy(entry.bytes, value, size);
+    Metrics().kernelArgsSet.Add();
+    return status;
+  }
+
+  template <typename T>
+  cl_int Set(cl_uint index, const T &value) {
+    return Set(index, sizeof(T), &value);
+  }
+
+ private:
+  struct Entry {
+    Entry() : valid(false), size(0) {}
+    bool valid;
+    size_t size;
+    unsigned char bytes[kMaxArgBytes];
+  };
+
+  cl_kernel kernel_;
+  std::vector<Entry> args_;
+};
+
+#endif  // OPENCL_EXAMPLE_ROTATE_KERNEL_ARGS_H_
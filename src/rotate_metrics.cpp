@@ -0,0 +1,307 @@
+#include "rotate_metrics.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const double kKernelBounds[] = {1e-5,   2.5e-5, 5e-5, 1e-4,   2.5e-4,
+                                       5e-4,   1e-3,   2.5e-3, 5e-3, 1e-2,
+                                       2.5e-2, 5e-2,   0.1,  0.25,   0.5,
+                                       1.0};
+static const double kQueueWaitBounds[] = {1e-6,   2e-6, 5e-6,   1e-5, 2e-5,
+                                          5e-5,   1e-4, 2e-4,   5e-4, 1e-3,
+                                          2e-3,   5e-3, 1e-2};
+static const double kBuildBounds[] = {0.01, 0.025, 0.05, 0.1, 0.25, 0.5,
+                                      1.0,  2.5,   5.0,  10,  30};
+static const double kBatchBounds[] = {1, 2, 4, 8, 16, 32, 64};
+static const double kRequestBounds[] = {1e-4,   2.5e-4, 5e-4, 1e-3, 2.5e-3,
+                                        5e-3,   1e-2,   2.5e-2, 5e-2, 0.1,
+                                        0.25,   0.5,    1.0,  2.5};
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+static void AppendValue(std::string *out, double value) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.9g", value);
+  out->append(buf);
+}
+
+Histogram::Histogram(const double *bounds, size_t count)
+    : count_(count < kMaxBuckets ? count : kMaxBuckets), sumNanos_(0) {
+  for (size_t i = 0; i < count_; i++) {
+    bounds_[i] = bounds[i];
+  }
+  for (size_t i = 0; i <= kMaxBuckets; i++) {
+    buckets_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void Histogram::Observe(double value) {
+  size_t i = 0;
+  while (i < count_ && value > bounds_[i]) {
+    i++;
+  }
+  buckets_[i].fetch_add(1, std::memory_order_relaxed);
+  if (value > 0) {
+    sumNanos_.fetch_add((uint64_t)(value * 1e9), std::memory_order_relaxed);
+  }
+}
+
+void Histogram::Render(std::string *out, const char *name,
+                       const char *help) const {
+  out->append("# TYPE ").append(name).append(" histogram\n");
+  out->append("# HELP ").append(name).append(" ").append(help).append("\n");
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i <= count_; i++) {
+    cumulative += buckets_[i].load(std::memory_order_relaxed);
+    out->append(name).append("_bucket{le=\"");
+    if (i == count_) {
+      out->append("+Inf");
+    } else {
+      AppendValue(out, bounds_[i]);
+    }
+    out->append("\"} ").append(std::to_string(cumulative)).append("\n");
+  }
+  out->append(name).append("_sum ");
+  AppendValue(out, sumNanos_.load(std::memory_order_relaxed) / 1e9);
+  out->append("\n");
+  out->append(name).append("_count ").append(std::to_string(cumulative));
+  out->append("\n");
+}
+
+ErrorCounter::ErrorCounter() : other_(0) {
+  for (int i = 0; i < kCodes; i++) {
+    codes_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void ErrorCounter::Add(cl_int code) {
+  if (code == CL_SUCCESS) {
+    return;
+  }
+  if (code < 0 && code > -kCodes) {
+    codes_[-code].fetch_add(1, std::memory_order_relaxed);
+  } else {
+    other_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void ErrorCounter::Render(std::string *out) const {
+  out->append("# TYPE rotate_errors counter\n");
+  out->append("# HELP rotate_errors Failed requests by cl_int status code.\n");
+  for (int i = 1; i < kCodes; i++) {
+    uint64_t n = codes_[i].load(std::memory_order_relaxed);
+    if (n != 0) {
+      out->append("rotate_errors_total{code=\"-")
+          .append(std::to_string(i))
+          .append("\"} ")
+          .append(std::to_string(n))
+          .append("\n");
+    }
+  }
+  out->append("rotate_errors_total{code=\"other\"} ")
+      .append(std::to_string(other_.load(std::memory_order_relaxed)))
+      .append("\n");
+}
+
+RotateMetrics::RotateMetrics()
+    : kernelSeconds(kKernelBounds, ARRAY_SIZE(kKernelBounds)),
+      queueWaitSeconds(kQueueWaitBounds, ARRAY_SIZE(kQueueWaitBounds)),
+      batchSize(kBatchBounds, ARRAY_SIZE(kBatchBounds)),
+      interactiveRequestSeconds(kRequestBounds, ARRAY_SIZE(kRequestBounds)),
+      bulkRequestSeconds(kRequestBounds, ARRAY_SIZE(kRequestBounds)),
+      buildSeconds(kBuildBounds, ARRAY_SIZE(kBuildBounds)) {}
+
+static void RenderCounter(std::string *out, const char *name, const char *help,
+                          const Counter &counter) {
+  out->append("# TYPE ").append(name).append(" counter\n");
+  out->append("# HELP ").append(name).append(" ").append(help).append("\n");
+  out->append(name).append("_total ").append(std::to_string(counter.value()));
+  out->append("\n");
+}
+
+std::string RotateMetrics::Render() const {
+  std::string out;
+  RenderCounter(&out, "rotate_frames", "Frames rotated.", frames);
+  RenderCounter(&out, "rotate_host_to_device_bytes",
+                "Bytes explicitly uploaded to the device.", bytesHostToDevice);
+  RenderCounter(&out, "rotate_device_to_host_bytes",
+                "Bytes explicitly read back from the device.",
+                bytesDeviceToHost);
+  kernelSeconds.Render(&out, "rotate_kernel_seconds",
+                       "Kernel execution time from profiling events.");
+  queueWaitSeconds.Render(&out, "rotate_queue_wait_seconds",
+                          "Time a request waited before reaching the engine.");
+  batchSize.Render(&out, "rotate_batch_frames", "Frames per kernel launch.");
+  interactiveRequestSeconds.Render(
+      &out, "rotate_interactive_request_seconds",
+      "Submit-to-completion time of interactive requests.");
+  bulkRequestSeconds.Render(&out, "rotate_bulk_request_seconds",
+                            "Submit-to-completion time of bulk requests.");
+  RenderCounter(&out, "rotate_build_cache_misses",
+                "Program builds compiled from source.", buildCacheMisses);
+  RenderCounter(&out, "rotate_build_failures",
+                "Program builds that failed to compile.", buildFailures);
+  buildSeconds.Render(&out, "rotate_build_seconds",
+                      "Program compile time from clBuildProgram to completion.");
+  RenderCounter(&out, "rotate_buffer_pool_hits", "cl_mem objects reused.",
+                bufferPoolHits);
+  RenderCounter(&out, "rotate_buffer_pool_misses",
+                "cl_mem objects (re)created.", bufferPoolMisses);
+  RenderCounter(&out, "rotate_kernel_args_set",
+                "clSetKernelArg calls issued through the argument cache.",
+                kernelArgsSet);
+  RenderCounter(&out, "rotate_kernel_args_skipped",
+                "clSetKernelArg calls skipped because the value was unchanged.",
+                kernelArgsSkipped);
+  RenderCounter(&out, "rotate_cpu_fallback_frames",
+                "Frames rotated on the CPU after a device failure.",
+                cpuFallbackFrames);
+  RenderCounter(&out, "rotate_device_failovers",
+                "Switches from the OpenCL device to the CPU path.",
+                deviceFailovers);
+  errors.Render(&out);
+  out.append("# EOF\n");
+  return out;
+}
+
+RotateMetrics &Metrics() {
+  static RotateMetrics metrics;
+  return metrics;
+}
+
+bool WriteMetricsFile(const std::string &path) {
+  std::string tmp = path + ".tmp";
+  {
+    std::ofstream file(tmp.c_str(), std::ios::out | std::ios::trunc);
+    if (!file.is_open()) {
+      std::cout << "Failed to open metrics file: " << tmp << std::endl;
+      return false;
+    }
+    file << Metrics().Render();
+    if (!file.good()) {
+      return false;
+    }
+  }
+  return rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+MetricsFileWriter::MetricsFileWriter() : intervalSeconds_(0), running_(false) {}
+
+MetricsFileWriter::~MetricsFileWriter() { Stop(); }
+
+void MetricsFileWriter::Start(const std::string &path, int intervalSeconds) {
+  if (running_.exchange(true)) {
+    return;
+  }
+  path_ = path;
+  intervalSeconds_ = intervalSeconds > 0 ? intervalSeconds : 1;
+  thread_ = std::thread(&MetricsFileWriter::Loop, this);
+}
+
+void MetricsFileWriter::Stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  thread_.join();
+  WriteMetricsFile(path_);
+}
+
+void MetricsFileWriter::Loop() {
+  int ticks = 0;
+  while (running_.load()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (++ticks >= intervalSeconds_ * 10) {
+      WriteMetricsFile(path_);
+      ticks = 0;
+    }
+  }
+}
+
+MetricsHttpServer::MetricsHttpServer() : listenFd_(-1), running_(false) {}
+
+MetricsHttpServer::~MetricsHttpServer() { Stop(); }
+
+bool MetricsHttpServer::Start(int port) {
+  listenFd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listenFd_ < 0) {
+    std::cout << "socket failed: " << strerror(errno) << std::endl;
+    return false;
+  }
+  int one = 1;
+  setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons((uint16_t)port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(listenFd_, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(listenFd_, 8) != 0) {
+    std::cout << "metrics bind/listen on port " << port
+              << " failed: " << strerror(errno) << std::endl;
+    close(listenFd_);
+    listenFd_ = -1;
+    return false;
+  }
+  std::cout << "metrics on http://127.0.0.1:" << port << "/metrics"
+            << std::endl;
+  running_.store(true);
+  thread_ = std::thread(&MetricsHttpServer::Loop, this);
+  return true;
+}
+
+void MetricsHttpServer::Stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  thread_.join();
+  close(listenFd_);
+  listenFd_ = -1;
+}
+
+void MetricsHttpServer::Loop() {
+  while (running_.load()) {
+    struct pollfd pfd = {listenFd_, POLLIN, 0};
+    if (poll(&pfd, 1, 200) <= 0) {
+      continue;
+    }
+    int fd = accept4(listenFd_, NULL, NULL, SOCK_CLOEXEC);
+    if (fd < 0) {
+      continue;
+    }
+    // 只需要读到请求头结束即可，内容一律忽略
+    char request[1024];
+    struct pollfd cfd = {fd, POLLIN, 0};
+    if (poll(&cfd, 1, 1000) > 0) {
+      recv(fd, request, sizeof(request), 0);
+    }
+    std::string body = Metrics().Render();
+    std::ostringstream resp;
+    resp << "HTTP/1.1 200 OK\r\n"
+         << "Content-Type: application/openmetrics-text; version=1.0.0; "
+            "charset=utf-8\r\n"
+         << "Content-Length: " << body.size() << "\r\n"
+         << "Connection: close\r\n\r\n"
+         << body;
+    std::string data = resp.str();
+    size_t sent = 0;
+    while (sent < data.size()) {
+      ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+      if (n <= 0) {
+        break;
+      }
+      sent += (size_t)n;
+    }
+    close(fd);
+  }
+}
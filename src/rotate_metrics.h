@@ -0,0 +1,147 @@
+#ifndef OPENCL_EXAMPLE_ROTATE_METRICS_H_
+#define OPENCL_EXAMPLE_ROTATE_METRICS_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include <CL/cl.h>
+
+/**
+ * ========== 旋转引擎的运行指标 ==========
+ * 所有指标都是进程级的单例 Metrics()，采集端只做 relaxed 原子加法，没有锁，
+ * 可以常开。导出为 OpenMetrics（Prometheus）文本格式：
+ *  - --metrics-file：写入文件（先写临时文件再 rename，可配合 node_exporter 的 textfile collector）
+ *  - --metrics-port：守护进程模式下在 127.0.0.1 上提供 HTTP GET /metrics
+ */
+
+/**
+ * @brief 单调递增计数器
+ */
+class Counter {
+ public:
+  Counter() : value_(0) {}
+  void Add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+  uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<uint64_t> value_;
+};
+
+/**
+ * @brief 固定分桶的直方图
+ * @note 桶上界在构造时给定（升序，最多 kMaxBuckets 个），另有一个隐含的 +Inf 桶。
+ *       sum 以 1e-9 为单位累加成整数，避免对 double 做 CAS 循环。
+ */
+class Histogram {
+ public:
+  static const size_t kMaxBuckets = 20;
+
+  Histogram(const double *bounds, size_t count);
+  void Observe(double value);
+  void Render(std::string *out, const char *name, const char *help) const;
+
+ private:
+  double bounds_[kMaxBuckets];
+  size_t count_;
+  std::atomic<uint64_t> buckets_[kMaxBuckets + 1];
+  std::atomic<uint64_t> sumNanos_;
+};
+
+/**
+ * @brief 按 cl_int 错误码分类的错误计数
+ * @note 标准错误码在 [-127, -1] 之内直接索引，其余（扩展错误码等）计入 other
+ */
+class ErrorCounter {
+ public:
+  ErrorCounter();
+  void Add(cl_int code);
+  void Render(std::string *out) const;
+
+ private:
+  static const int kCodes = 128;
+  std::atomic<uint64_t> codes_[kCodes];
+  std::atomic<uint64_t> other_;
+};
+
+struct RotateMetrics {
+  RotateMetrics();
+
+  Counter frames;             // 已处理的帧数
+  Counter bytesHostToDevice;  // 显式上传的字节数
+  Counter bytesDeviceToHost;  // 显式读回的字节数
+  Histogram kernelSeconds;    // kernel 执行时间（profiling event 的 START~END）
+  Histogram queueWaitSeconds; // 请求在引擎前面排队的时间
+  Histogram batchSize;        // 每次 launch 合并的帧数
+  Histogram interactiveRequestSeconds;  // 交互请求从提交到完成的时间
+  Histogram bulkRequestSeconds;         // 后台批量请求从提交到完成的时间
+  // 需要从源码编译的次数。还没有 clCreateProgramWithBinary 缓存，所以每次编译都计入
+  Counter buildCacheMisses;
+  Counter buildFailures;      // 编译失败的次数（日志见 RotateEngine::buildLog）
+  Histogram buildSeconds;     // clBuildProgram 从开始到完成回调的时间
+  Counter bufferPoolHits;     // cl_mem 复用的次数
+  Counter bufferPoolMisses;   // 需要重新创建 cl_mem 的次数
+  Counter kernelArgsSet;      // 实际调用 clSetKernelArg 的次数（经过参数缓存的）
+  Counter kernelArgsSkipped;  // 值未变化、被参数缓存省掉的 clSetKernelArg
+  Counter cpuFallbackFrames;  // 设备不可用时在 CPU 上完成的帧
+  Counter deviceFailovers;    // 从设备切换到 CPU 路径的次数
+  ErrorCounter errors;
+
+  /**
+   * @brief 按 OpenMetrics 文本格式输出全部指标（以 "# EOF" 结尾）
+   */
+  std::string Render() const;
+};
+
+/**
+ * @brief 进程级的指标单例
+ */
+RotateMetrics &Metrics();
+
+/**
+ * @brief 把当前指标写入 path（先写 path.tmp 再 rename，读取方不会看到半个文件）
+ */
+bool WriteMetricsFile(const std::string &path);
+
+/**
+ * @brief 后台线程每隔 intervalSeconds 调用一次 WriteMetricsFile，Stop 时再写最后一次
+ */
+class MetricsFileWriter {
+ public:
+  MetricsFileWriter();
+  ~MetricsFileWriter();
+
+  void Start(const std::string &path, int intervalSeconds);
+  void Stop();
+
+ private:
+  void Loop();
+
+  std::string path_;
+  int intervalSeconds_;
+  std::atomic<bool> running_;
+  std::thread thread_;
+};
+
+/**
+ * @brief 极简的 HTTP 导出端，只监听 127.0.0.1，任何 GET 请求都返回全部指标
+ */
+class MetricsHttpServer {
+ public:
+  MetricsHttpServer();
+  ~MetricsHttpServer();
+
+  bool Start(int port);
+  void Stop();
+
+ private:
+  void Loop();
+
+  int listenFd_;
+  std::atomic<bool> running_;
+  std::thread thread_;
+};
+
+#endif  // OPENCL_EXAMPLE_ROTATE_METRICS_H_
@@ -0,0 +1,273 @@
+#include "rotate_pipeline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "rotate_angle.h"
+#include "rotate_metrics.h"
+#include "rotate_trace.h"
+
+RotatePipeline::RotatePipeline(RotateEngine *engine)
+    : engine_(engine),
+      kernel_(NULL),
+      in_(NULL),
+      out_(NULL),
+      width_(0),
+      height_(0),
+      sinTheta_(0),
+      cosTheta_(1),
+      background_(0),
+      commandBuffer_(NULL),
+#ifdef cl_khr_command_buffer
+      createCommandBuffer_(NULL),
+      commandFillBuffer_(NULL),
+      commandNDRangeKernel_(NULL),
+      finalizeCommandBuffer_(NULL),
+      enqueueCommandBuffer_(NULL),
+      releaseCommandBuffer_(NULL),
+#endif
+      frames_(0),
+      submitNanos_(0),
+      maxSubmitNanos_(0) {
+}
+
+RotatePipeline::~RotatePipeline() { Release(); }
+
+cl_int RotatePipeline::Record(int w, int h, float sinTheta, float cosTheta,
+                              bool useCommandBuffer) {
+  Release();
+  if (w <= 0 || h <= 0 || !engine_->ready()) {
+    return CL_INVALID_VALUE;
+  }
+  ROTATE_TRACE_SCOPE("RotatePipeline::Record");
+  width_ = w;
+  height_ = h;
+  sinTheta_ = sinTheta;
+  cosTheta_ = cosTheta;
+  background_ = engine_->background();
+  size_t bytes = (size_t)w * h * sizeof(int);
+
+  // 1. 常驻 buffer 和私有 kernel 对象，参数只设置这一次
+  cl_int status = CL_SUCCESS;
+  in_ = clCreateBuffer(engine_->context(), CL_MEM_READ_ONLY, bytes, NULL,
+                       &status);
+  if (status == CL_SUCCESS) {
+    out_ = clCreateBuffer(engine_->context(), CL_MEM_READ_WRITE, bytes, NULL,
+                          &status);
+  }
+  if (status != CL_SUCCESS) {
+    std::cout << "clCreateBuffer failed." << std::endl;
+    Release();
+    return status;
+  }
+  kernel_ = clCreateKernel(engine_->program(), "image_rotate", &status);
+  if (status != CL_SUCCESS) {
+    std::cout << "clCreateKernel failed." << std::endl;
+    kernel_ = NULL;
+    Release();
+    return status;
+  }
+  cl_int widthParam = w;
+  cl_int heightParam = h;
+  cl_float sinParam = sinTheta;
+  cl_float cosParam = cosTheta;
+  status = clSetKernelArg(kernel_, 0, sizeof(cl_mem), &in_);
+  status |= clSetKernelArg(kernel_, 1, sizeof(cl_mem), &out_);
+  status |= clSetKernelArg(kernel_, 2, sizeof(cl_int), &widthParam);
+  status |= clSetKernelArg(kernel_, 3, sizeof(cl_int), &heightParam);
+  status |= clSetKernelArg(kernel_, 4, sizeof(cl_float), &sinParam);
+  status |= clSetKernelArg(kernel_, 5, sizeof(cl_float), &cosParam);
+  status |= clSetKernelArg(kernel_, 6, sizeof(cl_int), &widthParam);
+  status |= clSetKernelArg(kernel_, 7, sizeof(cl_int), &widthParam);
+  if (status != CL_SUCCESS) {
+    std::cout << "clSetKernelArg failed." << std::endl;
+    Release();
+    return CL_INVALID_ARG_VALUE;
+  }
+
+  // 2. 命令列表：旋转写满输出时省掉填充
+  if (!RotationCoversOutput(w, h, sinTheta, cosTheta)) {
+    Command fill;
+    fill.kind = Command::kFill;
+    fill.bytes = bytes;
+    commands_.push_back(fill);
+  }
+  Command kernel;
+  kernel.kind = Command::kKernel;
+  kernel.bytes = 0;
+  commands_.push_back(kernel);
+
+  // 3. 能用 command buffer 时把命令列表录制进去，失败则保留命令列表
+  if (useCommandBuffer && engine_->HasExtension("cl_khr_command_buffer")) {
+    if (RecordCommandBuffer() != CL_SUCCESS) {
+      std::cout << "cl_khr_command_buffer recording failed, using the "
+                   "pre-validated command list."
+                << std::endl;
+    }
+  }
+  return CL_SUCCESS;
+}
+
+cl_int RotatePipeline::RecordCommandBuffer() {
+#ifdef cl_khr_command_buffer
+  cl_platform_id platform = engine_->platform();
+  createCommandBuffer_ =
+      (clCreateCommandBufferKHR_fn)clGetExtensionFunctionAddressForPlatform(
+          platform, "clCreateCommandBufferKHR");
+  commandFillBuffer_ =
+      (clCommandFillBufferKHR_fn)clGetExtensionFunctionAddressForPlatform(
+          platform, "clCommandFillBufferKHR");
+  commandNDRangeKernel_ =
+      (clCommandNDRangeKernelKHR_fn)clGetExtensionFunctionAddressForPlatform(
+          platform, "clCommandNDRangeKernelKHR");
+  finalizeCommandBuffer_ =
+      (clFinalizeCommandBufferKHR_fn)clGetExtensionFunctionAddressForPlatform(
+          platform, "clFinalizeCommandBufferKHR");
+  enqueueCommandBuffer_ =
+      (clEnqueueCommandBufferKHR_fn)clGetExtensionFunctionAddressForPlatform(
+          platform, "clEnqueueCommandBufferKHR");
+  releaseCommandBuffer_ =
+      (clReleaseCommandBufferKHR_fn)clGetExtensionFunctionAddressForPlatform(
+          platform, "clReleaseCommandBufferKHR");
+  if (createCommandBuffer_ == NULL || commandFillBuffer_ == NULL ||
+      commandNDRangeKernel_ == NULL || finalizeCommandBuffer_ == NULL ||
+      enqueueCommandBuffer_ == NULL || releaseCommandBuffer_ == NULL) {
+    return CL_INVALID_OPERATION;
+  }
+
+  cl_command_queue queue = engine_->queue();
+  cl_int status = CL_SUCCESS;
+  cl_command_buffer_khr commandBuffer =
+      createCommandBuffer_(1, &queue, NULL, &status);
+  if (status != CL_SUCCESS) {
+    return status;
+  }
+  // 录制时不指定 queue（NULL 表示创建时的那一个），命令之间用 sync point 串起来
+  cl_sync_point_khr last = 0;
+  bool hasLast = false;
+  size_t globalThreads[2] = {(size_t)width_, (size_t)height_};
+  for (size_t i = 0; i < commands_.size() && status == CL_SUCCESS; i++) {
+    cl_sync_point_khr point = 0;
+    if (commands_[i].kind == Command::kFill) {
+      status = commandFillBuffer_(commandBuffer, NULL, NULL, out_,
+                                  &background_, sizeof(background_), 0,
+                                  commands_[i].bytes, hasLast ? 1 : 0,
+                                  hasLast ? &last : NULL, &point, NULL);
+    } else {
+      status = commandNDRangeKernel_(commandBuffer, NULL, NULL, kernel_, 2,
+                                     NULL, globalThreads, NULL,
+                                     hasLast ? 1 : 0, hasLast ? &last : NULL,
+                                     &point, NULL);
+    }
+    last = point;
+    hasLast = true;
+  }
+  if (status == CL_SUCCESS) {
+    status = finalizeCommandBuffer_(commandBuffer);
+  }
+  if (status != CL_SUCCESS) {
+    releaseCommandBuffer_(commandBuffer);
+    return status;
+  }
+  commandBuffer_ = commandBuffer;
+  return CL_SUCCESS;
+#else
+  return CL_INVALID_OPERATION;
+#endif
+}
+
+cl_int RotatePipeline::EnqueueCommands() {
+#ifdef cl_khr_command_buffer
+  if (commandBuffer_ != NULL) {
+    cl_command_queue queue = engine_->queue();
+    return enqueueCommandBuffer_(1, &queue, commandBuffer_, 0, NULL, NULL);
+  }
+#endif
+  cl_command_queue queue = engine_->queue();
+  size_t globalThreads[2] = {(size_t)width_, (size_t)height_};
+  cl_int status = CL_SUCCESS;
+  for (size_t i = 0; i < commands_.size() && status == CL_SUCCESS; i++) {
+    if (commands_[i].kind == Command::kFill) {
+      status = clEnqueueFillBuffer(queue, out_, &background_,
+                                   sizeof(background_), 0, commands_[i].bytes,
+                                   0, NULL, NULL);
+    } else {
+      status = clEnqueueNDRangeKernel(queue, kernel_, 2, NULL, globalThreads,
+                                      NULL, 0, NULL, NULL);
+    }
+  }
+  return status;
+}
+
+cl_int RotatePipeline::Run(const int *in, int *out) {
+  if (!recorded()) {
+    return CL_INVALID_OPERATION;
+  }
+  ROTATE_TRACE_SCOPE("RotatePipeline::Run");
+  size_t bytes = (size_t)width_ * height_ * sizeof(int);
+  cl_command_queue queue = engine_->queue();
+  // 只统计入队调用本身：三次调用都是非阻塞的，设备执行时间由 clFinish 承担
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  cl_int status = clEnqueueWriteBuffer(queue, in_, CL_FALSE, 0, bytes, in, 0,
+                                       NULL, NULL);
+  if (status == CL_SUCCESS) {
+    status = EnqueueCommands();
+  }
+  if (status == CL_SUCCESS) {
+    status = clEnqueueReadBuffer(queue, out_, CL_FALSE, 0, bytes, out, 0, NULL,
+                                 NULL);
+  }
+  uint64_t nanos = (uint64_t)std::chrono::duration_cast<
+                       std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  cl_int finishStatus = clFinish(queue);
+  if (status != CL_SUCCESS) {
+    std::cout << "RotatePipeline enqueue failed: " << status << std::endl;
+    return status;
+  }
+  if (finishStatus != CL_SUCCESS) {
+    std::cout << "clFinish failed." << std::endl;
+    return finishStatus;
+  }
+  frames_++;
+  submitNanos_ += nanos;
+  maxSubmitNanos_ = std::max(maxSubmitNanos_, nanos);
+  Metrics().frames.Add();
+  Metrics().batchSize.Observe(1);
+  Metrics().bytesHostToDevice.Add(bytes);
+  Metrics().bytesDeviceToHost.Add(bytes);
+  return CL_SUCCESS;
+}
+
+void RotatePipeline::Release() {
+#ifdef cl_khr_command_buffer
+  if (commandBuffer_ != NULL) releaseCommandBuffer_(commandBuffer_);
+#endif
+  if (kernel_ != NULL) clReleaseKernel(kernel_);
+  if (in_ != NULL) clReleaseMemObject(in_);
+  if (out_ != NULL) clReleaseMemObject(out_);
+  commandBuffer_ = NULL;
+  kernel_ = NULL;
+  in_ = NULL;
+  out_ = NULL;
+  commands_.clear();
+  frames_ = 0;
+  submitNanos_ = 0;
+  maxSubmitNanos_ = 0;
+}
+
+void RotatePipeline::PrintStats(std::ostream &os) const {
+  os << "pipeline: "
+     << (usesCommandBuffer() ? "cl_khr_command_buffer"
+                             : "pre-validated command list")
+     << ", " << commands_.size() + 2 << " commands per frame";
+  if (frames_ > 0) {
+    os << ", submit overhead mean " << submitNanos_ / 1000.0 / frames_
+       << " us, max " << maxSubmitNanos_ / 1000.0 << " us over " << frames_
+       << " frames";
+  }
+  os << std::endl;
+}
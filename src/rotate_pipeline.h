@@ -0,0 +1,92 @@
+#ifndef OPENCL_EXAMPLE_ROTATE_PIPELINE_H_
+#define OPENCL_EXAMPLE_ROTATE_PIPELINE_H_
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include <CL/cl.h>
+#include <CL/cl_ext.h>
+
+#include "rotate_engine.h"
+
+/**
+ * ========== 录制的旋转流水线 ==========
+ * 尺寸和角度固定、逐帧重复的旋转，每帧的入队序列完全相同：上传、背景填充、kernel、读回。
+ * Record() 只做一次：创建常驻的输入/输出 buffer 和流水线私有的 kernel 对象，
+ * 参数一次设好，之后每帧只换 buffer 的内容，不再调用 clSetKernelArg。
+ *  - 设备支持 cl_khr_command_buffer 时，把填充和 kernel 录制成 command buffer，
+ *    每帧 clEnqueueCommandBufferKHR 回放一次，驱动不需要重新校验和翻译命令
+ *    （扩展不能录制 host 读写，所以上传/读回仍然单独入队）
+ *  - 不支持时退化为 host 端预先校验过的命令列表，逐条入队，同样不重设参数
+ * 每帧统计 host 花在入队调用上的时间（不含等待设备完成），用于比较两种方式的提交开销。
+ */
+class RotatePipeline {
+ public:
+  explicit RotatePipeline(RotateEngine *engine);
+  ~RotatePipeline();
+
+  RotatePipeline(const RotatePipeline &) = delete;
+  RotatePipeline &operator=(const RotatePipeline &) = delete;
+
+  /**
+   * @brief 按 w*h、固定角度录制流水线，已有的录制会先释放
+   * @param useCommandBuffer false 时即使设备支持也使用命令列表（用于对比）
+   */
+  cl_int Record(int w, int h, float sinTheta, float cosTheta,
+                bool useCommandBuffer);
+
+  /**
+   * @brief 旋转一帧：in/out 为紧密排列的 w*h 个像素，返回时 out 中已是结果
+   */
+  cl_int Run(const int *in, int *out);
+
+  void Release();
+
+  bool recorded() const { return kernel_ != NULL; }
+  bool usesCommandBuffer() const { return commandBuffer_ != NULL; }
+
+  /**
+   * @brief 打印流水线类型以及每帧提交开销（入队调用的 host 耗时）
+   */
+  void PrintStats(std::ostream &os) const;
+
+ private:
+  // 预先校验过的命令：Record 时检查参数，Run 时逐条直接入队
+  struct Command {
+    enum Kind { kFill, kKernel } kind;
+    size_t bytes;  // kFill：填充的字节数
+  };
+
+  cl_int RecordCommandBuffer();
+  cl_int EnqueueCommands();
+
+  RotateEngine *engine_;
+  cl_kernel kernel_;
+  cl_mem in_;
+  cl_mem out_;
+  int width_;
+  int height_;
+  float sinTheta_;
+  float cosTheta_;
+  int background_;
+  std::vector<Command> commands_;
+
+#ifdef cl_khr_command_buffer
+  cl_command_buffer_khr commandBuffer_;
+  clCreateCommandBufferKHR_fn createCommandBuffer_;
+  clCommandFillBufferKHR_fn commandFillBuffer_;
+  clCommandNDRangeKernelKHR_fn commandNDRangeKernel_;
+  clFinalizeCommandBufferKHR_fn finalizeCommandBuffer_;
+  clEnqueueCommandBufferKHR_fn enqueueCommandBuffer_;
+  clReleaseCommandBufferKHR_fn releaseCommandBuffer_;
+#else
+  void *commandBuffer_;  // 头文件没有 cl_khr_command_buffer，始终为 NULL
+#endif
+
+  uint64_t frames_;
+  uint64_t submitNanos_;
+  uint64_t maxSubmitNanos_;
+};
+
+#endif  // OPENCL_EXAMPLE_ROTATE_PIPELINE_H_
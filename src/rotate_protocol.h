@@ -0,0 +1,63 @@
+#ifndef OPENCL_EXAMPLE_ROTATE_PROTOCOL_H_
+#define OPENCL_EXAMPLE_ROTATE_PROTOCOL_H_
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * ========== opencl_rotate 守护进程协议 ==========
+ * 传输层使用 AF_UNIX + SOCK_SEQPACKET，一个请求/响应就是一个报文，不需要自己分帧。
+ * 图像数据不走socket，而是放在客户端创建的 memfd 共享内存中：
+ *  - 客户端在第一次请求（或共享内存变化时）通过 SCM_RIGHTS 把 memfd 传给守护进程
+ *  - memfd 必须带有 F_SEAL_SHRINK 封印（memfd_create 时指定 MFD_ALLOW_SEALING），
+ *    且 shmSize 不能超过文件大小，否则请求返回 CL_INVALID_VALUE
+ *  - 守护进程 mmap 之后直接用 CL_MEM_USE_HOST_PTR 包装成 cl_mem，全程零拷贝
+ *  - 输入和输出分别位于 inOffset / outOffset 处，建议按页对齐
+ *  - inPitch / outPitch 为行跨度（像素），0 表示紧密排列；解码器给出的带填充的帧
+ *    可以直接放进共享内存，不需要重新排列
+ *  - priority 为 kRotatePriorityBulk 的请求按后台批量处理（见 BatchScheduler），
+ *    不会挡住交互请求
+ */
+
+static const uint32_t kRotateMagic = 0x33544f52;  // "ROT3"
+static const char *const kDefaultSocketPath = "/tmp/opencl_rotate.sock";
+// 守护进程的提交队列已满（背压），与 BatchScheduler::kBusy 相同
+static const int32_t kRotateBusy = 1;
+// 请求优先级，取值与 RotatePriority 相同
+static const int32_t kRotatePriorityInteractive = 0;
+static const int32_t kRotatePriorityBulk = 1;
+
+struct RotateRequest {
+  uint32_t magic;
+  uint32_t id;
+  int32_t width;
+  int32_t height;
+  float sinTheta;
+  float cosTheta;
+  uint64_t shmSize;  // 本次附带的 memfd 大小，没有附带 fd 时忽略
+  uint64_t inOffset;
+  uint64_t outOffset;
+  int32_t inPitch;
+  int32_t outPitch;
+  int32_t priority;
+};
+
+struct RotateResponse {
+  uint32_t magic;
+  uint32_t id;
+  int32_t status;  // cl_int 错误码，CL_SUCCESS 表示成功，kRotateBusy 表示需要稍后重试
+  uint32_t micros;  // 守护进程内部处理耗时
+};
+
+/**
+ * @brief 发送一个报文，fd >= 0 时通过 SCM_RIGHTS 一起发送该文件描述符
+ */
+bool SendMessage(int sock, const void *buf, size_t len, int fd);
+
+/**
+ * @brief 接收一个报文，如果报文附带了文件描述符则写入 *fd，否则 *fd = -1
+ * @return 收到的字节数，对端关闭返回 0，出错返回 -1
+ */
+long RecvMessage(int sock, void *buf, size_t len, int *fd);
+
+#endif  // OPENCL_EXAMPLE_ROTATE_PROTOCOL_H_
@@ -0,0 +1,196 @@
+#include "rotate_resample.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+const char *RotateSamplingName(RotateSampling sampling) {
+  switch (sampling) {
+    case kSampleBilinear:
+      return "bilinear";
+    case kSampleLanczos3:
+      return "lanczos3";
+    case kSampleArea:
+      return "area";
+    default:
+      return "unknown";
+  }
+}
+
+bool ParseRotateSampling(const std::string &name, RotateSampling *sampling) {
+  for (int i = 0; i < kRotateSamplingCount; i++) {
+    if (name == RotateSamplingName((RotateSampling)i)) {
+      *sampling = (RotateSampling)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+static double Lanczos3(double x) {
+  const double kPi = 3.14159265358979323846;
+  if (x == 0) {
+    return 1;
+  }
+  if (std::fabs(x) >= 3) {
+    return 0;
+  }
+  return 3 * std::sin(kPi * x) * std::sin(kPi * x / 3) / (kPi * kPi * x * x);
+}
+
+void BuildResampleWeights(RotateSampling sampling, float sinTheta,
+                          float cosTheta, std::vector<float> *weights) {
+  weights->clear();
+  if (sampling == kSampleLanczos3) {
+    // 第 i 个抽头是源像素 x0 - 2 + i，与采样点的距离为 (i - 2) - 小数部分
+    weights->resize((kLanczosPhases + 1) * kLanczosTaps);
+    for (int p = 0; p <= kLanczosPhases; p++) {
+      double frac = (double)p / kLanczosPhases;
+      double w[kLanczosTaps];
+      double sum = 0;
+      for (int i = 0; i < kLanczosTaps; i++) {
+        w[i] = Lanczos3((i - 2) - frac);
+        sum += w[i];
+      }
+      for (int i = 0; i < kLanczosTaps; i++) {
+        (*weights)[p * kLanczosTaps + i] = (float)(w[i] / sum);
+      }
+    }
+  } else if (sampling == kSampleArea) {
+    // 输出像素方块 (u, v) ∈ [-0.5, 0.5]^2 逆旋转后落在源图上的位置为
+    // (u*cos + v*sin, -u*sin + v*cos)，在方块内均匀取 kSamples^2 个点统计落在各源像素的比例。
+    // 方块中心在 [0, 1]^2 内时半对角线 0.71 不会超出 x0-1 .. x0+2，4x4 个抽头足够
+    const int kSamples = 32;
+    const int entries = (kAreaPhases + 1) * (kAreaPhases + 1);
+    weights->assign((size_t)entries * kAreaTaps * kAreaTaps, 0.0f);
+    for (int py = 0; py <= kAreaPhases; py++) {
+      for (int px = 0; px <= kAreaPhases; px++) {
+        float *w = weights->data() +
+                   (size_t)(py * (kAreaPhases + 1) + px) * kAreaTaps * kAreaTaps;
+        double cx = (double)px / kAreaPhases;
+        double cy = (double)py / kAreaPhases;
+        int counts[kAreaTaps * kAreaTaps] = {};
+        for (int j = 0; j < kSamples; j++) {
+          double v = (j + 0.5) / kSamples - 0.5;
+          for (int i = 0; i < kSamples; i++) {
+            double u = (i + 0.5) / kSamples - 0.5;
+            double x = cx + u * cosTheta + v * sinTheta;
+            double y = cy - u * sinTheta + v * cosTheta;
+            int tx = (int)std::floor(x + 0.5) + 1;
+            int ty = (int)std::floor(y + 0.5) + 1;
+            tx = std::min(std::max(tx, 0), kAreaTaps - 1);
+            ty = std::min(std::max(ty, 0), kAreaTaps - 1);
+            counts[ty * kAreaTaps + tx]++;
+          }
+        }
+        for (int t = 0; t < kAreaTaps * kAreaTaps; t++) {
+          w[t] = (float)counts[t] / (kSamples * kSamples);
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief 取一个源像素的 4 个通道，图外返回背景
+ */
+static inline void LoadPixel(const int *inbuf, int inPitch, int w, int h,
+                             int x, int y, const float *background,
+                             float *px) {
+  if (x < 0 || x >= w || y < 0 || y >= h) {
+    memcpy(px, background, 4 * sizeof(float));
+    return;
+  }
+  unsigned char bytes[4];
+  memcpy(bytes, &inbuf[(size_t)y * inPitch + x], 4);
+  for (int c = 0; c < 4; c++) {
+    px[c] = bytes[c];
+  }
+}
+
+void RotateCpuResampled(const int *inbuf, int inPitch, int *outbuf,
+                        int outPitch, int w, int h, float sinTheta,
+                        float cosTheta, RotateSampling sampling,
+                        int background) {
+  std::vector<float> weights;
+  BuildResampleWeights(sampling, sinTheta, cosTheta, &weights);
+  unsigned char bgBytes[4];
+  memcpy(bgBytes, &background, 4);
+  float bg[4];
+  for (int c = 0; c < 4; c++) {
+    bg[c] = bgBytes[c];
+  }
+  const float xc = (float)(w / 2);
+  const float yc = (float)(h / 2);
+  for (int oy = 0; oy < h; oy++) {
+    for (int ox = 0; ox < w; ox++) {
+      int *dst = &outbuf[(size_t)oy * outPitch + ox];
+      const float dx = ox - xc;
+      const float dy = oy - yc;
+      const float sx = dx * cosTheta + dy * sinTheta + xc;
+      const float sy = -dx * sinTheta + dy * cosTheta + yc;
+      if (sx < -0.5f || sx > w - 0.5f || sy < -0.5f || sy > h - 0.5f) {
+        *dst = background;
+        continue;
+      }
+      const float fx = std::floor(sx);
+      const float fy = std::floor(sy);
+      const int x0 = (int)fx;
+      const int y0 = (int)fy;
+      const float ax = sx - fx;
+      const float ay = sy - fy;
+      float acc[4] = {0, 0, 0, 0};
+      float px[4];
+      if (sampling == kSampleLanczos3) {
+        const float *wx =
+            &weights[(int)(ax * kLanczosPhases + 0.5f) * kLanczosTaps];
+        const float *wy =
+            &weights[(int)(ay * kLanczosPhases + 0.5f) * kLanczosTaps];
+        for (int j = 0; j < kLanczosTaps; j++) {
+          float row[4] = {0, 0, 0, 0};
+          for (int i = 0; i < kLanczosTaps; i++) {
+            LoadPixel(inbuf, inPitch, w, h, x0 - 2 + i, y0 - 2 + j, bg, px);
+            for (int c = 0; c < 4; c++) {
+              row[c] += wx[i] * px[c];
+            }
+          }
+          for (int c = 0; c < 4; c++) {
+            acc[c] += wy[j] * row[c];
+          }
+        }
+      } else if (sampling == kSampleArea) {
+        const int px0 = (int)(ax * kAreaPhases + 0.5f);
+        const int py0 = (int)(ay * kAreaPhases + 0.5f);
+        const float *wt =
+            &weights[(size_t)(py0 * (kAreaPhases + 1) + px0) * kAreaTaps *
+                     kAreaTaps];
+        for (int j = 0; j < kAreaTaps; j++) {
+          for (int i = 0; i < kAreaTaps; i++) {
+            LoadPixel(inbuf, inPitch, w, h, x0 - 1 + i, y0 - 1 + j, bg, px);
+            for (int c = 0; c < 4; c++) {
+              acc[c] += wt[j * kAreaTaps + i] * px[c];
+            }
+          }
+        }
+      } else {
+        const float wx[2] = {1 - ax, ax};
+        const float wy[2] = {1 - ay, ay};
+        for (int j = 0; j < 2; j++) {
+          for (int i = 0; i < 2; i++) {
+            LoadPixel(inbuf, inPitch, w, h, x0 + i, y0 + j, bg, px);
+            for (int c = 0; c < 4; c++) {
+              acc[c] += wy[j] * wx[i] * px[c];
+            }
+          }
+        }
+      }
+      unsigned char bytes[4];
+      for (int c = 0; c < 4; c++) {
+        // 与 convert_uchar4_sat_rte 相同：就近舍入（平局取偶）并截断
+        float v = std::nearbyint(acc[c]);
+        bytes[c] = (unsigned char)std::min(255.0f, std::max(0.0f, v));
+      }
+      memcpy(dst, bytes, 4);
+    }
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef OPENCL_EXAMPLE_ROTATE_RESAMPLE_H_
+#define OPENCL_EXAMPLE_ROTATE_RESAMPLE_H_
+
+#include <string>
+#include <vector>
+
+/**
+ * ========== 高质量重采样旋转 ==========
+ * image_rotate 等 kernel 是正向映射：源像素取整后写到目标位置，有空洞和锯齿。
+ * 重采样旋转改为反向映射（gather）：每个输出像素逆旋转回源图上的实数坐标，
+ * 再用滤波器对周围的源像素加权求和，输出的每个像素都会被写到。
+ * 像素按 4 个 8 位通道（int 的 4 个字节，与 uchar4 相同）分别滤波，结果四舍五入并截断到
+ * [0, 255]。逆映射落在源图外超过半个像素的输出像素取背景值；滤波窗口中图外的源像素
+ * 也按背景值参与计算，所以图像边缘会与背景平滑过渡。
+ *  - bilinear：2x2，权重直接由小数部分计算
+ *  - lanczos3：6x6，可分离，一维权重按 1/kLanczosPhases 像素的相位预先算好
+ *  - area：旋转后的输出像素方块与源像素的覆盖面积，4x4，不可分离，
+ *    权重与角度有关，按 kAreaPhases x kAreaPhases 个相位预先算好
+ * 权重表由 BuildResampleWeights 生成，设备端放在 constant 内存里。
+ */
+enum RotateSampling {
+  kSampleBilinear = 0,
+  kSampleLanczos3 = 1,
+  kSampleArea = 2,
+  kRotateSamplingCount
+};
+
+// 相位数，权重表有 phases + 1 项（小数部分四舍五入到最近的相位，1.0 也是一项）
+static const int kLanczosPhases = 64;
+static const int kLanczosTaps = 6;
+static const int kAreaPhases = 8;
+static const int kAreaTaps = 4;
+
+const char *RotateSamplingName(RotateSampling sampling);
+bool ParseRotateSampling(const std::string &name, RotateSampling *sampling);
+
+/**
+ * @brief 生成 sampling 的权重表，与 rotate.cl 中 image_rotate_resample 的查表方式一致
+ * @note lanczos3：(kLanczosPhases + 1) 行，每行 kLanczosTaps 个权重，和为 1，与角度无关；
+ *       area：(kAreaPhases + 1)^2 项，每项 kAreaTaps^2 个权重（行优先），和为 1；
+ *       bilinear 不需要权重表，weights 为空
+ */
+void BuildResampleWeights(RotateSampling sampling, float sinTheta,
+                          float cosTheta, std::vector<float> *weights);
+
+/**
+ * @brief 重采样旋转的 CPU 参考实现，与 image_rotate_resample 的计算顺序相同
+ * @note inPitch / outPitch 以像素计；设备端的浮点运算（例如 FMA 合并）可能让个别
+ *       通道相差 1
+ */
+void RotateCpuResampled(const int *inbuf, int inPitch, int *outbuf,
+                        int outPitch, int w, int h, float sinTheta,
+                        float cosTheta, RotateSampling sampling,
+                        int background);
+
+#endif  // OPENCL_EXAMPLE_ROTATE_RESAMPLE_H_
@@ -0,0 +1,230 @@
+#include "rotate_roofline.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+static const int kPeakRepeats = 5;
+static const size_t kCopyBytes = (size_t)64 << 20;
+static const size_t kFmaItems = (size_t)1 << 18;
+// 与 roofline.cl 中 roofline_fma 保持一致：256 次迭代 * 4 条 float4 链 * 4 分量 * 2 FLOP
+static const double kFmaFlopsPerItem = 256.0 * 4 * 4 * 2;
+
+/**
+ * @brief 重复执行 kernel，返回最短的一次 profiling 时间（秒）
+ */
+static cl_int BestKernelSeconds(cl_command_queue queue, cl_kernel kernel,
+                                size_t globalSize, double *seconds) {
+  *seconds = 0;
+  for (int i = 0; i < kPeakRepeats; i++) {
+    cl_event event = NULL;
+    cl_int status = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &globalSize,
+                                           NULL, 0, NULL, &event);
+    if (status != CL_SUCCESS) {
+      std::cout << "clEnqueueNDRangeKernel failed." << std::endl;
+      return status;
+    }
+    status = clWaitForEvents(1, &event);
+    cl_ulong start = 0;
+    cl_ulong end = 0;
+    if (status == CL_SUCCESS) {
+      status = clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START,
+                                       sizeof(start), &start, NULL);
+      status |= clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END,
+                                        sizeof(end), &end, NULL);
+    }
+    clReleaseEvent(event);
+    if (status != CL_SUCCESS) {
+      std::cout << "clGetEventProfilingInfo failed." << std::endl;
+      return CL_PROFILING_INFO_NOT_AVAILABLE;
+    }
+    double s = (end - start) * 1e-9;
+    if (s > 0 && (*seconds == 0 || s < *seconds)) {
+      *seconds = s;
+    }
+  }
+  return *seconds > 0 ? CL_SUCCESS : CL_PROFILING_INFO_NOT_AVAILABLE;
+}
+
+cl_int MeasureDevicePeaks(cl_context context, cl_device_id device,
+                          cl_command_queue queue, const std::string &kernelPath,
+                          DevicePeaks *peaks) {
+  std::ifstream kernelFile(kernelPath.c_str(), std::ios::in);
+  if (!kernelFile.is_open()) {
+    std::cout << "Failed to open kernel file: " << kernelPath << std::endl;
+    return CL_INVALID_VALUE;
+  }
+  std::stringstream ss;
+  ss << kernelFile.rdbuf();
+  std::string source = ss.str();
+  const char *sourceCStr = source.c_str();
+
+  cl_int status = CL_SUCCESS;
+  cl_program program = NULL;
+  cl_kernel copyKernel = NULL;
+  cl_kernel fmaKernel = NULL;
+  cl_mem src = NULL;
+  cl_mem dst = NULL;
+  cl_mem fmaOut = NULL;
+  cl_ulong maxAlloc = 0;
+  size_t copyBytes = kCopyBytes;
+  double seconds = 0;
+  cl_float a = 0.999f;
+  cl_float b = 0.001f;
+
+  // 1. 编译 micro-kernel
+  program = clCreateProgramWithSource(context, 1, &sourceCStr, NULL, &status);
+  if (status != CL_SUCCESS) {
+    std::cout << "clCreateProgramWithSource failed." << std::endl;
+    goto cleanup;
+  }
+  status = clBuildProgram(program, 1, &device, NULL, NULL, NULL);
+  if (status != CL_SUCCESS) {
+    std::cout << "clBuildProgram(roofline) failed." << std::endl;
+    goto cleanup;
+  }
+  copyKernel = clCreateKernel(program, "roofline_copy", &status);
+  if (status != CL_SUCCESS) {
+    std::cout << "clCreateKernel(roofline_copy) failed." << std::endl;
+    goto cleanup;
+  }
+  fmaKernel = clCreateKernel(program, "roofline_fma", &status);
+  if (status != CL_SUCCESS) {
+    std::cout << "clCreateKernel(roofline_fma) failed." << std::endl;
+    goto cleanup;
+  }
+
+  // 2. 带宽：拷贝 copyBytes，读写各一次
+  clGetDeviceInfo(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(maxAlloc),
+                  &maxAlloc, NULL);
+  if (maxAlloc > 0 && maxAlloc < copyBytes) {
+    copyBytes = (size_t)maxAlloc & ~(size_t)15;
+  }
+  src = clCreateBuffer(context, CL_MEM_READ_ONLY, copyBytes, NULL, &status);
+  if (status == CL_SUCCESS) {
+    dst = clCreateBuffer(context, CL_MEM_WRITE_ONLY, copyBytes, NULL, &status);
+  }
+  if (status != CL_SUCCESS) {
+    std::cout << "clCreateBuffer failed." << std::endl;
+    goto cleanup;
+  }
+  status = clSetKernelArg(copyKernel, 0, sizeof(cl_mem), &src);
+  status |= clSetKernelArg(copyKernel, 1, sizeof(cl_mem), &dst);
+  if (status != CL_SUCCESS) {
+    std::cout << "clSetKernelArg failed." << std::endl;
+    status = CL_INVALID_ARG_VALUE;
+    goto cleanup;
+  }
+  status = BestKernelSeconds(queue, copyKernel, copyBytes / 16, &seconds);
+  if (status != CL_SUCCESS) {
+    goto cleanup;
+  }
+  peaks->bytesPerSecond = 2.0 * copyBytes / seconds;
+
+  // 3. 算力：纯寄存器内的 mad 链
+  fmaOut = clCreateBuffer(context, CL_MEM_WRITE_ONLY, kFmaItems * sizeof(cl_float),
+                          NULL, &status);
+  if (status != CL_SUCCESS) {
+    std::cout << "clCreateBuffer failed." << std::endl;
+    goto cleanup;
+  }
+  status = clSetKernelArg(fmaKernel, 0, sizeof(cl_mem), &fmaOut);
+  status |= clSetKernelArg(fmaKernel, 1, sizeof(cl_float), &a);
+  status |= clSetKernelArg(fmaKernel, 2, sizeof(cl_float), &b);
+  if (status != CL_SUCCESS) {
+    std::cout << "clSetKernelArg failed." << std::endl;
+    status = CL_INVALID_ARG_VALUE;
+    goto cleanup;
+  }
+  status = BestKernelSeconds(queue, fmaKernel, kFmaItems, &seconds);
+  if (status != CL_SUCCESS) {
+    goto cleanup;
+  }
+  peaks->flopsPerSecond = kFmaFlopsPerItem * kFmaItems / seconds;
+
+cleanup:
+  if (fmaOut != NULL) clReleaseMemObject(fmaOut);
+  if (dst != NULL) clReleaseMemObject(dst);
+  if (src != NULL) clReleaseMemObject(src);
+  if (fmaKernel != NULL) clReleaseKernel(fmaKernel);
+  if (copyKernel != NULL) clReleaseKernel(copyKernel);
+  if (program != NULL) clReleaseProgram(program);
+  return status;
+}
+
+KernelTraffic RotateKernelTraffic(int w, int h, float sinTheta,
+                                  float cosTheta) {
+  // 与 image_rotate 相同的映射，统计落在图像内的像素比例
+  int xc = w / 2;
+  int yc = h / 2;
+  size_t hits = 0;
+  for (int i = 0; i < h; i++) {
+    for (int j = 0; j < w; j++) {
+      int xpos = (j - xc) * cosTheta - (i - yc) * sinTheta + xc;
+      int ypos = (j - xc) * sinTheta + (i - yc) * cosTheta + yc;
+      if (xpos >= 0 && ypos >= 0 && xpos < w && ypos < h) hits++;
+    }
+  }
+  KernelTraffic traffic;
+  double hitRatio = w > 0 && h > 0 ? (double)hits / ((double)w * h) : 0.0;
+  traffic.bytesPerPixel = sizeof(cl_int) + sizeof(cl_int) * hitRatio;
+  traffic.flopsPerPixel = 8;
+  return traffic;
+}
+
+void PrintRoofline(std::ostream &os, const std::string &deviceName,
+                   const DevicePeaks &peaks,
+                   const std::vector<RooflinePoint> &points) {
+  double ridge = peaks.flopsPerSecond / peaks.bytesPerSecond;
+  std::ios::fmtflags flags = os.flags();
+  os << std::fixed << std::setprecision(2);
+  os << "device: " << deviceName << std::endl;
+  os << "  peak bandwidth " << peaks.bytesPerSecond / 1e9 << " GB/s, peak "
+     << peaks.flopsPerSecond / 1e9 << " GFLOP/s, ridge point " << ridge
+     << " FLOP/B" << std::endl;
+  os << std::left << std::setw(22) << "  kernel" << std::right << std::setw(10)
+     << "FLOP/B" << std::setw(10) << "GB/s" << std::setw(12) << "GFLOP/s"
+     << std::setw(14) << "roof GFLOP/s" << std::setw(10) << "bound"
+     << std::setw(12) << "% of roof" << std::endl;
+  for (size_t i = 0; i < points.size(); i++) {
+    const RooflinePoint &p = points[i];
+    double intensity = p.traffic.flopsPerPixel / p.traffic.bytesPerPixel;
+    double bytesPerSecond = p.traffic.bytesPerPixel * p.pixels / p.seconds;
+    double flopsPerSecond = p.traffic.flopsPerPixel * p.pixels / p.seconds;
+    double roof = std::min(peaks.flopsPerSecond,
+                           intensity * peaks.bytesPerSecond);
+    os << "  " << std::left << std::setw(20) << p.name << std::right
+       << std::setw(10) << intensity << std::setw(10) << bytesPerSecond / 1e9
+       << std::setw(12) << flopsPerSecond / 1e9 << std::setw(14) << roof / 1e9
+       << std::setw(10) << (intensity < ridge ? "memory" : "compute")
+       << std::setw(11) << 100.0 * flopsPerSecond / roof << "%" << std::endl;
+  }
+  os.flags(flags);
+}
+
+bool AppendRooflineCsv(const std::string &path, const std::string &deviceName,
+                       const DevicePeaks &peaks,
+                       const std::vector<RooflinePoint> &points) {
+  bool exists = std::ifstream(path.c_str()).good();
+  std::ofstream file(path.c_str(), std::ios::out | std::ios::app);
+  if (!file.is_open()) {
+    std::cout << "Failed to open roofline file: " << path << std::endl;
+    return false;
+  }
+  if (!exists) {
+    file << "device,kernel,flop_per_byte,gflops,gbytes_per_s,"
+            "peak_gbytes_per_s,peak_gflops\n";
+  }
+  for (size_t i = 0; i < points.size(); i++) {
+    const RooflinePoint &p = points[i];
+    file << '"' << deviceName << "\"," << p.name << ","
+         << p.traffic.flopsPerPixel / p.traffic.bytesPerPixel << ","
+         << p.traffic.flopsPerPixel * p.pixels / p.seconds / 1e9 << ","
+         << p.traffic.bytesPerPixel * p.pixels / p.seconds / 1e9 << ","
+         << peaks.bytesPerSecond / 1e9 << "," << peaks.flopsPerSecond / 1e9
+         << "\n";
+  }
+  return file.good();
+}
@@ -0,0 +1,78 @@
+#ifndef OPENCL_EXAMPLE_ROTATE_ROOFLINE_H_
+#define OPENCL_EXAMPLE_ROTATE_ROOFLINE_H_
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <CL/cl.h>
+
+/**
+ * ========== Roofline 模型 ==========
+ * 可达性能 = min(峰值算力, 算术强度 * 峰值带宽)，算术强度 = FLOPs / 访存字节数。
+ *  - 峰值带宽和峰值算力用 roofline.cl 中的 micro-kernel 在目标设备上实测
+ *  - 每个旋转 kernel 的访存字节数和 FLOPs 按像素由下面的模型给出
+ * 强度落在拐点（峰值算力 / 峰值带宽）左边的 kernel 受带宽限制，右边的受算力限制。
+ */
+
+/**
+ * @brief 设备实测峰值
+ */
+struct DevicePeaks {
+  DevicePeaks() : bytesPerSecond(0), flopsPerSecond(0) {}
+  double bytesPerSecond;
+  double flopsPerSecond;
+};
+
+/**
+ * @brief 每像素的访存量和计算量
+ * @note 只统计必需的 DRAM 流量（读一次输入、写一次命中的输出），
+ *       散射写造成的缓存行浪费不计入，所以这是算术强度的上界
+ */
+struct KernelTraffic {
+  KernelTraffic() : bytesPerPixel(0), flopsPerPixel(0) {}
+  double bytesPerPixel;
+  double flopsPerPixel;
+};
+
+/**
+ * @brief roofline 上的一个点：某个 kernel 在某个设备上的一次实测
+ */
+struct RooflinePoint {
+  std::string name;
+  KernelTraffic traffic;
+  double pixels;   // 一次 launch 处理的像素数
+  double seconds;  // kernel 执行时间（profiling event）
+};
+
+/**
+ * @brief 用 roofline.cl 中的 micro-kernel 测量峰值带宽和峰值算力
+ * @param queue 必须打开了 CL_QUEUE_PROFILING_ENABLE
+ */
+cl_int MeasureDevicePeaks(cl_context context, cl_device_id device,
+                          cl_command_queue queue, const std::string &kernelPath,
+                          DevicePeaks *peaks);
+
+/**
+ * @brief image_rotate / image_rotate_batch 每像素的访存量和计算量
+ * @note 坐标变换是 4 次浮点乘加（xpos、ypos 各 2 mul + 2 add/sub），共 8 FLOP；
+ *       访存是读 4B 输入，加上落在图像内的像素写 4B 输出，命中率由 sin/cos 决定
+ */
+KernelTraffic RotateKernelTraffic(int w, int h, float sinTheta,
+                                  float cosTheta);
+
+/**
+ * @brief 输出 roofline 表格：算术强度、实测性能、可达上限、瓶颈和效率
+ */
+void PrintRoofline(std::ostream &os, const std::string &deviceName,
+                   const DevicePeaks &peaks,
+                   const std::vector<RooflinePoint> &points);
+
+/**
+ * @brief 以 CSV 追加写入绘图数据，每个点一行，多次运行（不同设备）可写入同一个文件
+ */
+bool AppendRooflineCsv(const std::string &path, const std::string &deviceName,
+                       const DevicePeaks &peaks,
+                       const std::vector<RooflinePoint> &points);
+
+#endif  // OPENCL_EXAMPLE_ROTATE_ROOFLINE_H_
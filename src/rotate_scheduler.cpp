@@ -0,0 +1,419 @@
+#include "rotate_scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "rotate_metrics.h"
+
+static const size_t kPopBatch = 64;
+
+static void UpdateMax(std::atomic<uint64_t> *target, uint64_t value) {
+  uint64_t prev = target->load(std::memory_order_relaxed);
+  while (value > prev && !target->compare_exchange_weak(prev, value)) {
+  }
+}
+
+BatchScheduler::BatchScheduler(FailoverRotator *rotator,
+                               const BatchOptions &options)
+    : rotator_(rotator),
+      options_(options),
+      ring_((size_t)std::max(2, options.queueCapacity)),
+      running_(false),
+      inflight_(0),
+      sleeping_(false),
+      idle_(false),
+      stopExecutors_(false),
+      pushNanos_(0),
+      pushes_(0),
+      maxPushNanos_(0),
+      batches_(0),
+      frames_(0),
+      maxWaitMicros_(0) {
+  for (int i = 0; i < kHistogramBuckets; i++) {
+    batchSizes_[i].store(0);
+  }
+  for (int i = 0; i < kWaitBuckets; i++) {
+    waitMicros_[i].store(0);
+  }
+  for (int p = 0; p < kPriorityCount; p++) {
+    for (int i = 0; i < kLatencyBuckets; i++) {
+      latencyMicros_[p][i].store(0);
+    }
+  }
+  options_.maxBatch = std::max(1, options_.maxBatch);
+  options_.bulkChunk = std::max(1, options_.bulkChunk);
+  options_.maxLatencyMicros =
+      std::max(options_.windowMicros, options_.maxLatencyMicros);
+}
+
+BatchScheduler::~BatchScheduler() { Stop(); }
+
+void BatchScheduler::Start() {
+  if (running_.exchange(true)) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopExecutors_ = false;
+  }
+  for (int p = 0; p < kPriorityCount; p++) {
+    executors_[p] = std::thread(&BatchScheduler::Execute, this, p);
+  }
+  thread_ = std::thread(&BatchScheduler::Loop, this);
+}
+
+void BatchScheduler::Stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+  }
+  wakeup_.notify_one();
+  thread_.join();
+  // 调度线程退出前已经把所有请求交给执行线程，等它们做完最后的批次
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopExecutors_ = true;
+  }
+  for (int p = 0; p < kPriorityCount; p++) {
+    work_[p].notify_one();
+    executors_[p].join();
+  }
+}
+
+cl_int BatchScheduler::Submit(const int *in, int inPitch, int *out,
+                              int outPitch, int w, int h, float sinTheta,
+                              float cosTheta, RotatePriority priority) {
+  Request req;
+  req.job.in = in;
+  req.job.out = out;
+  req.job.sinTheta = sinTheta;
+  req.job.cosTheta = cosTheta;
+  req.job.inPitch = inPitch;
+  req.job.outPitch = outPitch;
+  req.w = w;
+  req.h = h;
+  req.priority = priority;
+  std::future<cl_int> result = req.result.get_future();
+
+  inflight_.fetch_add(1);
+  if (!running_.load()) {
+    inflight_.fetch_sub(1);
+    return CL_INVALID_OPERATION;
+  }
+  req.arrival = Clock::now();
+  bool pushed = ring_.TryPush(&req);
+  uint64_t nanos = (uint64_t)std::chrono::duration_cast<
+                       std::chrono::nanoseconds>(Clock::now() - req.arrival)
+                       .count();
+  inflight_.fetch_sub(1);
+  pushNanos_.fetch_add(nanos, std::memory_order_relaxed);
+  pushes_.fetch_add(1, std::memory_order_relaxed);
+  UpdateMax(&maxPushNanos_, nanos);
+  if (!pushed) {
+    return kBusy;
+  }
+
+  // 和调度线程的 sleeping_ 写入构成 Dekker 式的配对，保证不会丢失唤醒
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (sleeping_.load()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+    }
+    wakeup_.notify_one();
+  }
+  return result.get();
+}
+
+void BatchScheduler::Drain(std::deque<Request *> *pending) {
+  Request *batch[kPopBatch];
+  size_t n = 0;
+  while ((n = ring_.TryPopBatch(batch, kPopBatch)) > 0) {
+    Clock::time_point now = Clock::now();
+    for (size_t i = 0; i < n; i++) {
+      std::chrono::duration<double> wait = now - batch[i]->arrival;
+      Metrics().queueWaitSeconds.Observe(wait.count());
+      uint64_t waited = (uint64_t)(wait.count() * 1e6);
+      int bucket = 0;
+      while (bucket < kWaitBuckets - 1 && ((uint64_t)1 << bucket) < waited) {
+        bucket++;
+      }
+      waitMicros_[bucket].fetch_add(1, std::memory_order_relaxed);
+      pending->push_back(batch[i]);
+    }
+  }
+}
+
+void BatchScheduler::Loop() {
+  std::deque<Request *> pending;
+  for (;;) {
+    // 在 Dispatch 之前清掉 idle_：之后空闲下来的执行线程会让下面的等待立即返回
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      idle_ = false;
+    }
+    Drain(&pending);
+    if (!running_.load()) {
+      // 退出前等待正在入队的请求，然后全部交给执行线程，不让调用方永远阻塞
+      while (inflight_.load() != 0) {
+        std::this_thread::yield();
+      }
+      Drain(&pending);
+      for (;;) {
+        Dispatch(&pending, true);
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (pending.empty()) {
+          return;
+        }
+        wakeup_.wait(lock, [this] { return idle_; });
+        idle_ = false;
+      }
+    }
+
+    Clock::time_point wake = Dispatch(&pending, false);
+    if (!ring_.Empty()) {
+      continue;
+    }
+
+    // 没有新请求：睡到最早一组的发射时间，或者被生产者、空闲的执行线程唤醒
+    std::unique_lock<std::mutex> lock(mutex_);
+    sleeping_.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto ready = [this] { return !ring_.Empty() || !running_.load() || idle_; };
+    if (!ready()) {
+      if (wake == Clock::time_point::max()) {
+        wakeup_.wait(lock, ready);
+      } else {
+        wakeup_.wait_until(lock, wake, ready);
+      }
+    }
+    sleeping_.store(false);
+  }
+}
+
+void BatchScheduler::Execute(int priority) {
+  for (;;) {
+    std::vector<Request *> group;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_[priority].wait(lock, [this, priority] {
+        return !group_[priority].empty() || stopExecutors_;
+      });
+      if (group_[priority].empty()) {
+        return;
+      }
+      group = group_[priority];
+    }
+
+    // 1. 一次 launch 执行整个批次，另一类的执行线程可以同时提交
+    Request *first = group.front();
+    std::vector<RotateJob> jobs(group.size());
+    for (size_t i = 0; i < group.size(); i++) {
+      jobs[i] = group[i]->job;
+    }
+    cl_int status = rotator_->RotateBatch(jobs.data(), jobs.size(), first->w,
+                                          first->h, (RotatePriority)priority);
+    RecordBatch(group.size());
+
+    // 2. 通过各自的 promise 唤醒调用方，set_value 之后 Request 随时可能被销毁
+    Clock::time_point now = Clock::now();
+    for (size_t i = 0; i < group.size(); i++) {
+      RecordLatency((RotatePriority)priority, now - group[i]->arrival);
+      group[i]->result.set_value(status);
+    }
+
+    // 3. 空闲下来，让调度线程发射这一类积攒的下一批
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      group_[priority].clear();
+      idle_ = true;
+    }
+    wakeup_.notify_one();
+  }
+}
+
+BatchScheduler::Clock::time_point BatchScheduler::Dispatch(
+    std::deque<Request *> *pending, bool stopping) {
+  Clock::time_point now = Clock::now();
+  Clock::time_point wake = Clock::time_point::max();
+  // 先交互后批量；执行线程正忙的类别留在 pending 中继续合并
+  for (int p = 0; p < kPriorityCount; p++) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!group_[p].empty()) {
+        continue;
+      }
+    }
+    RotatePriority priority = (RotatePriority)p;
+    size_t limit = (size_t)(priority == kPriorityBulk ? options_.bulkChunk
+                                                      : options_.maxBatch);
+    std::deque<Request *> rest;
+    while (!pending->empty()) {
+      // 1. 取出这一类中与最早的请求尺寸相同的一组（保持到达顺序）
+      Request *first = NULL;
+      for (size_t i = 0; i < pending->size() && first == NULL; i++) {
+        if ((*pending)[i]->priority == priority) {
+          first = (*pending)[i];
+        }
+      }
+      if (first == NULL) {
+        break;
+      }
+      std::vector<Request *> group;
+      std::deque<Request *> others;
+      for (size_t i = 0; i < pending->size(); i++) {
+        Request *r = (*pending)[i];
+        if (r->w == first->w && r->h == first->h && r->priority == priority &&
+            group.size() < limit) {
+          group.push_back(r);
+        } else {
+          others.push_back(r);
+        }
+      }
+      pending->swap(others);
+
+      // 2. 判断这一组是否该发射：攒满、窗口内没有新请求、或者最早的请求等待已达上限
+      Clock::time_point windowEnd =
+          group.back()->arrival +
+          std::chrono::microseconds(options_.windowMicros);
+      Clock::time_point latencyEnd =
+          group.front()->arrival +
+          std::chrono::microseconds(options_.maxLatencyMicros);
+      bool fire = stopping || group.size() >= limit || now >= windowEnd ||
+                  now >= latencyEnd;
+      if (!fire) {
+        wake = std::min(wake, std::min(windowEnd, latencyEnd));
+        rest.insert(rest.end(), group.begin(), group.end());
+        continue;
+      }
+
+      // 3. 交给这一类的执行线程，每类同时只执行一个批次
+      for (size_t i = 0; i < group.size(); i++) {
+        UpdateMax(&maxWaitMicros_,
+                  (uint64_t)std::chrono::duration_cast<
+                      std::chrono::microseconds>(now - group[i]->arrival)
+                      .count());
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        group_[p].swap(group);
+      }
+      work_[p].notify_one();
+      break;
+    }
+    pending->insert(pending->begin(), rest.begin(), rest.end());
+  }
+  return wake;
+}
+
+void BatchScheduler::RecordBatch(size_t size) {
+  int bucket = 0;
+  while (bucket < kHistogramBuckets - 1 && ((size_t)1 << bucket) < size) {
+    bucket++;
+  }
+  batchSizes_[bucket].fetch_add(1);
+  batches_.fetch_add(1);
+  frames_.fetch_add(size);
+}
+
+void BatchScheduler::RecordLatency(RotatePriority priority,
+                                   Clock::duration latency) {
+  std::chrono::duration<double> seconds = latency;
+  if (priority == kPriorityBulk) {
+    Metrics().bulkRequestSeconds.Observe(seconds.count());
+  } else {
+    Metrics().interactiveRequestSeconds.Observe(seconds.count());
+  }
+  uint64_t micros = (uint64_t)(seconds.count() * 1e6);
+  int bucket = 0;
+  while (bucket < kLatencyBuckets - 1 && ((uint64_t)1 << bucket) < micros) {
+    bucket++;
+  }
+  latencyMicros_[priority][bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t BatchScheduler::LatencyPercentile(int priority, double q) const {
+  uint64_t total = 0;
+  for (int i = 0; i < kLatencyBuckets; i++) {
+    total += latencyMicros_[priority][i].load();
+  }
+  if (total == 0) {
+    return 0;
+  }
+  uint64_t target = (uint64_t)std::ceil(q * total);
+  uint64_t seen = 0;
+  for (int i = 0; i < kLatencyBuckets; i++) {
+    seen += latencyMicros_[priority][i].load();
+    if (seen >= target) {
+      return (uint64_t)1 << i;
+    }
+  }
+  return (uint64_t)1 << (kLatencyBuckets - 1);
+}
+
+void BatchScheduler::PrintStats(std::ostream &os) const {
+  uint64_t batches = batches_.load();
+  uint64_t frames = frames_.load();
+  os << "batches: " << batches << ", frames: " << frames << ", avg batch: "
+     << (batches == 0 ? 0.0 : (double)frames / batches)
+     << ", max wait: " << maxWaitMicros_.load() << " us" << std::endl;
+  for (int i = 0; i < kHistogramBuckets; i++) {
+    size_t lo = i == 0 ? 1 : ((size_t)1 << (i - 1)) + 1;
+    size_t hi = (size_t)1 << i;
+    os << "  batch size ";
+    if (i == kHistogramBuckets - 1) {
+      os << ">" << ((size_t)1 << (i - 1));
+    } else if (lo == hi) {
+      os << hi;
+    } else {
+      os << lo << "-" << hi;
+    }
+    os << ": " << batchSizes_[i].load() << std::endl;
+  }
+
+  uint64_t pushes = pushes_.load();
+  os << "submit queue: capacity " << ring_.capacity() << ", pushes " << pushes
+     << ", full (backpressure) " << ring_.pushFull() << ", CAS retries "
+     << ring_.pushRetries() << ", avg push "
+     << (pushes == 0 ? 0 : pushNanos_.load() / pushes) << " ns, max push "
+     << maxPushNanos_.load() << " ns" << std::endl;
+  for (int i = 0; i < kWaitBuckets; i++) {
+    os << "  queue wait ";
+    if (i == kWaitBuckets - 1) {
+      os << ">" << ((uint64_t)1 << (i - 1)) << " us";
+    } else {
+      os << "<=" << ((uint64_t)1 << i) << " us";
+    }
+    os << ": " << waitMicros_[i].load() << std::endl;
+  }
+
+  static const char *const kPriorityNames[kPriorityCount] = {"interactive",
+                                                             "bulk"};
+  for (int p = 0; p < kPriorityCount; p++) {
+    uint64_t count = 0;
+    for (int i = 0; i < kLatencyBuckets; i++) {
+      count += latencyMicros_[p][i].load();
+    }
+    if (count == 0) {
+      continue;
+    }
+    os << kPriorityNames[p] << " latency: " << count << " requests, p50 <= "
+       << LatencyPercentile(p, 0.5) << " us, p99 <= "
+       << LatencyPercentile(p, 0.99) << " us" << std::endl;
+    for (int i = 0; i < kLatencyBuckets; i++) {
+      uint64_t n = latencyMicros_[p][i].load();
+      if (n == 0) {
+        continue;
+      }
+      os << "  latency ";
+      if (i == kLatencyBuckets - 1) {
+        os << ">" << ((uint64_t)1 << (i - 1)) << " us";
+      } else {
+        os << "<=" << ((uint64_t)1 << i) << " us";
+      }
+      os << ": " << n << std::endl;
+    }
+  }
+}
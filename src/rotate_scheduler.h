@@ -0,0 +1,146 @@
+#ifndef OPENCL_EXAMPLE_ROTATE_SCHEDULER_H_
+#define OPENCL_EXAMPLE_ROTATE_SCHEDULER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include "mpsc_ring.h"
+#include "rotate_engine.h"
+#include "rotate_failover.h"
+
+/**
+ * @brief 微批处理的参数
+ * @param windowMicros 合并窗口：同尺寸请求在最近一次到达后的这段时间内继续等待合并
+ * @param maxLatencyMicros 最大等待：最早到达的请求最多在调度器里停留这么久
+ * @param maxBatch 单次 launch 最多合并的帧数
+ * @param queueCapacity 提交队列容量，队列满时 Submit 返回 kBusy
+ * @param bulkChunk 后台批量请求单次 launch 最多合并的帧数；设备上同时只有一块批量，
+ *        交互批次与它并发提交，块越小设备越早空出来给交互批次
+ */
+struct BatchOptions {
+  BatchOptions()
+      : windowMicros(200),
+        maxLatencyMicros(1000),
+        maxBatch(32),
+        queueCapacity(1024),
+        bulkChunk(8) {}
+  int windowMicros;
+  int maxLatencyMicros;
+  int maxBatch;
+  int queueCapacity;
+  int bulkChunk;
+};
+
+/**
+ * @brief 位于引擎前面的请求合并调度器
+ * @note 多个线程调用 Submit() 提交请求并阻塞等待结果；调度线程把相同 W*H 的请求
+ *       在合并窗口内攒成一批，通过 RotateEngine::RotateBatch 一次 launch 完成，
+ *       再把结果分发给各个调用方。批次大小按 2 的幂分桶统计。
+ *       提交路径是无锁的 MpscRing，只有调度线程空闲睡眠时生产者才会碰 mutex_
+ *       去唤醒它；每个请求通过自己的 promise 返回结果，调用方之间没有共享锁。
+ *       请求分为交互（kPriorityInteractive）和后台批量（kPriorityBulk）两类，
+ *       每类一个执行线程：调度线程只负责合并，攒好的批次交给对应类别的执行线程，
+ *       由它调用 FailoverRotator::RotateBatch 并等到完成（设备不可用、编译还没完成或
+ *       出错时这一批在 CPU 上完成，请求不会因此失败）。两个执行线程同时向引擎中不同优先级的 queue
+ *       提交，交互批次不必等正在执行的批量批次结束，设备支持 cl_khr_priority_hints
+ *       时还会优先调度交互批次。每类同时只有一个批次在执行，执行期间到达的同类请求
+ *       继续在调度线程中合并；批量请求每块最多 bulkChunk 帧，限制设备上积压的批量工作。
+ *       两类请求各自统计端到端延迟。
+ */
+class BatchScheduler {
+ public:
+  BatchScheduler(FailoverRotator *rotator, const BatchOptions &options);
+  ~BatchScheduler();
+
+  void Start();
+  void Stop();
+
+  /**
+   * @brief 提交一帧并阻塞到旋转完成
+   * @note inPitch / outPitch 为行跨度（像素），不同 pitch 的同尺寸帧可以合并到一批；
+   *       只有优先级相同的请求才会合并
+   * @return 该帧所在批次的 cl_int 状态；提交队列已满时立即返回 kBusy
+   */
+  cl_int Submit(const int *in, int inPitch, int *out, int outPitch, int w,
+                int h, float sinTheta, float cosTheta,
+                RotatePriority priority = kPriorityInteractive);
+
+  /**
+   * @brief 打印批次大小、排队等待时间直方图、入队耗时、背压次数，
+   *        以及两类请求各自的端到端延迟分布和 p50/p99
+   */
+  void PrintStats(std::ostream &os) const;
+
+  // 背压：提交队列已满。取正数以免和 CL_SUCCESS / 负的 cl_int 错误码冲突
+  static const cl_int kBusy = 1;
+  static const int kHistogramBuckets = 8;   // 1, 2, 3-4, 5-8, ..., >64
+  static const int kWaitBuckets = 12;       // <=1us, <=2us, ..., <=1024us, >1024us
+  static const int kLatencyBuckets = 24;    // <=1us, <=2us, ..., <=4.2s, 更长
+  static const int kPriorityCount = 2;
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Request {
+    RotateJob job;
+    int w;
+    int h;
+    RotatePriority priority;
+    Clock::time_point arrival;
+    std::promise<cl_int> result;
+  };
+
+  void Loop();
+  /**
+   * @brief 把到期的批次交给空闲的执行线程，返回剩余请求中最早的发射时间；
+   *        执行线程忙的类别不参与计算，由执行线程空闲时唤醒调度线程
+   */
+  Clock::time_point Dispatch(std::deque<Request *> *pending, bool stopping);
+  // 一个类别的执行线程：执行 group_[priority] 中的批次，完成后唤醒调度线程
+  void Execute(int priority);
+  void Drain(std::deque<Request *> *pending);
+  void RecordBatch(size_t size);
+  void RecordLatency(RotatePriority priority, Clock::duration latency);
+  // 按对数分桶估计分位数，返回所在桶的上界（微秒）
+  uint64_t LatencyPercentile(int priority, double q) const;
+
+  FailoverRotator *rotator_;
+  BatchOptions options_;
+
+  MpscRing<Request *> ring_;
+  std::atomic<bool> running_;
+  std::atomic<int> inflight_;  // 正在入队的 Submit 数量，Stop 时等待它们完成
+  // 调度线程无事可做时在 wakeup_ 上睡眠，生产者看到 sleeping_ 才去唤醒
+  std::mutex mutex_;
+  std::condition_variable wakeup_;
+  std::atomic<bool> sleeping_;
+  std::thread thread_;
+
+  // 执行线程：group_ 非空表示该类别有批次在执行，由 mutex_ 保护。
+  // idle_ 表示有执行线程空闲下来，调度线程在每轮开始时清掉
+  std::vector<Request *> group_[kPriorityCount];
+  std::condition_variable work_[kPriorityCount];
+  std::thread executors_[kPriorityCount];
+  bool idle_;
+  bool stopExecutors_;
+
+  std::atomic<uint64_t> batchSizes_[kHistogramBuckets];
+  std::atomic<uint64_t> waitMicros_[kWaitBuckets];
+  std::atomic<uint64_t> pushNanos_;
+  std::atomic<uint64_t> pushes_;
+  std::atomic<uint64_t> maxPushNanos_;
+  std::atomic<uint64_t> batches_;
+  std::atomic<uint64_t> frames_;
+  std::atomic<uint64_t> maxWaitMicros_;
+  std::atomic<uint64_t> latencyMicros_[kPriorityCount][kLatencyBuckets];
+};
+
+#endif  // OPENCL_EXAMPLE_ROTATE_SCHEDULER_H_
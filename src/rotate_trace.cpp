@@ -0,0 +1,160 @@
+#include "rotate_trace.h"
+
+#ifdef ROTATE_ENABLE_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t kTraceEvents = 4096;  // 每个线程保留最近的 4096 个区间
+
+// 缓冲区会被不同的线程先后使用，所以每个事件各自记录 tid
+struct TraceEvent {
+  const char *name;
+  long tid;
+  uint64_t start;
+  uint64_t end;
+};
+
+/**
+ * 线程私有的环形缓冲区：只有所属线程写入，next 用 release 发布，
+ * 导出时用 acquire 读取。线程退出后缓冲区保留（事件仍可导出），
+ * 并可以被之后新建的线程复用，避免每个连接线程都泄漏一块内存。
+ * tid 是当前所属线程，写入事件时复制到事件中，旧线程的事件仍在自己的 lane 上。
+ */
+struct TraceBuffer {
+  TraceBuffer() : tid(0), next(0), owned(false) {}
+  long tid;
+  std::atomic<uint64_t> next;
+  std::atomic<bool> owned;
+  TraceEvent events[kTraceEvents];
+};
+
+std::mutex g_registryMutex;
+std::vector<TraceBuffer *> g_registry;
+
+struct ThreadSlot {
+  ThreadSlot() : buffer(NULL) {}
+  ~ThreadSlot() {
+    if (buffer != NULL) {
+      buffer->owned.store(false, std::memory_order_release);
+    }
+  }
+  TraceBuffer *buffer;
+};
+
+thread_local ThreadSlot t_slot;
+
+TraceBuffer *ThreadBuffer() {
+  if (t_slot.buffer != NULL) {
+    return t_slot.buffer;
+  }
+  std::lock_guard<std::mutex> lock(g_registryMutex);
+  TraceBuffer *buffer = NULL;
+  for (size_t i = 0; i < g_registry.size() && buffer == NULL; i++) {
+    bool expected = false;
+    if (g_registry[i]->owned.compare_exchange_strong(expected, true)) {
+      buffer = g_registry[i];
+    }
+  }
+  if (buffer == NULL) {
+    buffer = new TraceBuffer();
+    buffer->owned.store(true);
+    g_registry.push_back(buffer);
+  }
+  buffer->tid = syscall(SYS_gettid);
+  t_slot.buffer = buffer;
+  return buffer;
+}
+
+std::string g_signalPath;
+volatile sig_atomic_t g_dumpRequested = 0;
+
+void HandleDumpSignal(int) { g_dumpRequested = 1; }
+
+void AppendJsonString(std::ostream &os, const char *s) {
+  os << '"';
+  for (; *s != '\0'; s++) {
+    if (*s == '"' || *s == '\\') {
+      os << '\\';
+    }
+    os << *s;
+  }
+  os << '"';
+}
+
+}  // namespace
+
+uint64_t TraceNowNanos() {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void TraceRecord(const char *name, uint64_t startNanos, uint64_t endNanos) {
+  TraceBuffer *buffer = ThreadBuffer();
+  uint64_t n = buffer->next.load(std::memory_order_relaxed);
+  TraceEvent &event = buffer->events[n % kTraceEvents];
+  event.name = name;
+  event.tid = buffer->tid;
+  event.start = startNanos;
+  event.end = endNanos;
+  buffer->next.store(n + 1, std::memory_order_release);
+}
+
+bool TraceDump(const std::string &path) {
+  std::ofstream file(path.c_str(), std::ios::out | std::ios::trunc);
+  if (!file.is_open()) {
+    std::cout << "Failed to open trace file: " << path << std::endl;
+    return false;
+  }
+  // 快照：正在被覆盖的少量旧事件可能不完整，对按需导出来说可以接受
+  file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  bool first = true;
+  long pid = (long)getpid();
+  std::lock_guard<std::mutex> lock(g_registryMutex);
+  for (size_t b = 0; b < g_registry.size(); b++) {
+    TraceBuffer *buffer = g_registry[b];
+    uint64_t n = buffer->next.load(std::memory_order_acquire);
+    uint64_t begin = n > kTraceEvents ? n - kTraceEvents : 0;
+    for (uint64_t i = begin; i < n; i++) {
+      const TraceEvent &event = buffer->events[i % kTraceEvents];
+      file << (first ? "\n" : ",\n") << "{\"name\":";
+      AppendJsonString(file, event.name);
+      file << ",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << event.tid
+           << ",\"ts\":" << event.start / 1000 << "." << event.start % 1000 / 100
+           << ",\"dur\":" << (event.end - event.start) / 1000 << "."
+           << (event.end - event.start) % 1000 / 100 << "}";
+      first = false;
+    }
+  }
+  file << "\n]}\n";
+  std::cout << "Trace written to " << path << std::endl;
+  return file.good();
+}
+
+void TraceDumpOnSignal(const std::string &path) {
+  g_signalPath = path;
+  signal(SIGUSR1, HandleDumpSignal);
+  std::thread([] {
+    for (;;) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      if (g_dumpRequested) {
+        g_dumpRequested = 0;
+        TraceDump(g_signalPath);
+      }
+    }
+  }).detach();
+}
+
+#endif  // ROTATE_ENABLE_TRACE
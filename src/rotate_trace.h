@@ -0,0 +1,85 @@
+#ifndef OPENCL_EXAMPLE_ROTATE_TRACE_H_
+#define OPENCL_EXAMPLE_ROTATE_TRACE_H_
+
+/**
+ * ========== 热路径追踪 ==========
+ * 用法：
+ *   {
+ *     ROTATE_TRACE_SCOPE("clBuildProgram");
+ *     status = clBuildProgram(...);
+ *   }
+ *   ROTATE_TRACE_DUMP("/tmp/rotate_trace.json");
+ *
+ * 只有定义了 ROTATE_ENABLE_TRACE（CMake 选项 OPENCL_EXAMPLE_ENABLE_TRACE）时
+ * 这些宏才会展开成代码；否则全部展开为空语句，不产生任何指令和数据，
+ * 生产构建不用为追踪付出任何代价。
+ *
+ * 打开时，每个线程第一次记录事件时分配一个自己的环形缓冲区（只有注册时加一次锁），
+ * 之后的记录只写本线程的缓冲区，没有锁也没有跨线程的原子 RMW。
+ * 导出为 Chrome Trace Event JSON（"ph":"X" 完整事件），可以直接用
+ * chrome://tracing 或 https://ui.perfetto.dev 打开。
+ */
+
+#ifdef ROTATE_ENABLE_TRACE
+
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief 记录一个已结束的区间，name 必须是字符串常量（只保存指针）
+ */
+void TraceRecord(const char *name, uint64_t startNanos, uint64_t endNanos);
+
+/**
+ * @brief 单调时钟，单位纳秒
+ */
+uint64_t TraceNowNanos();
+
+/**
+ * @brief 把所有线程缓冲区中的事件写成 Chrome JSON
+ */
+bool TraceDump(const std::string &path);
+
+/**
+ * @brief 收到 SIGUSR1 时把追踪结果导出到 path，适合常驻的守护进程
+ */
+void TraceDumpOnSignal(const std::string &path);
+
+class TraceScope {
+ public:
+  explicit TraceScope(const char *name) : name_(name), start_(TraceNowNanos()) {}
+  ~TraceScope() { TraceRecord(name_, start_, TraceNowNanos()); }
+
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+ private:
+  const char *name_;
+  uint64_t start_;
+};
+
+#define ROTATE_TRACE_CONCAT_INNER(a, b) a##b
+#define ROTATE_TRACE_CONCAT(a, b) ROTATE_TRACE_CONCAT_INNER(a, b)
+#define ROTATE_TRACE_SCOPE(name) \
+  TraceScope ROTATE_TRACE_CONCAT(rotateTraceScope_, __LINE__)(name)
+#define ROTATE_TRACE_DUMP(path) TraceDump(path)
+#define ROTATE_TRACE_DUMP_ON_SIGNAL(path) TraceDumpOnSignal(path)
+
+#else
+
+#define ROTATE_TRACE_SCOPE(name) \
+  do {                           \
+  } while (0)
+// 仍然求值一次 path（只是丢弃），关闭追踪时只用于导出的参数不会产生未使用警告
+#define ROTATE_TRACE_DUMP(path) \
+  do {                          \
+    (void)(path);               \
+  } while (0)
+#define ROTATE_TRACE_DUMP_ON_SIGNAL(path) \
+  do {                                    \
+    (void)(path);                         \
+  } while (0)
+
+#endif  // ROTATE_ENABLE_TRACE
+
+#endif  // OPENCL_EXAMPLE_ROTATE_TRACE_H_
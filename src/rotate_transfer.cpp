@@ -0,0 +1,92 @@
+#include "rotate_transfer.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static const char *kStrategyNames[kTransferStrategyCount] = {
+    "pageable", "pinned", "hostptr", "map"};
+
+const char *TransferStrategyName(TransferStrategy strategy) {
+  if (strategy < 0 || strategy >= kTransferStrategyCount) {
+    return "unknown";
+  }
+  return kStrategyNames[strategy];
+}
+
+bool ParseTransferStrategy(const std::string &name,
+                           TransferStrategy *strategy) {
+  for (int i = 0; i < kTransferStrategyCount; i++) {
+    if (name == kStrategyNames[i]) {
+      *strategy = (TransferStrategy)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+TransferStrategy TransferProfile::Select(size_t bytes) const {
+  if (entries.empty()) {
+    return kTransferPageable;
+  }
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (bytes <= entries[i].maxBytes) {
+      return entries[i].strategy;
+    }
+  }
+  return entries.back().strategy;
+}
+
+bool SaveTransferProfile(const std::string &path,
+                         const TransferProfile &profile) {
+  std::ofstream file(path.c_str(), std::ios::out | std::ios::trunc);
+  if (!file.is_open()) {
+    std::cout << "Failed to open transfer profile: " << path << std::endl;
+    return false;
+  }
+  file << "# written by opencl_bandwidth, read by opencl_rotate "
+          "--transfer-profile\n";
+  file << "device=" << profile.deviceName << "\n";
+  file << "# max_bytes strategy\n";
+  for (size_t i = 0; i < profile.entries.size(); i++) {
+    file << profile.entries[i].maxBytes << " "
+         << TransferStrategyName(profile.entries[i].strategy) << "\n";
+  }
+  return file.good();
+}
+
+bool LoadTransferProfile(const std::string &path, TransferProfile *profile) {
+  std::ifstream file(path.c_str(), std::ios::in);
+  if (!file.is_open()) {
+    std::cout << "Failed to open transfer profile: " << path << std::endl;
+    return false;
+  }
+  profile->deviceName.clear();
+  profile->entries.clear();
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    if (line.compare(0, 7, "device=") == 0) {
+      profile->deviceName = line.substr(7);
+      continue;
+    }
+    std::istringstream fields(line);
+    TransferProfile::Entry entry;
+    std::string name;
+    if (!(fields >> entry.maxBytes >> name) ||
+        !ParseTransferStrategy(name, &entry.strategy)) {
+      std::cout << "Malformed transfer profile line: " << line << std::endl;
+      return false;
+    }
+    if (!profile->entries.empty() &&
+        entry.maxBytes <= profile->entries.back().maxBytes) {
+      std::cout << "Transfer profile sizes must increase: " << line
+                << std::endl;
+      return false;
+    }
+    profile->entries.push_back(entry);
+  }
+  return !profile->entries.empty();
+}
@@ -0,0 +1,63 @@
+#ifndef OPENCL_EXAMPLE_ROTATE_TRANSFER_H_
+#define OPENCL_EXAMPLE_ROTATE_TRANSFER_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * ========== Host <-> Device 传输策略 ==========
+ * 调用方给的是普通的 pageable 内存（new int[] / std::vector），把它送到设备上有几种做法，
+ * 哪种最快取决于设备（独显走 PCIe、集显和 CPU 与 host 共享内存）和传输大小：
+ *  - kTransferPageable：clEnqueueWrite/ReadBuffer 直接读写 pageable 内存，驱动内部再中转一次
+ *  - kTransferPinned：先 memcpy 到 CL_MEM_ALLOC_HOST_PTR 的锁页暂存区，再从锁页内存 DMA
+ *  - kTransferHostPtr：CL_MEM_USE_HOST_PTR 直接包装调用方内存，共享内存设备上零拷贝
+ *  - kTransferMap：map 设备 buffer 后 host 直接 memcpy
+ * opencl_bandwidth 对这些方式做大小扫描，把每个大小区间最快的方式写成 profile 文件，
+ * RotateEngine::UseTransferProfile 读取后按帧大小选择。
+ */
+
+enum TransferStrategy {
+  kTransferPageable = 0,
+  kTransferPinned,
+  kTransferHostPtr,
+  kTransferMap,
+  kTransferStrategyCount
+};
+
+const char *TransferStrategyName(TransferStrategy strategy);
+
+/**
+ * @brief 按名字解析，未知名字返回 false
+ */
+bool ParseTransferStrategy(const std::string &name, TransferStrategy *strategy);
+
+/**
+ * @brief 某个设备上按传输大小选择策略的表
+ * @note entries 按 maxBytes 升序：大小不超过 maxBytes 的传输使用对应策略，
+ *       超过最后一项时使用最后一项
+ */
+struct TransferProfile {
+  struct Entry {
+    size_t maxBytes;
+    TransferStrategy strategy;
+  };
+
+  std::string deviceName;
+  std::vector<Entry> entries;
+
+  TransferStrategy Select(size_t bytes) const;
+};
+
+/**
+ * @brief 文本格式：
+ *   device=<CL_DEVICE_NAME>
+ *   <maxBytes> <strategy>
+ *   ...
+ *   # 开头的行为注释
+ */
+bool SaveTransferProfile(const std::string &path,
+                         const TransferProfile &profile);
+bool LoadTransferProfile(const std::string &path, TransferProfile *profile);
+
+#endif  // OPENCL_EXAMPLE_ROTATE_TRANSFER_H_